@@ -5,6 +5,7 @@
 #include <sstream>
 #include <queue>
 #include<iostream>
+#include "Commom\SexticRootSolver.h"
 
 namespace PolynoimalSolver
 {
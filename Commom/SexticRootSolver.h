@@ -0,0 +1,142 @@
+#pragma once
+#ifndef SEXTIC_ROOT_SOLVER_H
+#define SEXTIC_ROOT_SOLVER_H
+#include "DataCore.h"
+#include <math.h>
+
+// the host ccd and the cuda kernels run the same solver
+#ifdef __CUDACC__
+#define SEXTIC_ROOT_SOLVER_FUNC __host__ __device__ __forceinline__
+#else
+#define SEXTIC_ROOT_SOLVER_FUNC inline
+#endif
+
+namespace PolynoimalSolver
+{
+#define BERNSTEIN_SEXTIC_MAX_DEPTH 40
+#define BERNSTEIN_SEXTIC_MAX_STEPS 160
+
+	// bernstein coefficients of the sextic on [0, 1] restricted to [a, b], two de casteljau passes
+	SEXTIC_ROOT_SOLVER_FUNC void restrictSexticBernstein(const qeal* w0, qeal a, qeal b, qeal* w)
+	{
+		// left part [0, b]
+		qeal t[7];
+		for (int k = 0; k < 7; k++)
+			t[k] = w0[k];
+		w[0] = t[0];
+		for (int l = 1; l < 7; l++)
+		{
+			for (int k = 0; k < 7 - l; k++)
+				t[k] = (1.0 - b) * t[k] + b * t[k + 1];
+			w[l] = t[0];
+		}
+		// right part [a / b, 1] of it
+		qeal s = a / b;
+		for (int k = 0; k < 7; k++)
+			t[k] = w[k];
+		w[6] = t[6];
+		for (int l = 1; l < 7; l++)
+		{
+			for (int k = 0; k < 7 - l; k++)
+				t[k] = (1.0 - s) * t[k] + s * t[k + 1];
+			w[6 - l] = t[6 - l];
+		}
+	}
+
+	// earliest x on the range [mini, maxi] with ax^6 + bx^5 + cx^4 + dx^3 + ex^2 + fx + g <= tol, by subdividing the bernstein form;
+	// at most maxSteps intervals are split, if none is left undecided by then (or the interval is narrower than precision)
+	// its left end is returned, so x is never later than the true root;
+	// return false if the polynomial stays above tol on the whole range.
+	// the intervals are visited left to right by their index at the current depth, a rejected one moves on to the next sibling
+	// and its coefficients are restricted again from the whole range, so there is no stack and a thread only keeps 3 x 7 values
+	SEXTIC_ROOT_SOLVER_FUNC bool solveSexticEarliestRoot(qeal a, qeal b, qeal c, qeal d, qeal e, qeal f, qeal g, qeal& x, qeal mini = 0.0, qeal maxi = 1.0, qeal tol = 0.0, qeal precision = 1e-12, int maxSteps = BERNSTEIN_SEXTIC_MAX_STEPS)
+	{
+		// power coefficients of p(s) = f(mini + (maxi - mini) s) - tol, s on [0, 1]
+		qeal h = maxi - mini;
+		qeal p[7] = { g - tol, f, e, d, c, b, a };
+		for (int i = 0; i < 6; i++)
+			for (int j = 5; j >= i; j--)
+				p[j] += mini * p[j + 1];
+		qeal hi = 1.0;
+		for (int i = 1; i < 7; i++)
+		{
+			hi *= h;
+			p[i] *= hi;
+		}
+
+		// bernstein coefficients, w0[k] = sum_i C(k, i) / C(6, i) p[i]
+		const qeal binom[7][7] = {
+			{ 1, 0, 0, 0, 0, 0, 0 },
+			{ 1, 1, 0, 0, 0, 0, 0 },
+			{ 1, 2, 1, 0, 0, 0, 0 },
+			{ 1, 3, 3, 1, 0, 0, 0 },
+			{ 1, 4, 6, 4, 1, 0, 0 },
+			{ 1, 5, 10, 10, 5, 1, 0 },
+			{ 1, 6, 15, 20, 15, 6, 1 } };
+		qeal w0[7];
+		for (int k = 0; k < 7; k++)
+		{
+			w0[k] = 0.0;
+			for (int i = 0; i <= k; i++)
+				w0[k] += binom[k][i] / binom[6][i] * p[i];
+		}
+
+		// the current interval is [index, index + 1] * 2^-depth
+		qeal w[7];
+		for (int k = 0; k < 7; k++)
+			w[k] = w0[k];
+		long long index = 0;
+		int depth = 0;
+		int steps = 0;
+		while (true)
+		{
+			qeal width = ldexp(1.0, -depth);
+			qeal lo = index * width;
+			if (w[0] <= 0.0)
+			{
+				x = mini + lo * h;
+				return true;
+			}
+			qeal minw = w[1];
+			for (int k = 2; k < 7; k++)
+				minw = minw < w[k] ? minw : w[k];
+			if (minw > 0.0)
+			{
+				// the convex hull stays above 0, go up past the right halves and on to the next sibling
+				while (index & 1)
+				{
+					index >>= 1;
+					depth--;
+				}
+				if (depth == 0)
+					return false;
+				index++;
+				width = ldexp(1.0, -depth);
+				restrictSexticBernstein(w0, index * width, (index + 1) * width, w);
+				continue;
+			}
+
+			if (steps == maxSteps || depth == BERNSTEIN_SEXTIC_MAX_DEPTH - 1 || width * h <= precision)
+			{
+				x = mini + lo * h;
+				return true;
+			}
+
+			// de casteljau at 1/2, w keeps the left half
+			qeal t[7];
+			for (int k = 0; k < 7; k++)
+				t[k] = w[k];
+			for (int l = 1; l < 7; l++)
+			{
+				for (int k = 0; k < 7 - l; k++)
+					t[k] = 0.5 * (t[k] + t[k + 1]);
+				w[l] = t[0];
+			}
+			index <<= 1;
+			depth++;
+			steps++;
+		}
+	}
+}
+
+#endif
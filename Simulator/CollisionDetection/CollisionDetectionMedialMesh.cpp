@@ -112,7 +112,7 @@ namespace CDMM
 		{
 			temp_alpha = (B * E - 2.0 * C * D) / delta; temp_beta = (B * D - 2.0 * A * E) / delta;
 
-			if (temp_alpha > 0.0 && temp_alpha < 1.0 && temp_beta> 0.0 && temp_beta < 1.0 && temp_alpha + temp_beta < 1.0)
+			if (temp_alpha > 0.0 && temp_alpha < 1.0 && temp_beta> 0.0 && temp_beta < 1.0 && (!ss || temp_alpha + temp_beta < 1.0))
 			{
 				temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
 				if (dist > temp_dist)
@@ -10,11 +10,15 @@ namespace CDMM
 #define CHECK_MEDIAL_PRIMITIVE_VALID
 #define CDMM_NORROW 1e-8
 #define CDMM_NewtonSolverPrecision 1e-15
+// a sextic root at the start of the range is a touch we start from, the next root is searched from here on
+#define CDMM_TOUCH_EPSILON 1e-6
 	
 	using namespace PolynoimalSolver;
 	typedef ValidRange RootRange;
 
 	qeal valueOfQuadircSurface2D(const qeal x, const qeal y, const qeal A, const qeal B, const qeal C, const qeal D, const qeal E, const qeal F);
+	// min of |c|^2 - r^2 over the primitive pair (ss: sphere-slab, otherwise cone-cone) and where it is reached
+	void computeCollisionDistance(Vector3 C1, Vector3 C2, Vector3 C3, qeal& R1, qeal& R2, qeal& R3, bool ss, qeal& dist, qeal& alpha, qeal& beta);
 	bool dcd(Vector3 c11, qeal r11, Vector3 c12, qeal r12, Vector3 c21, qeal r21, Vector3 c22, qeal r22, bool space_triangle = false, qeal norrow = CDMM_NORROW);
 	bool dcd(Vector3 C1, Vector3  C2, Vector3 C3, qeal&  R1, qeal& R2, qeal& R3, bool space_triangle = false, qeal norrow = CDMM_NORROW);
 	bool dcd(qeal A, qeal B, qeal C, qeal D, qeal E, qeal F, bool space_triangle = false, qeal norrow = CDMM_NORROW);
@@ -1,4 +1,4 @@
-#include "Simulator\CollisionDetection\CollisionDetectionMedialMesh.h"
+#include "Simulator\CollisionDetection\CollisionDetectionMedialMesh11.h"
 
 namespace CDMM
 {
@@ -6,11 +6,6 @@ namespace CDMM
 #define INTERSECTION 1
 #define PENETRATION 2
 
-	qeal valueOfQuadircSurface2D(const qeal x, const qeal y, const qeal A, const qeal B, const qeal C, const qeal D, const qeal E, const qeal F)
-	{
-		return A * x * x + B * x * y + C * y * y + D * x + E * y + F;
-	}
-
 	void genQuarticCoeffs(qeal & P_4, qeal & P_3, qeal & P_2, qeal & P_1, qeal & P_0, qeal A_2, qeal A_1, qeal A_0, qeal B_2, qeal B_1, qeal B_0, qeal C_2, qeal C_1, qeal C_0, qeal D_2, qeal D_1, qeal D_0, qeal S)
 	{
 		P_4 += (A_2 * B_2 - C_2 * D_2) * S;
@@ -39,29 +34,14 @@ namespace CDMM
 			qeal ft = 1.0;
 			Vector2 r = range.set.front();
 			range.set.pop();
-			int count = 0;
-			qeal x[6];
-			if (W_6 == 0.0 && W_5 == 0.0)
-			{				
-				if (solveQuarticEquation(W_4, W_3, W_2, W_1, W_0, x, count, true, r.data()[0], r.data()[1]))
-				{					
-					qeal fx = W_6 * x[0] * x[0] * x[0] * x[0] * x[0] * x[0] + W_5 * x[0] * x[0] * x[0] * x[0] * x[0] + W_4 * x[0] * x[0] * x[0] * x[0] + W_3 * x[0] * x[0] * x[0] + W_2 * x[0] * x[0] + W_1 * x[0] + W_0;
-					
-					if (fx >= 0.0 && fx <= std::max(norrow, CDMM_NORROW))
-						ft = x[0];
-					else if (fx < 0.0)
-					{
-						ft = x[0];  // _distance still excess 0.0
-					}
-
-					if(ft == 1.0)
-						ft = NewtonSolverSexticEqForFTC(W_6, W_5, W_4, W_3, W_2, W_1, W_0, r, norrow);
-				}
-				else ft = NewtonSolverSexticEqForFTC(W_6, W_5, W_4, W_3, W_2, W_1, W_0, r, norrow);
-			}
-			else ft = NewtonSolverSexticEqForFTC(W_6, W_5, W_4, W_3, W_2, W_1, W_0, r, norrow);
-
-		//	ft = NewtonSolverSexticEqForFTC(W_6, W_5, W_4, W_3, W_2, W_1, W_0, r, norrow);
+			// bounded bernstein isolation instead of newton, a root at t = 0 is the contact we start from, so the search goes on over (eps, max]
+			qeal x;
+			qeal tol = std::max(norrow, CDMM_NORROW);
+			bool found = solveSexticEarliestRoot(W_6, W_5, W_4, W_3, W_2, W_1, W_0, x, r.data()[0], r.data()[1], tol);
+			if (found && x <= 0.0 && r.data()[1] > CDMM_TOUCH_EPSILON)
+				found = solveSexticEarliestRoot(W_6, W_5, W_4, W_3, W_2, W_1, W_0, x, CDMM_TOUCH_EPSILON, r.data()[1], tol);
+			if (found && x > 0.0)
+				ft = x;
 
 			bool isBan = false;
 			for (int j = 0; j < banRootsNum; j++)
@@ -89,9 +69,9 @@ namespace CDMM
 
 		if (x > ftc) return ftc;
 
+		fx = W_6 * x * x * x * x  * x * x + W_5 * x * x * x  * x * x + W_4 * x * x  * x * x + W_3 * x  * x * x + W_2 * x * x + W_1 * x + W_0;
 		if (x > 0.0)
 		{
-			fx = W_6 * x * x * x * x  * x * x + W_5 * x * x * x  * x * x + W_4 * x * x  * x * x + W_3 * x  * x * x + W_2 * x * x + W_1 * x + W_0;
 			if (fx >= 0.0 && fx <= std::max(norrow, CDMM_NORROW))
 			{
 				ftc = x;
@@ -129,190 +109,6 @@ namespace CDMM
 		return ftc;
 	}
 
-	bool dcd(Vector3 c11, qeal r11, Vector3 c12, qeal r12, Vector3 c21, qeal r21, Vector3 c22, qeal r22, bool space_triangle, qeal norrow)
-	{
-		qeal R1 = r11 - r12;
-		qeal R2 = r21 - r22;
-		qeal R3 = r12 + r22;
-		Vector3 C1 = c11 - c12;
-		Vector3 C2 = c22 - c21;
-		Vector3 C3 = c12 - c22;
-		return dcd(C1, C2, C3, R1, R2, R3, space_triangle, norrow);
-	}
-
-	bool dcd(Vector3 C1, Vector3 C2, Vector3 C3, qeal & R1, qeal & R2, qeal & R3, bool space_triangle, qeal norrow)
-	{
-		qeal A = C1.dot(C1) - R1 * R1;
-		qeal B = 2.0 * (C1.dot(C2) - R1 * R2);
-		qeal C = C2.dot(C2) - R2 * R2;
-		qeal D = 2.0 * (C1.dot(C3) - R1 * R3);
-		qeal E = 2.0 * (C2.dot(C3) - R2 * R3);
-		qeal F = C3.dot(C3) - R3 * R3;
-
-		return dcd(A, B, C, D, E, F, space_triangle, norrow);
-	}
-
-	bool dcd(qeal A, qeal B, qeal C, qeal D, qeal E, qeal F, bool space_triangle, qeal norrow)
-	{
-		qeal min = 1;
-		//case 1 x = 0, y = 0
-		if (D >= 0 && E >= 0)
-		{
-			qeal f = valueOfQuadircSurface2D(0, 0, A, B, C, D, E, F);
-			if (f < min)
-			{
-				min = f;
-			}
-		}
-		//case 2: x = 0, y != 0,1
-		{
-			qeal E2C = -1 * (E / (2 * C));
-			if (E2C > 0 && E2C < 1)
-			{
-				qeal DB = B * E2C + D;
-				if (DB >= 0)
-				{
-					qeal f = valueOfQuadircSurface2D(0, E2C, A, B, C, D, E, F);
-					if (f < min)
-					{
-						min = f;
-					}
-				}
-			}
-		}
-		// case 3 x = 0, y = 1;
-		if ((B + D) >= 0 && (2 * C + E) <= 0)
-		{
-			qeal f = valueOfQuadircSurface2D(0, 1, A, B, C, D, E, F);
-			if (f < min)
-			{
-				min = f;
-			}
-		}
-		//case 4 x != 0, 1, y = 0
-		{
-			if (!IS_QEAL_ZERO(A))
-			{
-				qeal D2A = -1 * (D / (2 * A));
-				if (D2A > 0 && D2A < 1)
-				{
-					qeal EB = B * D2A + E;
-					if (EB >= 0)
-					{
-						qeal f = valueOfQuadircSurface2D(D2A, 0, A, B, C, D, E, F);
-						if (f < min)
-						{
-							min = f;
-						}
-					}
-				}
-			}
-		}
-		// case 5 x != 0,1 y != 0,1
-		{
-			if (!IS_QEAL_ZERO(4 * A*C - B * B))
-			{
-				qeal x = (B*E - 2 * C*D) / (4 * A*C - B * B);
-				qeal y = (B*D - 2 * A*E) / (4 * A*C - B * B);
-				if (x > 0 && x < 1 && y > 0 && y < 1)
-				{
-					if (!space_triangle)
-					{
-						qeal f = valueOfQuadircSurface2D(x, y, A, B, C, D, E, F);
-						if (f < min)
-						{
-							min = f;
-						}
-					}
-					else
-					{
-						if ((x + y) <= 1)
-						{
-							qeal f = valueOfQuadircSurface2D(x, y, A, B, C, D, E, F);
-							if (f < min)
-							{
-								min = f;
-							}
-						}
-					}
-				}
-			}
-		}
-		// case 6 x != 0,1 y = 1
-		{
-			if (!space_triangle)
-			{
-				if (!IS_QEAL_ZERO(A))
-				{
-					qeal x = -1 * ((B + D) / (2 * A));
-					qeal CBE = 2 * C - (B*B + B * D) / (2 * A) + E;
-					if (x > 0 && x < 1 && CBE <= 0)
-					{
-						qeal f = valueOfQuadircSurface2D(x, 1, A, B, C, D, E, F);
-						if (f < min)
-						{
-							min = f;
-						}
-					}
-				}
-			}
-		}
-
-		// case 7 x =1 y = 0
-		{
-			if ((-1 * (2 * A + D)) >= 0 && (B + E) >= 0)
-			{
-				qeal f = valueOfQuadircSurface2D(1, 0, A, B, C, D, E, F);
-				if (f < min)
-				{
-					min = f;
-				}
-			}
-		}
-
-		// case 8 x =1 y != 0,1
-		{
-			if (!space_triangle)
-			{
-				qeal y = -1 * ((B + E) / (2 * C));
-				qeal ABD = 2 * A - (B*B + B * E) / (2 * C) + D;
-				if (y > 0 && y < 1 && ABD <= 0)
-				{
-					qeal f = valueOfQuadircSurface2D(1, y, A, B, C, D, E, F);
-					if (f < min)
-					{
-						min = f;
-					}
-				}
-			}
-		}
-
-		// case 9 x =1, y = 1
-		{
-			if (!space_triangle)
-			{
-				qeal ABD = -1 * (2 * A + B + D);
-				qeal CBE = -1 * (2 * C + B + E);
-				if (ABD >= 0 && CBE >= 0)
-				{
-					qeal f = valueOfQuadircSurface2D(1, 1, A, B, C, D, E, F);
-					if (f < min)
-					{
-						min = f;
-					}
-				}
-			}
-		}
-
-		min -= norrow;
-		min = Check_QEAL_ZERO(min);
-
-		if (min > 0.0)
-			return false;
-
-		return true;
-	}
-
 	bool ccd(Vector3 & C1, Vector3 & V1, Vector3 & C2, Vector3 & V2, Vector3 & C3, Vector3 & V3, qeal & R1, qeal & R2, qeal & R3, qeal & ftc, bool space_triangle, qeal norrow)
 	{
 		bool collide = false;
@@ -727,7 +523,7 @@ namespace CDMM
 					{
 						qeal scale = 0.9;
 						qeal xp = ft;
-						while (fx < -norrow)
+						while (fx < -norrow && scale > 0.0)
 						{
 							xp = ft * scale;
 							Ct = JC_2 * xp * xp + JC_1 * xp + JC_0;
@@ -829,7 +625,7 @@ namespace CDMM
 					{
 						qeal scale = 0.9;
 						qeal xp = ft;
-						while (fx < -norrow)
+						while (fx < -norrow && scale > 0.0)
 						{
 							xp = ft * scale;
 							At = JA_2 * xp * xp + JA_1 * xp + JA_0;
@@ -927,7 +723,7 @@ namespace CDMM
 					{
 						qeal scale = 0.9;
 						qeal xp = ft;
-						while (fx < -norrow)
+						while (fx < -norrow && scale > 0.0)
 						{
 							xp = ft * scale;
 							At = JA_2 * xp * xp + JA_1 * xp + JA_0;
@@ -1029,7 +825,7 @@ namespace CDMM
 					{
 						qeal scale = 0.9;
 						qeal xp = ft;
-						while (fx < -norrow)
+						while (fx < -norrow && scale > 0.0)
 						{
 							xp = ft * scale;
 							At = JA_2 * xp * xp + JA_1 * xp + JA_0;
@@ -1139,7 +935,7 @@ namespace CDMM
 					{
 						qeal scale = 0.9;
 						qeal xp = ft;
-						while (fx < -norrow)
+						while (fx < -norrow && scale > 0.0)
 						{
 							xp = ft * scale;
 							At = JA_2 * xp * xp + JA_1 * xp + JA_0;
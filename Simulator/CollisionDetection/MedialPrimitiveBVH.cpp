@@ -0,0 +1,217 @@
+#include "Simulator\CollisionDetection\MedialPrimitiveBVH.h"
+
+namespace CDMM
+{
+	void MedialPrimitiveBVH::build(const std::vector<qeal>& boxes)
+	{
+		_primitivesNum = boxes.size() / 6;
+		_primitiveBox = boxes;
+		_primitiveOrder.resize(_primitivesNum);
+		std::vector<qeal> centers(3 * _primitivesNum);
+		for (int i = 0; i < _primitivesNum; i++)
+		{
+			_primitiveOrder[i] = i;
+			for (int k = 0; k < 3; k++)
+				centers[3 * i + k] = 0.5 * (boxes[6 * i + k] + boxes[6 * i + 3 + k]);
+		}
+
+		_nodeBox.clear();
+		_nodeChild.clear();
+		_nodePrimitiveStart.clear();
+		_nodePrimitiveNum.clear();
+		if (_primitivesNum == 0)
+			return;
+		buildNode(0, _primitivesNum, centers);
+	}
+
+	int MedialPrimitiveBVH::buildNode(int begin, int end, const std::vector<qeal>& centers)
+	{
+		int node = _nodePrimitiveStart.size();
+		_nodeBox.resize(6 * (node + 1));
+		_nodeChild.resize(2 * (node + 1), -1);
+		_nodePrimitiveStart.push_back(begin);
+		_nodePrimitiveNum.push_back(end - begin);
+
+		qeal* box = _nodeBox.data() + 6 * node;
+		qeal cmin[3] = { QEAL_MAX, QEAL_MAX, QEAL_MAX };
+		qeal cmax[3] = { -QEAL_MAX, -QEAL_MAX, -QEAL_MAX };
+		for (int k = 0; k < 3; k++)
+		{
+			box[k] = QEAL_MAX;
+			box[3 + k] = -QEAL_MAX;
+		}
+		for (int i = begin; i < end; i++)
+		{
+			int pid = _primitiveOrder[i];
+			for (int k = 0; k < 3; k++)
+			{
+				box[k] = std::min(box[k], _primitiveBox[6 * pid + k]);
+				box[3 + k] = std::max(box[3 + k], _primitiveBox[6 * pid + 3 + k]);
+				cmin[k] = std::min(cmin[k], centers[3 * pid + k]);
+				cmax[k] = std::max(cmax[k], centers[3 * pid + k]);
+			}
+		}
+
+		if (end - begin <= MEDIAL_BVH_LEAF_SIZE)
+			return node;
+
+		// median split along the longest axis of the centers
+		int axis = 0;
+		if (cmax[1] - cmin[1] > cmax[axis] - cmin[axis]) axis = 1;
+		if (cmax[2] - cmin[2] > cmax[axis] - cmin[axis]) axis = 2;
+		int mid = (begin + end) / 2;
+		std::nth_element(_primitiveOrder.begin() + begin, _primitiveOrder.begin() + mid, _primitiveOrder.begin() + end,
+			[&](int a, int b) {return centers[3 * a + axis] < centers[3 * b + axis]; });
+
+		int left = buildNode(begin, mid, centers);
+		int right = buildNode(mid, end, centers);
+		_nodeChild[2 * node] = left;
+		_nodeChild[2 * node + 1] = right;
+		return node;
+	}
+
+	void MedialPrimitiveBVH::refit(const std::vector<qeal>& boxes)
+	{
+		_primitiveBox = boxes;
+		int nodesNum = _nodePrimitiveStart.size();
+		for (int node = nodesNum - 1; node >= 0; node--)
+		{
+			qeal* box = _nodeBox.data() + 6 * node;
+			int left = _nodeChild[2 * node];
+			int right = _nodeChild[2 * node + 1];
+			if (left >= 0)
+			{
+				qeal* lbox = _nodeBox.data() + 6 * left;
+				qeal* rbox = _nodeBox.data() + 6 * right;
+				for (int k = 0; k < 3; k++)
+				{
+					box[k] = std::min(lbox[k], rbox[k]);
+					box[3 + k] = std::max(lbox[3 + k], rbox[3 + k]);
+				}
+				continue;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				box[k] = QEAL_MAX;
+				box[3 + k] = -QEAL_MAX;
+			}
+			for (int i = _nodePrimitiveStart[node]; i < _nodePrimitiveStart[node] + _nodePrimitiveNum[node]; i++)
+			{
+				int pid = _primitiveOrder[i];
+				for (int k = 0; k < 3; k++)
+				{
+					box[k] = std::min(box[k], _primitiveBox[6 * pid + k]);
+					box[3 + k] = std::max(box[3 + k], _primitiveBox[6 * pid + 3 + k]);
+				}
+			}
+		}
+	}
+
+	void MedialPrimitiveBVH::queryBox(const qeal* box, int minId, std::vector<int>& hits)
+	{
+		if (_nodePrimitiveStart.size() == 0)
+			return;
+		std::vector<int> stack;
+		stack.push_back(0);
+		while (stack.size() > 0)
+		{
+			int node = stack.back();
+			stack.pop_back();
+			if (!isOverlap(box, _nodeBox.data() + 6 * node))
+				continue;
+			int left = _nodeChild[2 * node];
+			if (left >= 0)
+			{
+				stack.push_back(left);
+				stack.push_back(_nodeChild[2 * node + 1]);
+				continue;
+			}
+			for (int i = _nodePrimitiveStart[node]; i < _nodePrimitiveStart[node] + _nodePrimitiveNum[node]; i++)
+			{
+				int pid = _primitiveOrder[i];
+				if (pid <= minId)
+					continue;
+				if (isOverlap(box, _primitiveBox.data() + 6 * pid))
+					hits.push_back(pid);
+			}
+		}
+	}
+
+	void MedialPrimitiveBVH::selfOverlap(std::vector<std::pair<int, int>>& pairs)
+	{
+		pairs.clear();
+		#pragma omp parallel
+		{
+			std::vector<std::pair<int, int>> localPairs;
+			std::vector<int> hits;
+			#pragma omp for
+			for (int i = 0; i < _primitivesNum; i++)
+			{
+				hits.clear();
+				queryBox(_primitiveBox.data() + 6 * i, i, hits);
+				for (int j = 0; j < hits.size(); j++)
+					localPairs.push_back(std::pair<int, int>(i, hits[j]));
+			}
+			#pragma omp critical
+			pairs.insert(pairs.end(), localPairs.begin(), localPairs.end());
+		}
+		// threads finish in any order
+		std::sort(pairs.begin(), pairs.end());
+	}
+
+	void MedialPrimitiveBVH::overlap(const std::vector<qeal>& boxes, std::vector<std::pair<int, int>>& pairs)
+	{
+		pairs.clear();
+		int boxesNum = boxes.size() / 6;
+		#pragma omp parallel
+		{
+			std::vector<std::pair<int, int>> localPairs;
+			std::vector<int> hits;
+			#pragma omp for
+			for (int i = 0; i < boxesNum; i++)
+			{
+				hits.clear();
+				queryBox(boxes.data() + 6 * i, -1, hits);
+				for (int j = 0; j < hits.size(); j++)
+					localPairs.push_back(std::pair<int, int>(i, hits[j]));
+			}
+			#pragma omp critical
+			pairs.insert(pairs.end(), localPairs.begin(), localPairs.end());
+		}
+		std::sort(pairs.begin(), pairs.end());
+	}
+
+	bool MedialPrimitiveBVH::writeBinary(const std::string filename)
+	{
+		std::ofstream fout(filename.c_str(), std::ios::binary);
+		if (!fout.is_open())
+			return false;
+		fout.write((const char*)&_primitivesNum, sizeof(int));
+		StlBinaryIO::writeOneLevelVector(fout, _primitiveBox);
+		StlBinaryIO::writeOneLevelVector(fout, _primitiveOrder);
+		StlBinaryIO::writeOneLevelVector(fout, _nodeBox);
+		StlBinaryIO::writeOneLevelVector(fout, _nodeChild);
+		StlBinaryIO::writeOneLevelVector(fout, _nodePrimitiveStart);
+		StlBinaryIO::writeOneLevelVector(fout, _nodePrimitiveNum);
+		fout.close();
+		return true;
+	}
+
+	bool MedialPrimitiveBVH::readBinary(const std::string filename)
+	{
+		std::ifstream fin(filename.c_str(), std::ios::binary);
+		if (!fin.is_open())
+			return false;
+		fin.read((char*)&_primitivesNum, sizeof(int));
+		StlBinaryIO::readOneLevelVector(fin, _primitiveBox);
+		StlBinaryIO::readOneLevelVector(fin, _primitiveOrder);
+		StlBinaryIO::readOneLevelVector(fin, _nodeBox);
+		StlBinaryIO::readOneLevelVector(fin, _nodeChild);
+		StlBinaryIO::readOneLevelVector(fin, _nodePrimitiveStart);
+		StlBinaryIO::readOneLevelVector(fin, _nodePrimitiveNum);
+		bool valid = fin.good() && _primitiveBox.size() == 6 * _primitivesNum && _primitiveOrder.size() == _primitivesNum;
+		fin.close();
+		return valid;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef MEDIAL_PRIMITIVE_BVH_H
+#define MEDIAL_PRIMITIVE_BVH_H
+#include "DataCore.h"
+#include "Commom\FileIO.h"
+#include <vector>
+#include <algorithm>
+
+namespace CDMM
+{
+#define MEDIAL_BVH_LEAF_SIZE 4
+
+	// aabb tree over medial primitive boxes, a box is stored as (min x, min y, min z, max x, max y, max z)
+	// the topology is fixed at build time, refit only updates the node boxes
+	class MedialPrimitiveBVH
+	{
+	public:
+		MedialPrimitiveBVH() : _primitivesNum(0) {}
+
+		void build(const std::vector<qeal>& boxes);
+		void refit(const std::vector<qeal>& boxes);
+		// overlapping primitive pairs (i, j) with i < j
+		void selfOverlap(std::vector<std::pair<int, int>>& pairs);
+		// pairs (i, j) of an external box i overlapping primitive j of this tree
+		void overlap(const std::vector<qeal>& boxes, std::vector<std::pair<int, int>>& pairs);
+
+		bool writeBinary(const std::string filename);
+		bool readBinary(const std::string filename);
+		const std::vector<qeal>& getPrimitiveBoxes() { return _primitiveBox; }
+
+		int getPrimitivesNum() { return _primitivesNum; }
+		int getNodesNum() { return _nodeChild.size() / 2; }
+	protected:
+		int buildNode(int begin, int end, const std::vector<qeal>& centers);
+		void queryBox(const qeal* box, int minId, std::vector<int>& hits);
+		bool isOverlap(const qeal* box1, const qeal* box2)
+		{
+			return box1[0] <= box2[3] && box2[0] <= box1[3] &&
+				box1[1] <= box2[4] && box2[1] <= box1[4] &&
+				box1[2] <= box2[5] && box2[2] <= box1[5];
+		}
+
+		int _primitivesNum;
+		std::vector<qeal> _primitiveBox;
+		std::vector<int> _primitiveOrder;
+		// children of node i are (2i, 2i + 1) in _nodeChild, -1 for leaves; parents always precede children
+		std::vector<qeal> _nodeBox;
+		std::vector<int> _nodeChild;
+		std::vector<int> _nodePrimitiveStart;
+		std::vector<int> _nodePrimitiveNum;
+	};
+}
+
+#endif
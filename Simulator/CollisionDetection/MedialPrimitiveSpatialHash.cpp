@@ -0,0 +1,179 @@
+#include "Simulator\CollisionDetection\MedialPrimitiveSpatialHash.h"
+
+namespace CDMM
+{
+	// in place inclusive prefix sum, every thread scans one chunk, then adds the sums of the chunks before it
+	static void parallelPrefixSum(int* data, int n)
+	{
+		int chunkNum = omp_get_max_threads();
+		std::vector<int> chunkSum(chunkNum + 1, 0);
+		#pragma omp parallel for
+		for (int c = 0; c < chunkNum; c++)
+		{
+			int begin = (long long)n * c / chunkNum;
+			int end = (long long)n * (c + 1) / chunkNum;
+			for (int k = begin + 1; k < end; k++)
+				data[k] += data[k - 1];
+			chunkSum[c + 1] = end > begin ? data[end - 1] : 0;
+		}
+		for (int c = 0; c < chunkNum; c++)
+			chunkSum[c + 1] += chunkSum[c];
+		#pragma omp parallel for
+		for (int c = 1; c < chunkNum; c++)
+		{
+			int begin = (long long)n * c / chunkNum;
+			int end = (long long)n * (c + 1) / chunkNum;
+			for (int k = begin; k < end; k++)
+				data[k] += chunkSum[c];
+		}
+	}
+
+	void MedialPrimitiveSpatialHash::build(const std::vector<qeal>& boxes)
+	{
+		int primitivesNum = boxes.size() / 6;
+		_primitiveBox = boxes;
+		_primitiveCellRange.resize(6 * primitivesNum);
+		_primitiveEntryOffset.resize(primitivesNum + 1);
+
+		std::vector<char> overflow(primitivesNum, 0);
+		#pragma omp parallel for
+		for (int i = 0; i < primitivesNum; i++)
+		{
+			int* range = _primitiveCellRange.data() + 6 * i;
+			for (int k = 0; k < 6; k++)
+				range[k] = cellCoord(boxes[6 * i + k]);
+			long long cells = (long long)(range[3] - range[0] + 1) * (range[4] - range[1] + 1) * (range[5] - range[2] + 1);
+			overflow[i] = cells > SPATIAL_HASH_MAX_PRIMITIVE_CELLS;
+			_primitiveEntryOffset[i + 1] = overflow[i] ? 0 : (int)cells;
+		}
+		_primitiveEntryOffset[0] = 0;
+		parallelPrefixSum(_primitiveEntryOffset.data() + 1, primitivesNum);
+		int entriesNum = _primitiveEntryOffset[primitivesNum];
+		_overflowPrimitive.clear();
+		for (int i = 0; i < primitivesNum; i++)
+			if (overflow[i])
+				_overflowPrimitive.push_back(i);
+
+		_tableSize = 1;
+		while (_tableSize < 2 * entriesNum)
+			_tableSize <<= 1;
+
+		// every primitive writes its own entries, no contention
+		std::vector<int> entryBucket(entriesNum);
+		#pragma omp parallel for
+		for (int i = 0; i < primitivesNum; i++)
+		{
+			if (overflow[i])
+				continue;
+			int* range = _primitiveCellRange.data() + 6 * i;
+			int e = _primitiveEntryOffset[i];
+			for (int x = range[0]; x <= range[3]; x++)
+				for (int y = range[1]; y <= range[4]; y++)
+					for (int z = range[2]; z <= range[5]; z++)
+						entryBucket[e++] = hashCell(x, y, z);
+		}
+
+		// counting sort of the entries by bucket: every thread counts its chunk of primitives in its own histogram,
+		// the per bucket totals are scanned in parallel, then every thread scatters its chunk behind the chunks before it
+		int chunkNum = omp_get_max_threads();
+		std::vector<int> histogram((size_t)chunkNum * _tableSize, 0);
+		#pragma omp parallel for
+		for (int c = 0; c < chunkNum; c++)
+		{
+			int* count = histogram.data() + (size_t)c * _tableSize;
+			int begin = _primitiveEntryOffset[(long long)primitivesNum * c / chunkNum];
+			int end = _primitiveEntryOffset[(long long)primitivesNum * (c + 1) / chunkNum];
+			for (int e = begin; e < end; e++)
+				count[entryBucket[e]]++;
+		}
+		_bucketOffset.resize(_tableSize + 1);
+		_bucketOffset[0] = 0;
+		#pragma omp parallel for
+		for (int b = 0; b < _tableSize; b++)
+		{
+			// the histogram turns into the offset of every chunk inside the bucket
+			int sum = 0;
+			for (int c = 0; c < chunkNum; c++)
+			{
+				int n = histogram[(size_t)c * _tableSize + b];
+				histogram[(size_t)c * _tableSize + b] = sum;
+				sum += n;
+			}
+			_bucketOffset[b + 1] = sum;
+		}
+		parallelPrefixSum(_bucketOffset.data() + 1, _tableSize);
+		_bucketPrimitive.resize(entriesNum);
+		#pragma omp parallel for
+		for (int c = 0; c < chunkNum; c++)
+		{
+			int* fill = histogram.data() + (size_t)c * _tableSize;
+			int begin = (long long)primitivesNum * c / chunkNum;
+			int end = (long long)primitivesNum * (c + 1) / chunkNum;
+			for (int i = begin; i < end; i++)
+				for (int e = _primitiveEntryOffset[i]; e < _primitiveEntryOffset[i + 1]; e++)
+				{
+					int b = entryBucket[e];
+					_bucketPrimitive[_bucketOffset[b] + fill[b]++] = i;
+				}
+		}
+	}
+
+	void MedialPrimitiveSpatialHash::selfOverlap(std::vector<std::pair<int, int>>& pairs)
+	{
+		pairs.clear();
+		#pragma omp parallel
+		{
+			std::vector<std::pair<int, int>> localPairs;
+			#pragma omp for
+			for (int b = 0; b < _tableSize; b++)
+			{
+				for (int s = _bucketOffset[b]; s < _bucketOffset[b + 1]; s++)
+				{
+					int i = _bucketPrimitive[s];
+					for (int t = s + 1; t < _bucketOffset[b + 1]; t++)
+					{
+						int j = _bucketPrimitive[t];
+						if (i == j)
+							continue;
+						const qeal* bi = _primitiveBox.data() + 6 * i;
+						const qeal* bj = _primitiveBox.data() + 6 * j;
+						if (!isOverlap(bi, bj))
+							continue;
+						// a pair shares several cells, only the bucket of the lowest shared cell reports it
+						const int* ri = _primitiveCellRange.data() + 6 * i;
+						const int* rj = _primitiveCellRange.data() + 6 * j;
+						if (hashCell(std::max(ri[0], rj[0]), std::max(ri[1], rj[1]), std::max(ri[2], rj[2])) != b)
+							continue;
+						if (i < j)
+							localPairs.push_back(std::pair<int, int>(i, j));
+						else localPairs.push_back(std::pair<int, int>(j, i));
+					}
+				}
+			}
+
+			// the oversized primitives are checked against all others, a pair of two of them only from the lower one
+			int primitivesNum = _primitiveBox.size() / 6;
+			#pragma omp for
+			for (int k = 0; k < (int)_overflowPrimitive.size(); k++)
+			{
+				int i = _overflowPrimitive[k];
+				const qeal* bi = _primitiveBox.data() + 6 * i;
+				for (int j = 0; j < primitivesNum; j++)
+				{
+					if (i == j || !isOverlap(bi, _primitiveBox.data() + 6 * j))
+						continue;
+					if (std::binary_search(_overflowPrimitive.begin(), _overflowPrimitive.end(), j) && j < i)
+						continue;
+					if (i < j)
+						localPairs.push_back(std::pair<int, int>(i, j));
+					else localPairs.push_back(std::pair<int, int>(j, i));
+				}
+			}
+			#pragma omp critical
+			pairs.insert(pairs.end(), localPairs.begin(), localPairs.end());
+		}
+		// distinct cells of one primitive may fall into the same bucket
+		std::sort(pairs.begin(), pairs.end());
+		pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+	}
+}
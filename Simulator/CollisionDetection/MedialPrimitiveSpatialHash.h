@@ -0,0 +1,54 @@
+#pragma once
+#ifndef MEDIAL_PRIMITIVE_SPATIAL_HASH_H
+#define MEDIAL_PRIMITIVE_SPATIAL_HASH_H
+#include "DataCore.h"
+#include <vector>
+#include <algorithm>
+#include <omp.h>
+
+namespace CDMM
+{
+	// a primitive covering more cells than this skips the table and is tested against every primitive
+#define SPATIAL_HASH_MAX_PRIMITIVE_CELLS 64
+
+	// uniform grid hashed into a flat table, rebuilt from scratch with a parallel counting sort
+	// a box is stored as (min x, min y, min z, max x, max y, max z)
+	class MedialPrimitiveSpatialHash
+	{
+	public:
+		MedialPrimitiveSpatialHash() : _cellSize(1.0), _tableSize(0) {}
+
+		void setCellSize(qeal cellSize) { _cellSize = cellSize; }
+		qeal getCellSize() { return _cellSize; }
+		void build(const std::vector<qeal>& boxes);
+		// overlapping primitive pairs (i, j) with i < j
+		void selfOverlap(std::vector<std::pair<int, int>>& pairs);
+	protected:
+		int cellCoord(qeal x) { return (int)std::floor(x / _cellSize); }
+		int hashCell(int x, int y, int z)
+		{
+			unsigned int h = ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u);
+			return h & (_tableSize - 1);
+		}
+		bool isOverlap(const qeal* box1, const qeal* box2)
+		{
+			return box1[0] <= box2[3] && box2[0] <= box1[3] &&
+				box1[1] <= box2[4] && box2[1] <= box1[4] &&
+				box1[2] <= box2[5] && box2[2] <= box1[5];
+		}
+
+		qeal _cellSize;
+		int _tableSize;
+		std::vector<qeal> _primitiveBox;
+		// cell range per primitive, (min x, min y, min z, max x, max y, max z)
+		std::vector<int> _primitiveCellRange;
+		std::vector<int> _primitiveEntryOffset;
+		// entries grouped by bucket, _bucketOffset has _tableSize + 1 items
+		std::vector<int> _bucketOffset;
+		std::vector<int> _bucketPrimitive;
+		// primitives over SPATIAL_HASH_MAX_PRIMITIVE_CELLS, not in any bucket
+		std::vector<int> _overflowPrimitive;
+	};
+}
+
+#endif
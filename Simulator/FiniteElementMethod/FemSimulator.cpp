@@ -1,5 +1,6 @@
 #include "FemSimulator.h"
 #include "Commom\SPDProjectFunction.h"
+#include "Simulator\FiniteElementMethod\StableNeoHookean.h"
 #include <QElapsedTimer>
 
 namespace FiniteElementMethod
@@ -587,15 +588,6 @@ namespace FiniteElementMethod
 
 		qeal J = F.determinant();
 
-		Matrix3 dJdF;
-		qeal dJdF11 = F22 * F33 - F23 * F32;   qeal dJdF12 = F23 * F31 - F21 * F33;   qeal dJdF13 = F21 * F32 - F22 * F31;
-		qeal dJdF21 = F13 * F32 - F12 * F33;   qeal dJdF22 = F11 * F33 - F13 * F31;   qeal dJdF23 = F12 * F31 - F11 * F32;
-		qeal dJdF31 = F12 * F23 - F13 * F22;   qeal dJdF32 = F13 * F21 - F11 * F23;   qeal dJdF33 = F11 * F22 - F12 * F21;
-
-		dJdF.data()[0] = dJdF11;   dJdF.data()[3] = dJdF12;   dJdF.data()[6] = dJdF13;
-		dJdF.data()[1] = dJdF21;   dJdF.data()[4] = dJdF22;   dJdF.data()[7] = dJdF23;
-		dJdF.data()[2] = dJdF31;   dJdF.data()[5] = dJdF32;   dJdF.data()[8] = dJdF33;
-
 		ENuMaterial * material = downcastENuMaterial(tet->getElementMaterial(eid));
 
 		qeal lameMiu = material->getMu();
@@ -614,8 +606,7 @@ namespace FiniteElementMethod
 		qeal a2 = lamda;
 		qeal a3 = lamda * (J - alpha);
 
-		FPK.setZero();
-		FPK = a0 * F + a3 * dJdF;
+		stableNeoHookeanStress(F.data(), miu, lamda, FPK.data());
 		Matrix3 mU, mV, mSingularF;
 		computeSVD(F, mU, mV, mSingularF, 1e-8, 1);
 		qeal singularF0 = mSingularF.data()[0], singularF1 = mSingularF.data()[4], singularF2 = mSingularF.data()[8];
@@ -184,6 +184,7 @@ void  FiniteElementMethod::LinearReducedFrame::transform()
 	_p[0] = _x + dx;
 	_p[1] = _y + dy;
 	_p[2] = _z + dz;
+	accumulateMotion();
 }
 
 void  FiniteElementMethod::QuadraticReducedFrame::projectFullspaceX(qeal* X, qeal w, qeal* oriP)
@@ -340,6 +341,7 @@ void  FiniteElementMethod::QuadraticReducedFrame::transform()
 	_p[0] = _x + dx;
 	_p[1] = _y + dy;
 	_p[2] = _z + dz;
+	accumulateMotion();
 }
 
 void FiniteElementMethod::TranslationReducedFrame::projectFullspaceX(qeal * X, qeal w, qeal * oriP)
@@ -404,4 +406,5 @@ void FiniteElementMethod::TranslationReducedFrame::transform()
 	_p[0] = _x + dx;
 	_p[1] = _y + dy;
 	_p[2] = _z + dz;
+	accumulateMotion();
 }
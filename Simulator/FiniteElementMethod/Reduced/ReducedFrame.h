@@ -36,6 +36,7 @@ namespace FiniteElementMethod
 			_z = p[2];
 
 			_lastX = _x, _lastY = _y, _lastZ = _y;
+			_motion = 0.0;
 		}
 
 		ReducedFrame(qeal* p, int offset = -1)
@@ -58,6 +59,7 @@ namespace FiniteElementMethod
 			_z = p[2];
 
 			_lastX = _x, _lastY = _y, _lastZ = _z;
+			_motion = 0.0;
 		}
 
 
@@ -82,6 +84,7 @@ namespace FiniteElementMethod
 			_z = p[2];
 
 			_lastX = _x, _lastY = _y, _lastZ = _z;
+			_motion = 0.0;
 		}
 
 
@@ -102,6 +105,15 @@ namespace FiniteElementMethod
 		{
 			lastP[0] = _lastX; lastP[1] = _lastY; lastP[2] = _lastZ;
 		}
+		// path length of _p over all transforms, an upper bound of the displacement between any two of them
+		qeal getMotion() { return _motion; }
+		void accumulateMotion()
+		{
+			qeal dx = _p[0] - _lastX;
+			qeal dy = _p[1] - _lastY;
+			qeal dz = _p[2] - _lastZ;
+			_motion += std::sqrt(dx * dx + dy * dy + dz * dz);
+		}
 		qeal* getCurrentX() { return _X; }
 		qeal* getCurrentVel() { return _Vel; }
 		qeal* getCurrentAcc() { return _Acc; }
@@ -140,6 +152,7 @@ namespace FiniteElementMethod
 		int _dim;
 		qeal _x, _y, _z;
 		qeal _lastX, _lastY, _lastZ;
+		qeal _motion;
 	};
 
 	class LinearReducedFrame: public ReducedFrame
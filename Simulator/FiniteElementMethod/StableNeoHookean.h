@@ -0,0 +1,44 @@
+#pragma once
+#ifndef FINITE_ELEMENT_METHOD_STABLE_NEO_HOOKEAN_H
+#define FINITE_ELEMENT_METHOD_STABLE_NEO_HOOKEAN_H
+#include "DataCore.h"
+#include <math.h>
+
+// the same code runs in the cuda kernels and on the host
+#ifdef __CUDACC__
+#define STABLE_NEO_HOOKEAN_FUNC __host__ __device__ __forceinline__
+#else
+#define STABLE_NEO_HOOKEAN_FUNC inline
+#endif
+
+namespace FiniteElementMethod
+{
+	// stable neo-hookean energy density of the column major deformation gradient F
+	STABLE_NEO_HOOKEAN_FUNC qeal stableNeoHookeanEnergy(const qeal* F, qeal mu, qeal lambda)
+	{
+		qeal Ic = F[0] * F[0] + F[1] * F[1] + F[2] * F[2] + F[3] * F[3] + F[4] * F[4] + F[5] * F[5] + F[6] * F[6] + F[7] * F[7] + F[8] * F[8];
+		qeal J = F[0] * (F[4] * F[8] - F[7] * F[5]) - F[3] * (F[1] * F[8] - F[7] * F[2]) + F[6] * (F[1] * F[5] - F[4] * F[2]);
+		qeal alpha = 1.0 + (3.0 * mu) / (4.0 * lambda);
+		return 0.5 * mu * (Ic - 3.0) + 0.5 * lambda * (J - alpha) * (J - alpha) - 0.5 * mu * log(Ic + 1.0);
+	}
+
+	// first piola-kirchhoff stress P of the same energy, column major like F, returns the energy density
+	STABLE_NEO_HOOKEAN_FUNC qeal stableNeoHookeanStress(const qeal* F, qeal mu, qeal lambda, qeal* P)
+	{
+		qeal dJdF[9];
+		dJdF[0] = F[4] * F[8] - F[7] * F[5];   dJdF[3] = F[7] * F[2] - F[1] * F[8];   dJdF[6] = F[1] * F[5] - F[4] * F[2];
+		dJdF[1] = F[6] * F[5] - F[3] * F[8];   dJdF[4] = F[0] * F[8] - F[6] * F[2];   dJdF[7] = F[3] * F[2] - F[0] * F[5];
+		dJdF[2] = F[3] * F[7] - F[6] * F[4];   dJdF[5] = F[6] * F[1] - F[0] * F[7];   dJdF[8] = F[0] * F[4] - F[3] * F[1];
+
+		qeal Ic = F[0] * F[0] + F[1] * F[1] + F[2] * F[2] + F[3] * F[3] + F[4] * F[4] + F[5] * F[5] + F[6] * F[6] + F[7] * F[7] + F[8] * F[8];
+		qeal J = F[0] * dJdF[0] + F[3] * dJdF[3] + F[6] * dJdF[6];
+		qeal alpha = 1.0 + (3.0 * mu) / (4.0 * lambda);
+		qeal a0 = mu * (1.0 - 1.0 / (Ic + 1.0));
+		qeal a3 = lambda * (J - alpha);
+		for (int i = 0; i < 9; i++)
+			P[i] = a0 * F[i] + a3 * dJdF[i];
+		return 0.5 * mu * (Ic - 3.0) + 0.5 * lambda * (J - alpha) * (J - alpha) - 0.5 * mu * log(Ic + 1.0);
+	}
+}
+
+#endif
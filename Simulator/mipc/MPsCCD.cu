@@ -230,6 +230,12 @@ namespace MIPC
 
 			qeal norrow = QEAL_ZERO;
 
+			if (separatedWithinStep(C1, V1, C2, V2, C3, V3, R1[0], R2[0], R3[0], ss, norrow))
+			{
+				devCCD[eventId] = 1.0;
+				continue;
+			}
+
 			JA_2[0] = VectorDot(V1, V1);
 			JA_1[0] = 2.0 * VectorDot(V1, C1);
 			JA_0[0] = VectorDot(C1, C1) - R1[0] * R1[0];
@@ -535,6 +541,38 @@ namespace MIPC
 		return true;
 	}
 
+	__device__ __forceinline__
+		bool separatedWithinStep(qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3, qeal& R1, qeal& R2, qeal& R3, bool ss, qeal norrow)
+	{
+		qeal dist, alpha, beta;
+		computeCollisionDistance(C1, C2, C3, R1, R2, R3, ss, dist, alpha, beta);
+		if (dist <= 0.0)
+			return false;
+
+		// |c| and r are largest at a corner, so are the relative displacements alpha * V1 + beta * V2 + V3
+		qeal cornerAlpha[4] = { 0.0, 1.0, 0.0, 1.0 };
+		qeal cornerBeta[4] = { 0.0, 0.0, 1.0, 1.0 };
+		int cornerNum = ss ? 3 : 4;
+		qeal maxC = 0.0, maxR = 0.0, maxV = 0.0;
+		for (int j = 0; j < cornerNum; j++)
+		{
+			qeal c[3], v[3];
+			for (int i = 0; i < 3; i++)
+			{
+				c[i] = cornerAlpha[j] * C1[i] + cornerBeta[j] * C2[i] + C3[i];
+				v[i] = cornerAlpha[j] * V1[i] + cornerBeta[j] * V2[i] + V3[i];
+			}
+			qeal lc = CUDA_SQRT(VectorDot(c, c));
+			qeal lv = CUDA_SQRT(VectorDot(v, v));
+			qeal r = cornerAlpha[j] * R1 + cornerBeta[j] * R2 + R3;
+			if (lc > maxC) maxC = lc;
+			if (lv > maxV) maxV = lv;
+			if (r > maxR) maxR = r;
+		}
+		// |c| - r >= (|c|^2 - r^2) / (max |c| + max r)
+		return dist / (maxC + maxR) - maxV > CUDA_SQRT(norrow);
+	}
+
 	__device__ __forceinline__
 		void computeCollisionDistance(qeal * C1, qeal * C2, qeal * C3, qeal& R1, qeal& R2, qeal& R3, bool ss, qeal& dist, qeal& alpha, qeal& beta)
 	{
@@ -1859,26 +1897,15 @@ namespace MIPC
 		qeal SolveSexticEqForFTC(qeal& W_6, qeal& W_5, qeal& W_4, qeal& W_3, qeal& W_2, qeal& W_1, qeal& W_0, int& banRootsNum, qeal* banRoots, qeal* range, qeal norrow)
 	{
 		qeal ft = 1.0;
-		int count = 0;
-		qeal x[6];
-		//range[RANGE_MIN_INDEX] = 0.0;
-		//range[RANGE_MAX_INDEX] = 1.0;
-
-		if (IS_Numerical_ZERO(W_6) && IS_Numerical_ZERO(W_5))
-		{
-			if (solveQuarticEquation(W_4, W_3, W_2, W_1, W_0, x, count, true, range[RANGE_MIN_INDEX], range[RANGE_MAX_INDEX]))
-			{
-				if (x[0] > 0 && x[0] < 1)
-					ft = x[0];
-			}
-			else
-			{
-				qeal fx = computeSexticEquation(range[RANGE_MAX_INDEX], W_6, W_5, W_4, W_3, W_2, W_1, W_0);
-				if (fx > 0) ft = range[RANGE_MAX_INDEX];
-				else ft = NewtonSolverSexticEqForFTC(W_6, W_5, W_4, W_3, W_2, W_1, W_0, range, norrow);
-			}
-		}
-		else ft = NewtonSolverSexticEqForFTC(W_6, W_5, W_4, W_3, W_2, W_1, W_0, range, norrow);
+		qeal x;
+		// bounded bernstein isolation instead of the quartic / newton branches, a root at t = 0 is the contact we start from,
+		// so the search goes on over (eps, max] like the host solver
+		qeal tol = norrow > CUDA_CCD_NORROW ? norrow : CUDA_CCD_NORROW;
+		bool found = PolynoimalSolver::solveSexticEarliestRoot(W_6, W_5, W_4, W_3, W_2, W_1, W_0, x, range[RANGE_MIN_INDEX], range[RANGE_MAX_INDEX], tol, CUDA_BERNSTEIN_PRECISION, CUDA_BERNSTEIN_MAX_STEPS);
+		if (found && x <= 0.0 && range[RANGE_MAX_INDEX] > CUDA_CCD_TOUCH_EPSILON)
+			found = PolynoimalSolver::solveSexticEarliestRoot(W_6, W_5, W_4, W_3, W_2, W_1, W_0, x, CUDA_CCD_TOUCH_EPSILON, range[RANGE_MAX_INDEX], tol, CUDA_BERNSTEIN_PRECISION, CUDA_BERNSTEIN_MAX_STEPS);
+		if (found && x > 0.0)
+			ft = x;
 
 		for (int j = 0; j < banRootsNum; j++)
 		{
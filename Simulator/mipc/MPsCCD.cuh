@@ -2,20 +2,22 @@
 #define Medial_Primitives_CCD_CUH
 #include "Simulator\Cuda\CudaHeader.cuh"
 #include "Simulator\Cuda\CudaMatrixOperator.cuh"
+#include "MPsCCDEvent.h"
+#include "Commom\SexticRootSolver.h"
 
 namespace MIPC
 {
-#define COLLISION_CC 0
-#define COLLISION_SS 1
-#define COLLISION_DEFORMABLE_WITH_STATIC_CC 2
-#define COLLISION_DEFORMABLE_WITH_STATIC_SS 3
-#define COLLISION_STATIC_WITH_DEFORMABLE_CC 4
-#define COLLISION_STATIC_WITH_DEFORMABLE_SS 5
-
 #define RANGE_FLAG 0
 #define RANGE_MIN_INDEX 1
 #define RANGE_MAX_INDEX 2
 
+// split budget and precision of PolynoimalSolver::solveSexticEarliestRoot in the kernels
+#define CUDA_BERNSTEIN_MAX_STEPS 96
+#define CUDA_BERNSTEIN_PRECISION 1e-10
+// same as CDMM_NORROW and CDMM_TOUCH_EPSILON of the host solver
+#define CUDA_CCD_NORROW 1e-8
+#define CUDA_CCD_TOUCH_EPSILON 1e-6
+
 	__host__ void MPsCCD
 	(
 		int hostCollisionEventNum,
@@ -50,6 +52,10 @@ namespace MIPC
 	__device__ __forceinline__
 		bool dcd(qeal A, qeal B, qeal C, qeal D, qeal E, qeal F, bool is_ss, qeal norrow);
 
+	// |c| - r minus the largest relative displacement of the four spheres, no contact within the step if it stays above sqrt(norrow)
+	__device__ __forceinline__
+		bool separatedWithinStep(qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3, qeal& R1, qeal& R2, qeal& R3, bool ss, qeal norrow);
+
 	__device__ __forceinline__
 		bool ccd(qeal * C1, qeal * V1, qeal * C2, qeal * V2, qeal * C3, qeal * V3, qeal& R1, qeal& R2, qeal& R3, bool ss, qeal& ftc);
 
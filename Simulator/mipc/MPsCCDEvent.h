@@ -0,0 +1,15 @@
+#ifndef Medial_Primitives_CCD_EVENT_H
+#define Medial_Primitives_CCD_EVENT_H
+
+namespace MIPC
+{
+	// flag of a collision event list entry, shared by MPsCCD and the host ccd
+#define COLLISION_CC 0
+#define COLLISION_SS 1
+#define COLLISION_DEFORMABLE_WITH_STATIC_CC 2
+#define COLLISION_DEFORMABLE_WITH_STATIC_SS 3
+#define COLLISION_STATIC_WITH_DEFORMABLE_CC 4
+#define COLLISION_STATIC_WITH_DEFORMABLE_SS 5
+}
+
+#endif
@@ -0,0 +1,417 @@
+#include "MPsCCDHost.h"
+
+namespace MIPC
+{
+	qeal MPsCCDHost
+	(
+		int hostCollisionEventNum,
+		qeal* medialPointPosition,
+		qeal* medialPointRadius,
+		qeal* staticMedialPointPosition,
+		qeal* staticMedialPointRadius,
+		qeal* medialPointMovingDir,
+		int* hostCollisionEventList,
+		qeal lowerBound
+	)
+	{
+		qeal toi = 1.0;
+		int batchNum = (hostCollisionEventNum + (MPS_CCD_HOST_BATCH - 1)) / MPS_CCD_HOST_BATCH;
+		// set by the first thread whose min reaches lowerBound, the others then skip their remaining batches
+		volatile int reachLowerBound = 0;
+
+#pragma omp parallel
+		{
+			// structure of arrays, one column per event of the batch
+			qeal C1[3][MPS_CCD_HOST_BATCH], C2[3][MPS_CCD_HOST_BATCH], C3[3][MPS_CCD_HOST_BATCH];
+			qeal V1[3][MPS_CCD_HOST_BATCH], V2[3][MPS_CCD_HOST_BATCH], V3[3][MPS_CCD_HOST_BATCH];
+			qeal R1[MPS_CCD_HOST_BATCH], R2[MPS_CCD_HOST_BATCH], R3[MPS_CCD_HOST_BATCH];
+			bool ss[MPS_CCD_HOST_BATCH];
+			qeal JA_2[MPS_CCD_HOST_BATCH], JA_1[MPS_CCD_HOST_BATCH], JA_0[MPS_CCD_HOST_BATCH];
+			qeal JB_2[MPS_CCD_HOST_BATCH], JB_1[MPS_CCD_HOST_BATCH], JB_0[MPS_CCD_HOST_BATCH];
+			qeal JC_2[MPS_CCD_HOST_BATCH], JC_1[MPS_CCD_HOST_BATCH], JC_0[MPS_CCD_HOST_BATCH];
+			qeal JD_2[MPS_CCD_HOST_BATCH], JD_1[MPS_CCD_HOST_BATCH], JD_0[MPS_CCD_HOST_BATCH];
+			qeal JE_2[MPS_CCD_HOST_BATCH], JE_1[MPS_CCD_HOST_BATCH], JE_0[MPS_CCD_HOST_BATCH];
+			qeal JF_2[MPS_CCD_HOST_BATCH], JF_1[MPS_CCD_HOST_BATCH], JF_0[MPS_CCD_HOST_BATCH];
+			qeal localToi = 1.0;
+
+#pragma omp for schedule(dynamic)
+			for (int b = 0; b < batchNum; b++)
+			{
+				if (reachLowerBound)
+					continue;
+				int begin = b * MPS_CCD_HOST_BATCH;
+				int num = hostCollisionEventNum - begin;
+				if (num > MPS_CCD_HOST_BATCH)
+					num = MPS_CCD_HOST_BATCH;
+
+				int eventNum = num;
+				num = 0;
+				for (int e = 0; e < eventNum; e++)
+				{
+					qeal c1[3], c2[3], c3[3], v1[3], v2[3], v3[3];
+					ss[num] = gatherMPsCCDEvent(hostCollisionEventList + 5 * (begin + e), medialPointPosition, medialPointRadius, staticMedialPointPosition, staticMedialPointRadius, medialPointMovingDir, c1, v1, c2, v2, c3, v3, R1[num], R2[num], R3[num]);
+					if (isMPsCCDEventSeparated(c1, v1, c2, v2, c3, v3, R1[num], R2[num], R3[num], ss[num]))
+						continue;
+					for (int i = 0; i < 3; i++)
+					{
+						C1[i][num] = c1[i]; C2[i][num] = c2[i]; C3[i][num] = c3[i];
+						V1[i][num] = v1[i]; V2[i][num] = v2[i]; V3[i][num] = v3[i];
+					}
+					num++;
+				}
+
+				// branch free, the dots grouped as in CDMM::ccd so the roots match it
+				for (int k = 0; k < num; k++)
+				{
+					JA_2[k] = V1[0][k] * V1[0][k] + V1[1][k] * V1[1][k] + V1[2][k] * V1[2][k];
+					JA_1[k] = 2.0 * (V1[0][k] * C1[0][k] + V1[1][k] * C1[1][k] + V1[2][k] * C1[2][k]);
+					JA_0[k] = C1[0][k] * C1[0][k] + C1[1][k] * C1[1][k] + C1[2][k] * C1[2][k] - R1[k] * R1[k];
+
+					JB_2[k] = 2.0 * (V1[0][k] * V2[0][k] + V1[1][k] * V2[1][k] + V1[2][k] * V2[2][k]);
+					JB_1[k] = 2.0 * ((V1[0][k] * C2[0][k] + V1[1][k] * C2[1][k] + V1[2][k] * C2[2][k]) + (V2[0][k] * C1[0][k] + V2[1][k] * C1[1][k] + V2[2][k] * C1[2][k]));
+					JB_0[k] = 2.0 * ((C1[0][k] * C2[0][k] + C1[1][k] * C2[1][k] + C1[2][k] * C2[2][k]) - R1[k] * R2[k]);
+
+					JC_2[k] = V2[0][k] * V2[0][k] + V2[1][k] * V2[1][k] + V2[2][k] * V2[2][k];
+					JC_1[k] = 2.0 * (V2[0][k] * C2[0][k] + V2[1][k] * C2[1][k] + V2[2][k] * C2[2][k]);
+					JC_0[k] = C2[0][k] * C2[0][k] + C2[1][k] * C2[1][k] + C2[2][k] * C2[2][k] - R2[k] * R2[k];
+
+					JD_2[k] = 2.0 * (V1[0][k] * V3[0][k] + V1[1][k] * V3[1][k] + V1[2][k] * V3[2][k]);
+					JD_1[k] = 2.0 * ((V1[0][k] * C3[0][k] + V1[1][k] * C3[1][k] + V1[2][k] * C3[2][k]) + (V3[0][k] * C1[0][k] + V3[1][k] * C1[1][k] + V3[2][k] * C1[2][k]));
+					JD_0[k] = 2.0 * ((C1[0][k] * C3[0][k] + C1[1][k] * C3[1][k] + C1[2][k] * C3[2][k]) - R1[k] * R3[k]);
+
+					JE_2[k] = 2.0 * (V2[0][k] * V3[0][k] + V2[1][k] * V3[1][k] + V2[2][k] * V3[2][k]);
+					JE_1[k] = 2.0 * ((V2[0][k] * C3[0][k] + V2[1][k] * C3[1][k] + V2[2][k] * C3[2][k]) + (V3[0][k] * C2[0][k] + V3[1][k] * C2[1][k] + V3[2][k] * C2[2][k]));
+					JE_0[k] = 2.0 * ((C2[0][k] * C3[0][k] + C2[1][k] * C3[1][k] + C2[2][k] * C3[2][k]) - R2[k] * R3[k]);
+
+					JF_2[k] = V3[0][k] * V3[0][k] + V3[1][k] * V3[1][k] + V3[2][k] * V3[2][k];
+					JF_1[k] = 2.0 * (V3[0][k] * C3[0][k] + V3[1][k] * C3[1][k] + V3[2][k] * C3[2][k]);
+					JF_0[k] = C3[0][k] * C3[0][k] + C3[1][k] * C3[1][k] + C3[2][k] * C3[2][k] - R3[k] * R3[k] - CDMM_NORROW;
+				}
+
+				for (int k = 0; k < num; k++)
+				{
+					JA_2[k] = Check_QEAL_ZERO(JA_2[k]); JA_1[k] = Check_QEAL_ZERO(JA_1[k]); JA_0[k] = Check_QEAL_ZERO(JA_0[k]);
+					JB_2[k] = Check_QEAL_ZERO(JB_2[k]); JB_1[k] = Check_QEAL_ZERO(JB_1[k]); JB_0[k] = Check_QEAL_ZERO(JB_0[k]);
+					JC_2[k] = Check_QEAL_ZERO(JC_2[k]); JC_1[k] = Check_QEAL_ZERO(JC_1[k]); JC_0[k] = Check_QEAL_ZERO(JC_0[k]);
+					JD_2[k] = Check_QEAL_ZERO(JD_2[k]); JD_1[k] = Check_QEAL_ZERO(JD_1[k]); JD_0[k] = Check_QEAL_ZERO(JD_0[k]);
+					JE_2[k] = Check_QEAL_ZERO(JE_2[k]); JE_1[k] = Check_QEAL_ZERO(JE_1[k]); JE_0[k] = Check_QEAL_ZERO(JE_0[k]);
+					JF_2[k] = Check_QEAL_ZERO(JF_2[k]); JF_1[k] = Check_QEAL_ZERO(JF_1[k]); JF_0[k] = Check_QEAL_ZERO(JF_0[k]);
+
+					// the case analysis of MPsCCD / CDMM::ccd, every case keeps the smallest ftc found so far
+					qeal ftc = localToi;
+					qeal ft = 1.0;
+					if (CDMM::checkEndpointAlphaBetaCCD(JA_2[k], JA_1[k], JA_0[k], JB_2[k], JB_1[k], JB_0[k], JC_2[k], JC_1[k], JC_0[k], JD_2[k], JD_1[k], JD_0[k], JE_2[k], JE_1[k], JE_0[k], JF_2[k], JF_1[k], JF_0[k], ft, ss[k]) && ft < ftc)
+						ftc = ft;
+
+					ft = 1.0;
+					if (CDMM::checkAlphaIsZeroCCD(JA_2[k], JA_1[k], JA_0[k], JB_2[k], JB_1[k], JB_0[k], JC_2[k], JC_1[k], JC_0[k], JD_2[k], JD_1[k], JD_0[k], JE_2[k], JE_1[k], JE_0[k], JF_2[k], JF_1[k], JF_0[k], ft) && ft < ftc)
+						ftc = ft;
+
+					ft = 1.0;
+					if (CDMM::checkBetaIsZeroCCD(JA_2[k], JA_1[k], JA_0[k], JB_2[k], JB_1[k], JB_0[k], JC_2[k], JC_1[k], JC_0[k], JD_2[k], JD_1[k], JD_0[k], JE_2[k], JE_1[k], JE_0[k], JF_2[k], JF_1[k], JF_0[k], ft) && ft < ftc)
+						ftc = ft;
+
+					if (ss[k])
+					{
+						ft = 1.0;
+						if (CDMM::checkAlphaPlusBetaIsOneCCD(JA_2[k], JA_1[k], JA_0[k], JB_2[k], JB_1[k], JB_0[k], JC_2[k], JC_1[k], JC_0[k], JD_2[k], JD_1[k], JD_0[k], JE_2[k], JE_1[k], JE_0[k], JF_2[k], JF_1[k], JF_0[k], ft) && ft < ftc)
+							ftc = ft;
+					}
+					else
+					{
+						ft = 1.0;
+						if (CDMM::checkAlphaIsOneCCD(JA_2[k], JA_1[k], JA_0[k], JB_2[k], JB_1[k], JB_0[k], JC_2[k], JC_1[k], JC_0[k], JD_2[k], JD_1[k], JD_0[k], JE_2[k], JE_1[k], JE_0[k], JF_2[k], JF_1[k], JF_0[k], ft) && ft < ftc)
+							ftc = ft;
+
+						ft = 1.0;
+						if (CDMM::checkBetaIsOneCCD(JA_2[k], JA_1[k], JA_0[k], JB_2[k], JB_1[k], JB_0[k], JC_2[k], JC_1[k], JC_0[k], JD_2[k], JD_1[k], JD_0[k], JE_2[k], JE_1[k], JE_0[k], JF_2[k], JF_1[k], JF_0[k], ft) && ft < ftc)
+							ftc = ft;
+					}
+
+					ft = 1.0;
+					if (CDMM::checkAlphaBetaCCD(JA_2[k], JA_1[k], JA_0[k], JB_2[k], JB_1[k], JB_0[k], JC_2[k], JC_1[k], JC_0[k], JD_2[k], JD_1[k], JD_0[k], JE_2[k], JE_1[k], JE_0[k], JF_2[k], JF_1[k], JF_0[k], ft, ss[k]) && ft < ftc)
+						ftc = ft;
+
+					localToi = ftc;
+					if (localToi <= lowerBound)
+						break;
+				}
+
+				if (localToi <= lowerBound)
+				{
+					reachLowerBound = 1;
+#pragma omp flush
+				}
+			}
+#pragma omp critical
+			{
+				if (localToi < toi)
+					toi = localToi;
+			}
+		}
+		return toi;
+	}
+
+	qeal MPsACCDHost
+	(
+		int hostCollisionEventNum,
+		qeal* medialPointPosition,
+		qeal* medialPointRadius,
+		qeal* staticMedialPointPosition,
+		qeal* staticMedialPointRadius,
+		qeal* medialPointMovingDir,
+		int* hostCollisionEventList,
+		qeal gap,
+		int maxIterations
+	)
+	{
+		qeal toi = 1.0;
+#pragma omp parallel
+		{
+			qeal localToi = 1.0;
+#pragma omp for schedule(dynamic, MPS_CCD_HOST_BATCH)
+			for (int k = 0; k < hostCollisionEventNum; k++)
+			{
+				qeal C1[3], C2[3], C3[3], V1[3], V2[3], V3[3];
+				qeal R1, R2, R3;
+				bool ss = gatherMPsCCDEvent(hostCollisionEventList + 5 * k, medialPointPosition, medialPointRadius, staticMedialPointPosition, staticMedialPointRadius, medialPointMovingDir, C1, V1, C2, V2, C3, V3, R1, R2, R3);
+				qeal ft = additiveCCD(C1, V1, C2, V2, C3, V3, R1, R2, R3, ss, gap, maxIterations);
+				if (ft < localToi)
+					localToi = ft;
+			}
+#pragma omp critical
+			{
+				if (localToi < toi)
+					toi = localToi;
+			}
+		}
+		return toi;
+	}
+
+	qeal additiveCCD
+	(
+		qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3,
+		qeal R1, qeal R2, qeal R3, bool ss,
+		qeal gap,
+		int maxIterations
+	)
+	{
+		qeal d0 = additiveCCDDistanceBound(C1, V1, C2, V2, C3, V3, R1, R2, R3, ss, 0.0);
+		if (d0 <= 0.0)
+			return 0.0;
+
+		// the distance changes no faster than |alpha * V1 + beta * V2 + V3|, which is largest at a corner
+		qeal cornerAlpha[4] = { 0.0, 1.0, 0.0, 1.0 };
+		qeal cornerBeta[4] = { 0.0, 0.0, 1.0, 1.0 };
+		int cornerNum = ss ? 3 : 4;
+		qeal l = 0.0;
+		for (int j = 0; j < cornerNum; j++)
+		{
+			qeal v[3];
+			for (int i = 0; i < 3; i++)
+				v[i] = cornerAlpha[j] * V1[i] + cornerBeta[j] * V2[i] + V3[i];
+			qeal len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			if (len > l)
+				l = len;
+		}
+		if (IS_QEAL_ZERO(l))
+			return 1.0;
+
+		// each step is safe since it cannot close more than (1 - gap) of the current distance
+		qeal t = 0.0;
+		qeal d = d0;
+		for (int it = 0; it < maxIterations; it++)
+		{
+			qeal dt = (1.0 - gap) * d / l;
+			if (t + dt >= 1.0)
+				return 1.0;
+			t += dt;
+			d = additiveCCDDistanceBound(C1, V1, C2, V2, C3, V3, R1, R2, R3, ss, t);
+			if (d <= gap * d0)
+				break;
+		}
+		return t;
+	}
+
+	qeal additiveCCDDistanceBound(qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3, qeal R1, qeal R2, qeal R3, bool ss, qeal t)
+	{
+		Vector3 c1, c2, c3;
+		for (int i = 0; i < 3; i++)
+		{
+			c1.data()[i] = C1[i] + t * V1[i];
+			c2.data()[i] = C2[i] + t * V2[i];
+			c3.data()[i] = C3[i] + t * V3[i];
+		}
+
+		qeal dist, alpha, beta;
+		CDMM::computeCollisionDistance(c1, c2, c3, R1, R2, R3, ss, dist, alpha, beta);
+		if (dist <= 0.0)
+			return dist;
+
+		// |c| - r = (|c|^2 - r^2) / (|c| + r), and both |c| and r are largest at a corner of the primitive pair
+		qeal cornerAlpha[4] = { 0.0, 1.0, 0.0, 1.0 };
+		qeal cornerBeta[4] = { 0.0, 0.0, 1.0, 1.0 };
+		int cornerNum = ss ? 3 : 4;
+		qeal maxC = 0.0, maxR = 0.0;
+		for (int j = 0; j < cornerNum; j++)
+		{
+			Vector3 c = cornerAlpha[j] * c1 + cornerBeta[j] * c2 + c3;
+			qeal len = c.norm();
+			qeal r = cornerAlpha[j] * R1 + cornerBeta[j] * R2 + R3;
+			if (len > maxC)
+				maxC = len;
+			if (r > maxR)
+				maxR = r;
+		}
+		return dist / (maxC + maxR);
+	}
+
+	bool isMPsCCDEventSeparated(qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3, qeal R1, qeal R2, qeal R3, bool ss, qeal norrow)
+	{
+		Vector3 c1(C1[0], C1[1], C1[2]), c2(C2[0], C2[1], C2[2]), c3(C3[0], C3[1], C3[2]);
+		qeal dist, alpha, beta;
+		CDMM::computeCollisionDistance(c1, c2, c3, R1, R2, R3, ss, dist, alpha, beta);
+		if (dist <= 0.0)
+			return false;
+
+		// |c| and r are largest at a corner, so are the relative displacements alpha * V1 + beta * V2 + V3
+		qeal cornerAlpha[4] = { 0.0, 1.0, 0.0, 1.0 };
+		qeal cornerBeta[4] = { 0.0, 0.0, 1.0, 1.0 };
+		int cornerNum = ss ? 3 : 4;
+		qeal maxC = 0.0, maxR = 0.0, maxV = 0.0;
+		for (int j = 0; j < cornerNum; j++)
+		{
+			qeal c[3], v[3];
+			for (int i = 0; i < 3; i++)
+			{
+				c[i] = cornerAlpha[j] * C1[i] + cornerBeta[j] * C2[i] + C3[i];
+				v[i] = cornerAlpha[j] * V1[i] + cornerBeta[j] * V2[i] + V3[i];
+			}
+			qeal lc = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+			qeal lv = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			qeal r = cornerAlpha[j] * R1 + cornerBeta[j] * R2 + R3;
+			if (lc > maxC) maxC = lc;
+			if (lv > maxV) maxV = lv;
+			if (r > maxR) maxR = r;
+		}
+		// |c| - r >= (|c|^2 - r^2) / (max |c| + max r), and |c|^2 - r^2 >= (|c| - r)^2
+		return dist / (maxC + maxR) - maxV > sqrt(norrow);
+	}
+
+	bool gatherMPsCCDEvent
+	(
+		int* event,
+		qeal* medialPointPosition,
+		qeal* medialPointRadius,
+		qeal* staticMedialPointPosition,
+		qeal* staticMedialPointRadius,
+		qeal* medialPointMovingDir,
+		qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3,
+		qeal& R1, qeal& R2, qeal& R3
+	)
+	{
+		int flag = event[0];
+		int* mid = event + 1;
+		bool ss = false;
+		if (flag == COLLISION_CC) // cc obj vs obj
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				C1[i] = medialPointPosition[3 * mid[0] + i] - medialPointPosition[3 * mid[1] + i];
+				C2[i] = medialPointPosition[3 * mid[3] + i] - medialPointPosition[3 * mid[2] + i];
+				C3[i] = medialPointPosition[3 * mid[1] + i] - medialPointPosition[3 * mid[3] + i];
+
+				V1[i] = medialPointMovingDir[3 * mid[0] + i] - medialPointMovingDir[3 * mid[1] + i];
+				V2[i] = medialPointMovingDir[3 * mid[3] + i] - medialPointMovingDir[3 * mid[2] + i];
+				V3[i] = medialPointMovingDir[3 * mid[1] + i] - medialPointMovingDir[3 * mid[3] + i];
+			}
+			R1 = medialPointRadius[mid[0]] - medialPointRadius[mid[1]];
+			R2 = medialPointRadius[mid[2]] - medialPointRadius[mid[3]];
+			R3 = medialPointRadius[mid[1]] + medialPointRadius[mid[3]];
+		}
+		else if (flag == COLLISION_SS) // ss obj vs obj
+		{
+			ss = true;
+			for (int i = 0; i < 3; i++)
+			{
+				C1[i] = medialPointPosition[3 * mid[0] + i] - medialPointPosition[3 * mid[2] + i];
+				C2[i] = medialPointPosition[3 * mid[1] + i] - medialPointPosition[3 * mid[2] + i];
+				C3[i] = medialPointPosition[3 * mid[2] + i] - medialPointPosition[3 * mid[3] + i];
+
+				V1[i] = medialPointMovingDir[3 * mid[0] + i] - medialPointMovingDir[3 * mid[2] + i];
+				V2[i] = medialPointMovingDir[3 * mid[1] + i] - medialPointMovingDir[3 * mid[2] + i];
+				V3[i] = medialPointMovingDir[3 * mid[2] + i] - medialPointMovingDir[3 * mid[3] + i];
+			}
+			R1 = medialPointRadius[mid[0]] - medialPointRadius[mid[2]];
+			R2 = medialPointRadius[mid[1]] - medialPointRadius[mid[2]];
+			R3 = medialPointRadius[mid[2]] + medialPointRadius[mid[3]];
+		}
+		else if (flag == COLLISION_DEFORMABLE_WITH_STATIC_CC) // cc obj vs static obj
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				C1[i] = medialPointPosition[3 * mid[0] + i] - medialPointPosition[3 * mid[1] + i];
+				C2[i] = staticMedialPointPosition[3 * mid[3] + i] - staticMedialPointPosition[3 * mid[2] + i];
+				C3[i] = medialPointPosition[3 * mid[1] + i] - staticMedialPointPosition[3 * mid[3] + i];
+
+				V1[i] = medialPointMovingDir[3 * mid[0] + i] - medialPointMovingDir[3 * mid[1] + i];
+				V2[i] = 0.0;
+				V3[i] = medialPointMovingDir[3 * mid[1] + i];
+			}
+			R1 = medialPointRadius[mid[0]] - medialPointRadius[mid[1]];
+			R2 = staticMedialPointRadius[mid[2]] - staticMedialPointRadius[mid[3]];
+			R3 = medialPointRadius[mid[1]] + staticMedialPointRadius[mid[3]];
+		}
+		else if (flag == COLLISION_DEFORMABLE_WITH_STATIC_SS) // ss obj vs static obj
+		{
+			ss = true;
+			for (int i = 0; i < 3; i++)
+			{
+				C1[i] = medialPointPosition[3 * mid[0] + i] - medialPointPosition[3 * mid[2] + i];
+				C2[i] = medialPointPosition[3 * mid[1] + i] - medialPointPosition[3 * mid[2] + i];
+				C3[i] = medialPointPosition[3 * mid[2] + i] - staticMedialPointPosition[3 * mid[3] + i];
+
+				V1[i] = medialPointMovingDir[3 * mid[0] + i] - medialPointMovingDir[3 * mid[2] + i];
+				V2[i] = medialPointMovingDir[3 * mid[1] + i] - medialPointMovingDir[3 * mid[2] + i];
+				V3[i] = medialPointMovingDir[3 * mid[2] + i];
+			}
+			R1 = medialPointRadius[mid[0]] - medialPointRadius[mid[2]];
+			R2 = medialPointRadius[mid[1]] - medialPointRadius[mid[2]];
+			R3 = medialPointRadius[mid[2]] + staticMedialPointRadius[mid[3]];
+		}
+		else if (flag == COLLISION_STATIC_WITH_DEFORMABLE_CC) // cc static obj vs obj
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				C1[i] = staticMedialPointPosition[3 * mid[0] + i] - staticMedialPointPosition[3 * mid[1] + i];
+				C2[i] = medialPointPosition[3 * mid[3] + i] - medialPointPosition[3 * mid[2] + i];
+				C3[i] = staticMedialPointPosition[3 * mid[1] + i] - medialPointPosition[3 * mid[3] + i];
+
+				V1[i] = 0.0;
+				V2[i] = medialPointMovingDir[3 * mid[3] + i] - medialPointMovingDir[3 * mid[2] + i];
+				V3[i] = -medialPointMovingDir[3 * mid[3] + i];
+			}
+			R1 = staticMedialPointRadius[mid[0]] - staticMedialPointRadius[mid[1]];
+			R2 = medialPointRadius[mid[2]] - medialPointRadius[mid[3]];
+			R3 = staticMedialPointRadius[mid[1]] + medialPointRadius[mid[3]];
+		}
+		else if (flag == COLLISION_STATIC_WITH_DEFORMABLE_SS) // ss static obj vs obj
+		{
+			ss = true;
+			for (int i = 0; i < 3; i++)
+			{
+				C1[i] = staticMedialPointPosition[3 * mid[0] + i] - staticMedialPointPosition[3 * mid[2] + i];
+				C2[i] = staticMedialPointPosition[3 * mid[1] + i] - staticMedialPointPosition[3 * mid[2] + i];
+				C3[i] = staticMedialPointPosition[3 * mid[2] + i] - medialPointPosition[3 * mid[3] + i];
+
+				V1[i] = 0.0;
+				V2[i] = 0.0;
+				V3[i] = -medialPointMovingDir[3 * mid[3] + i];
+			}
+			R1 = staticMedialPointRadius[mid[0]] - staticMedialPointRadius[mid[2]];
+			R2 = staticMedialPointRadius[mid[1]] - staticMedialPointRadius[mid[2]];
+			R3 = staticMedialPointRadius[mid[2]] + medialPointRadius[mid[3]];
+		}
+		return ss;
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef Medial_Primitives_CCD_HOST_H
+#define Medial_Primitives_CCD_HOST_H
+#include "MPsCCDEvent.h"
+#include "Simulator\CollisionDetection\CollisionDetectionMedialMesh11.h"
+
+namespace MIPC
+{
+#define MPS_CCD_HOST_BATCH 128
+#define MPS_ACCD_MAX_ITERATIONS 64
+
+	// cpu counterpart of MPsCCD + cublasIdamin, returns the min ftc over all events;
+	// the events are gathered in batches of MPS_CCD_HOST_BATCH so the coefficients are computed over contiguous arrays, events that
+	// pass isMPsCCDEventSeparated are left out of the batch,
+	// and the remaining batches are skipped once the min reaches lowerBound (any toi below lowerBound is returned then, not the smallest)
+	qeal MPsCCDHost
+	(
+		int hostCollisionEventNum,
+		qeal* medialPointPosition,
+		qeal* medialPointRadius,
+		qeal* staticMedialPointPosition,
+		qeal* staticMedialPointRadius,
+		qeal* medialPointMovingDir,
+		int* hostCollisionEventList,
+		qeal lowerBound = 0.0
+	);
+
+	// conservative advancement instead of the sextic roots: every event steps forward by its distance lower bound over the bound of
+	// its relative speed until the distance falls below gap * (distance at t = 0), so the returned toi always keeps the primitives apart
+	qeal MPsACCDHost
+	(
+		int hostCollisionEventNum,
+		qeal* medialPointPosition,
+		qeal* medialPointRadius,
+		qeal* staticMedialPointPosition,
+		qeal* staticMedialPointRadius,
+		qeal* medialPointMovingDir,
+		int* hostCollisionEventList,
+		qeal gap = 0.1,
+		int maxIterations = MPS_ACCD_MAX_ITERATIONS
+	);
+
+	// toi of one event by additive ccd, 0 if the primitives already touch
+	qeal additiveCCD
+	(
+		qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3,
+		qeal R1, qeal R2, qeal R3, bool ss,
+		qeal gap = 0.1,
+		int maxIterations = MPS_ACCD_MAX_ITERATIONS
+	);
+
+	// lower bound of the distance between the primitives moved by t along V
+	qeal additiveCCDDistanceBound(qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3, qeal R1, qeal R2, qeal R3, bool ss, qeal t);
+
+	// cpu counterpart of the linear bound prefilter of MPsCCD: true if the event cannot reach norrow within the step
+	bool isMPsCCDEventSeparated(qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3, qeal R1, qeal R2, qeal R3, bool ss, qeal norrow = CDMM_NORROW);
+
+	// C1, V1, C2, V2, C3, V3, R1, R2, R3 of one event, as set up by the MPsCCD kernel
+	bool gatherMPsCCDEvent
+	(
+		int* event,
+		qeal* medialPointPosition,
+		qeal* medialPointRadius,
+		qeal* staticMedialPointPosition,
+		qeal* staticMedialPointRadius,
+		qeal* medialPointMovingDir,
+		qeal* C1, qeal* V1, qeal* C2, qeal* V2, qeal* C3, qeal* V3,
+		qeal& R1, qeal& R2, qeal& R3
+	);
+}
+
+#endif
@@ -80,447 +80,197 @@ namespace MIPC
 		}
 	}
 
-	void MipcConstraint::fillOverallGradient(qeal S, VectorX& dbdx, VectorX& gradient)
+	qeal MipcConstraint::getMotionBudget()
 	{
-		for (int i = 0; i < 4; i++)
+		if (distance <= dHat2)
+			return 0.0;
+		// moving the centers by e changes |c|^2 - r^2 by at least -2 * |e| * |c|, and |c| peaks at a corner pair
+		int leftNum = collisionType == CC ? 2 : 3;
+		qeal maxDist2 = 0.0;
+		for (int i = 0; i < leftNum; i++)
 		{
-			FrameType frameType = spheres[i]->center->getFrameType();
-			if (frameType == FrameType::STATIC)
-				continue;
-			int frameId = spheres[i]->center->getFrameId();
-			int offset = spheres[i]->center->getOffset();
+			qeal* pi = spheres[i]->center->getP();
+			for (int j = leftNum; j < 4; j++)
+			{
+				qeal* pj = spheres[j]->center->getP();
+				qeal dx = pi[0] - pj[0];
+				qeal dy = pi[1] - pj[1];
+				qeal dz = pi[2] - pj[2];
+				qeal dist2 = dx * dx + dy * dy + dz * dz;
+				if (dist2 > maxDist2)
+					maxDist2 = dist2;
+			}
+		}
+		if (maxDist2 < MIN_VALUE)
+			return 0.0;
+		return (distance - dHat2) / (2.0 * std::sqrt(maxDist2));
+	}
 
-			if (frameType == FrameType::LINEAR)
+	qeal MipcConstraint::updateDistance()
+	{
+		if (motionFilter && hasMotionMark)
+		{
+			int leftNum = collisionType == CC ? 2 : 3;
+			qeal leftMotion = 0.0, rightMotion = 0.0;
+			for (int i = 0; i < 4; i++)
 			{
-				qeal p[3];
-				spheres[i]->center->getOriginalP(p);
-				gradient[offset] += p[0] * S * dbdx.data()[3 * i];
-				gradient[offset + 1] += p[0] * S * dbdx.data()[3 * i + 1];
-				gradient[offset + 2] += p[0] * S * dbdx.data()[3 * i + 2];
-
-				gradient[offset + 3] += p[1] * S * dbdx.data()[3 * i];
-				gradient[offset + 4] += p[1] * S * dbdx.data()[3 * i + 1];
-				gradient[offset + 5] += p[1] * S * dbdx.data()[3 * i + 2];
-
-				gradient[offset + 6] += p[2] * S * dbdx.data()[3 * i];
-				gradient[offset + 7] += p[2] * S * dbdx.data()[3 * i + 1];
-				gradient[offset + 8] += p[2] * S * dbdx.data()[3 * i + 2];
-
-				gradient[offset + 9] += S * dbdx.data()[3 * i];
-				gradient[offset + 10] += S * dbdx.data()[3 * i + 1];
-				gradient[offset + 11] += S * dbdx.data()[3 * i + 2];
+				qeal motion = spheres[i]->center->getMotion() - motionMark[i];
+				if (i < leftNum)
+					leftMotion = std::max(leftMotion, motion);
+				else rightMotion = std::max(rightMotion, motion);
 			}
+			// still out of dHat, the stale distance only has to report inactive
+			if (leftMotion + rightMotion < motionBudget)
+				return distance;
+		}
+
+		computeDistance();
+		if (motionFilter)
+		{
+			for (int i = 0; i < 4; i++)
+				motionMark[i] = spheres[i]->center->getMotion();
+			motionBudget = getMotionBudget();
+			hasMotionMark = true;
 		}
+		return distance;
+	}
+
+	void MipcConstraint::computeLocalGradientAndHessian(qeal kappa)
+	{
+		if (!hasReducedJacobian)
+			computeReducedJacobian();
+		VectorX grad(12);
+		MatrixX hess(12, 12);
+		getLocalGradientAndHessian(kappa, grad, hess);
+		localGradient = reducedJacobian.transpose() * grad;
+		localHessian = reducedJacobian.transpose() * hess * reducedJacobian;
+	}
+
+	void MipcConstraint::computeLocalFrictionGradientAndHessian(qeal kappa)
+	{
+		if (!hasReducedJacobian)
+			computeReducedJacobian();
+		VectorX grad(12);
+		MatrixX hess(12, 12);
+		getLocalFrictionGradientAndHessian(kappa, grad, hess);
+		localFrictionGradient = reducedJacobian.transpose() * grad;
+		localFrictionHessian = reducedJacobian.transpose() * hess * reducedJacobian;
+	}
+
+	void MipcConstraint::fillLocalGradientAndHessian(VectorX& gradient, MatrixX& hessian)
+	{
+		fillReducedGradient(localGradient, gradient);
+		fillReducedHessian(localHessian, hessian);
 	}
 
-	void MipcConstraint::fillOverallHessian(qeal S, MatrixX& dbdx2, MatrixX& hessian)
+	void MipcConstraint::fillLocalFrictionGradientAndHessian(VectorX& gradient, MatrixX& hessian)
 	{
-		int size = hessian.rows();
-		for (int c = 0; c < 4; c++)
+		fillReducedGradient(localFrictionGradient, gradient);
+		fillReducedHessian(localFrictionHessian, hessian);
+	}
+
+	void MipcConstraint::fillLocalGradientAndHessian(VectorX& gradient, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal)
+	{
+		fillReducedGradient(localGradient, gradient);
+		fillReducedHessian(localHessian, csrRowPtr, csrVal);
+	}
+
+	void MipcConstraint::fillLocalFrictionGradientAndHessian(VectorX& gradient, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal)
+	{
+		fillReducedGradient(localFrictionGradient, gradient);
+		fillReducedHessian(localFrictionHessian, csrRowPtr, csrVal);
+	}
+
+	void MipcConstraint::getGradientAndHessian(qeal kappa, VectorX& gradient, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal)
+	{
+		computeLocalGradientAndHessian(kappa);
+		fillLocalGradientAndHessian(gradient, csrRowPtr, csrVal);
+	}
+
+	void MipcConstraint::getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal)
+	{
+		computeLocalFrictionGradientAndHessian(kappa);
+		fillLocalFrictionGradientAndHessian(gradient, csrRowPtr, csrVal);
+	}
+
+	void MipcConstraint::computeReducedFrameBlocks()
+	{
+		reducedFrameId.clear();
+		reducedFrameOffset.clear();
+		reducedFrameLocalOffset.clear();
+		reducedFrameDim.clear();
+
+		int localDim = 0;
+		for (int i = 0; i < 4; i++)
 		{
-			FrameType c_frameType = spheres[c]->center->getFrameType();
-			if (c_frameType == FrameType::STATIC)
+			reducedSphereBlock[i] = -1;
+			MedialSphereFrame* frame = spheres[i]->center;
+			if (frame->getFrameType() == FrameType::STATIC)
 				continue;
-			int c_frameId = spheres[c]->center->getFrameId();
-			int c_offset = spheres[c]->center->getOffset();
-
-			qeal c_p[3];
-			spheres[c]->center->getOriginalP(c_p);
-			for (int a = 0; a < 4; a++)
+			int b = 0;
+			for (; b < reducedFrameOffset.size(); b++)
+				if (reducedFrameOffset[b] == frame->getOffset())
+					break;
+			if (b == reducedFrameOffset.size())
 			{
-				FrameType a_frameType = spheres[a]->center->getFrameType();
-				if (a_frameType == FrameType::STATIC)
-					continue;
-				int a_frameId = spheres[a]->center->getFrameId();
-				int a_offset = spheres[a]->center->getOffset();
-				qeal a_p[3];
-				spheres[a]->center->getOriginalP(a_p);
-
-				qeal x0 = dbdx2.data()[12 * 3 * a + 3 * c + 0];
-				qeal x1 = dbdx2.data()[12 * 3 * a + 3 * c + 1];
-				qeal x2 = dbdx2.data()[12 * 3 * a + 3 * c + 2];
-
-				qeal x3 = dbdx2.data()[12 * (3 * a + 1) + 3 * c + 0];
-				qeal x4 = dbdx2.data()[12 * (3 * a + 1) + 3 * c + 1];
-				qeal x5 = dbdx2.data()[12 * (3 * a + 1) + 3 * c + 2];
-
-				qeal x6 = dbdx2.data()[12 * (3 * a + 2) + 3 * c + 0];
-				qeal x7 = dbdx2.data()[12 * (3 * a + 2) + 3 * c + 1];
-				qeal x8 = dbdx2.data()[12 * (3 * a + 2) + 3 * c + 2];
-
-				// hard code
-				if (c_frameType == FrameType::LINEAR)
-				{
-					if (a_frameType == FrameType::LINEAR)
-					{
-						// 24 x 24
-						hessian.data()[(a_offset + 0) * size + c_offset + 0] += c_p[0] * x0 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 1] += c_p[0] * x1 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 2] += c_p[0] * x2 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 3] += c_p[1] * x0 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 4] += c_p[1] * x1 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 5] += c_p[1] * x2 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 6] += c_p[2] * x0 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 7] += c_p[2] * x1 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 8] += c_p[2] * x2 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 9] += 1.0 * x0 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 10] += 1.0 * x1 * a_p[0];
-						hessian.data()[(a_offset + 0) * size + c_offset + 11] += 1.0 * x2 * a_p[0];
-
-						hessian.data()[(a_offset + 1) * size + c_offset + 0] += c_p[0] * x3 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 1] += c_p[0] * x4 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 2] += c_p[0] * x5 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 3] += c_p[1] * x3 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 4] += c_p[1] * x4 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 5] += c_p[1] * x5 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 6] += c_p[2] * x3 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 7] += c_p[2] * x4 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 8] += c_p[2] * x5 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 9] += 1.0 * x3 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 10] += 1.0 * x4 * a_p[0];
-						hessian.data()[(a_offset + 1) * size + c_offset + 11] += 1.0 * x5 * a_p[0];
-
-						hessian.data()[(a_offset + 2) * size + c_offset + 0] += c_p[0] * x6 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 1] += c_p[0] * x7 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 2] += c_p[0] * x8 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 3] += c_p[1] * x6 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 4] += c_p[1] * x7 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 5] += c_p[1] * x8 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 6] += c_p[2] * x6 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 7] += c_p[2] * x7 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 8] += c_p[2] * x8 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 9] += 1.0 * x6 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 10] += 1.0 * x7 * a_p[0];
-						hessian.data()[(a_offset + 2) * size + c_offset + 11] += 1.0 * x8 * a_p[0];
-
-						//
-						hessian.data()[(a_offset + 3) * size + c_offset + 0] += c_p[0] * x0 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 1] += c_p[0] * x1 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 2] += c_p[0] * x2 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 3] += c_p[1] * x0 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 4] += c_p[1] * x1 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 5] += c_p[1] * x2 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 6] += c_p[2] * x0 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 7] += c_p[2] * x1 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 8] += c_p[2] * x2 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 9] += 1.0 * x0 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 10] += 1.0 * x1 * a_p[1];
-						hessian.data()[(a_offset + 3) * size + c_offset + 11] += 1.0 * x2 * a_p[1];
-
-						hessian.data()[(a_offset + 4) * size + c_offset + 0] += c_p[0] * x3 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 1] += c_p[0] * x4 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 2] += c_p[0] * x5 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 3] += c_p[1] * x3 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 4] += c_p[1] * x4 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 5] += c_p[1] * x5 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 6] += c_p[2] * x3 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 7] += c_p[2] * x4 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 8] += c_p[2] * x5 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 9] += 1.0 * x3 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 10] += 1.0 * x4 * a_p[1];
-						hessian.data()[(a_offset + 4) * size + c_offset + 11] += 1.0 * x5 * a_p[1];
-
-						hessian.data()[(a_offset + 5) * size + c_offset + 0] += c_p[0] * x6 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 1] += c_p[0] * x7 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 2] += c_p[0] * x8 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 3] += c_p[1] * x6 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 4] += c_p[1] * x7 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 5] += c_p[1] * x8 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 6] += c_p[2] * x6 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 7] += c_p[2] * x7 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 8] += c_p[2] * x8 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 9] += 1.0 * x6 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 10] += 1.0 * x7 * a_p[1];
-						hessian.data()[(a_offset + 5) * size + c_offset + 11] += 1.0 * x8 * a_p[1];
-
-						//
-						hessian.data()[(a_offset + 6) * size + c_offset + 0] += c_p[0] * x0 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 1] += c_p[0] * x1 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 2] += c_p[0] * x2 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 3] += c_p[1] * x0 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 4] += c_p[1] * x1 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 5] += c_p[1] * x2 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 6] += c_p[2] * x0 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 7] += c_p[2] * x1 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 8] += c_p[2] * x2 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 9] += 1.0 * x0 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 10] += 1.0 * x1 * a_p[2];
-						hessian.data()[(a_offset + 6) * size + c_offset + 11] += 1.0 * x2 * a_p[2];
-
-						hessian.data()[(a_offset + 7) * size + c_offset + 0] += c_p[0] * x3 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 1] += c_p[0] * x4 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 2] += c_p[0] * x5 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 3] += c_p[1] * x3 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 4] += c_p[1] * x4 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 5] += c_p[1] * x5 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 6] += c_p[2] * x3 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 7] += c_p[2] * x4 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 8] += c_p[2] * x5 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 9] += 1.0 * x3 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 10] += 1.0 * x4 * a_p[2];
-						hessian.data()[(a_offset + 7) * size + c_offset + 11] += 1.0 * x5 * a_p[2];
-
-						hessian.data()[(a_offset + 8) * size + c_offset + 0] += c_p[0] * x6 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 1] += c_p[0] * x7 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 2] += c_p[0] * x8 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 3] += c_p[1] * x6 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 4] += c_p[1] * x7 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 5] += c_p[1] * x8 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 6] += c_p[2] * x6 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 7] += c_p[2] * x7 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 8] += c_p[2] * x8 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 9] += 1.0 * x6 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 10] += 1.0 * x7 * a_p[2];
-						hessian.data()[(a_offset + 8) * size + c_offset + 11] += 1.0 * x8 * a_p[2];
-						//
-						hessian.data()[(a_offset + 9) * size + c_offset + 0] += c_p[0] * x0 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 1] += c_p[0] * x1 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 2] += c_p[0] * x2 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 3] += c_p[1] * x0 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 4] += c_p[1] * x1 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 5] += c_p[1] * x2 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 6] += c_p[2] * x0 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 7] += c_p[2] * x1 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 8] += c_p[2] * x2 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 9] += 1.0 * x0 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 10] += 1.0 * x1 * 1.0;
-						hessian.data()[(a_offset + 9) * size + c_offset + 11] += 1.0 * x2 * 1.0;
-
-						hessian.data()[(a_offset + 10) * size + c_offset + 0] += c_p[0] * x3 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 1] += c_p[0] * x4 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 2] += c_p[0] * x5 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 3] += c_p[1] * x3 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 4] += c_p[1] * x4 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 5] += c_p[1] * x5 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 6] += c_p[2] * x3 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 7] += c_p[2] * x4 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 8] += c_p[2] * x5 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 9] += 1.0 * x3 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 10] += 1.0 * x4 * 1.0;
-						hessian.data()[(a_offset + 10) * size + c_offset + 11] += 1.0 * x5 * 1.0;
-
-						hessian.data()[(a_offset + 11) * size + c_offset + 0] += c_p[0] * x6 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 1] += c_p[0] * x7 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 2] += c_p[0] * x8 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 3] += c_p[1] * x6 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 4] += c_p[1] * x7 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 5] += c_p[1] * x8 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 6] += c_p[2] * x6 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 7] += c_p[2] * x7 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 8] += c_p[2] * x8 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 9] += 1.0 * x6 * 1.0;
-						hessian.data()[(a_offset + 11) * size + (c_offset)+10] += 1.0 * x7 * 1.0;
-						hessian.data()[(a_offset + 11) * size + c_offset + 11] += 1.0 * x8 * 1.0;
-					}
-				}
+				reducedFrameId.push_back(frame->getFrameId());
+				reducedFrameOffset.push_back(frame->getOffset());
+				reducedFrameLocalOffset.push_back(localDim);
+				reducedFrameDim.push_back(frame->getDim());
+				localDim += frame->getDim();
 			}
+			reducedSphereBlock[i] = b;
 		}
 	}
 
-	void MipcConstraint::fillOverallHessian(qeal S, MatrixX & dbdx2, std::vector<TripletX>& triplet)
+	void MipcConstraint::computeReducedJacobian()
 	{
-		for (int c = 0; c < 4; c++)
+		if (reducedFrameOffset.size() == 0)
+			computeReducedFrameBlocks();
+		int localDim = 0;
+		for (int b = 0; b < reducedFrameDim.size(); b++)
+			localDim += reducedFrameDim[b];
+
+		reducedJacobian.resize(12, localDim);
+		reducedJacobian.setZero();
+		for (int i = 0; i < 4; i++)
 		{
-			FrameType c_frameType = spheres[c]->center->getFrameType();
-			if (c_frameType == FrameType::STATIC)
+			int b = reducedSphereBlock[i];
+			if (b < 0)
 				continue;
-			int c_frameId = spheres[c]->center->getFrameId();
-			int c_offset = spheres[c]->center->getOffset();
+			reducedJacobian.block(3 * i, reducedFrameLocalOffset[b], 3, reducedFrameDim[b]) += spheres[i]->center->getUMatrix();
+		}
+		hasReducedJacobian = true;
+	}
+
+	void MipcConstraint::fillReducedGradient(VectorX& reducedGrad, VectorX& gradient)
+	{
+		for (int b = 0; b < reducedFrameOffset.size(); b++)
+			gradient.segment(reducedFrameOffset[b], reducedFrameDim[b]) += reducedGrad.segment(reducedFrameLocalOffset[b], reducedFrameDim[b]);
+	}
+
+	void MipcConstraint::fillReducedHessian(MatrixX& reducedHess, MatrixX& hessian)
+	{
+		for (int c = 0; c < reducedFrameOffset.size(); c++)
+			for (int a = 0; a < reducedFrameOffset.size(); a++)
+				hessian.block(reducedFrameOffset[c], reducedFrameOffset[a], reducedFrameDim[c], reducedFrameDim[a]) += reducedHess.block(reducedFrameLocalOffset[c], reducedFrameLocalOffset[a], reducedFrameDim[c], reducedFrameDim[a]);
+	}
 
-			qeal c_p[3];
-			spheres[c]->center->getOriginalP(c_p);
-			for (int a = 0; a < 4; a++)
+	void MipcConstraint::fillReducedHessian(MatrixX& reducedHess, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal)
+	{
+		// the slots are assigned by the simulator when the csr pattern is built
+		int blocks = reducedFrameOffset.size();
+		for (int c = 0; c < blocks; c++)
+		{
+			for (int a = 0; a < blocks; a++)
 			{
-				FrameType a_frameType = spheres[a]->center->getFrameType();
-				if (a_frameType == FrameType::STATIC)
-					continue;
-				int a_frameId = spheres[a]->center->getFrameId();
-				int a_offset = spheres[a]->center->getOffset();
-				qeal a_p[3];
-				spheres[a]->center->getOriginalP(a_p);
-
-				qeal x0 = dbdx2.data()[12 * 3 * a + 3 * c + 0];
-				qeal x1 = dbdx2.data()[12 * 3 * a + 3 * c + 1];
-				qeal x2 = dbdx2.data()[12 * 3 * a + 3 * c + 2];
-
-				qeal x3 = dbdx2.data()[12 * (3 * a + 1) + 3 * c + 0];
-				qeal x4 = dbdx2.data()[12 * (3 * a + 1) + 3 * c + 1];
-				qeal x5 = dbdx2.data()[12 * (3 * a + 1) + 3 * c + 2];
-
-				qeal x6 = dbdx2.data()[12 * (3 * a + 2) + 3 * c + 0];
-				qeal x7 = dbdx2.data()[12 * (3 * a + 2) + 3 * c + 1];
-				qeal x8 = dbdx2.data()[12 * (3 * a + 2) + 3 * c + 2];
-
-				// hard code
-				if (c_frameType == FrameType::LINEAR)
+				int slot = reducedBlockSlot[c * blocks + a];
+				for (int i = 0; i < reducedFrameDim[c]; i++)
 				{
-					if (a_frameType == FrameType::LINEAR)
-					{
-						// 24 x 24
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 0, c_p[0] * x0 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 0, c_p[0] * x1 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 0, c_p[0] * x2 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 0, c_p[1] * x0 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 0, c_p[1] * x1 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 0, c_p[1] * x2 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 0, c_p[2] * x0 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 0, c_p[2] * x1 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 0, c_p[2] * x2 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 0, 1.0 * x0 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 0, 1.0 * x1 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 0, 1.0 * x2 * a_p[0]));
-						//
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 1, c_p[0] * x3 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 1, c_p[0] * x4 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 1, c_p[0] * x5 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 1, c_p[1] * x3 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 1, c_p[1] * x4 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 1, c_p[1] * x5 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 1, c_p[2] * x3 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 1, c_p[2] * x4 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 1, c_p[2] * x5 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 1, 1.0 * x3 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 1, 1.0 * x4 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 1, 1.0 * x5 * a_p[0]));
-						//
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 2, c_p[0] * x6 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 2, c_p[0] * x7 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 2, c_p[0] * x8 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 2, c_p[1] * x6 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 2, c_p[1] * x7 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 2, c_p[1] * x8 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 2, c_p[2] * x6 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 2, c_p[2] * x7 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 2, c_p[2] * x8 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 2, 1.0 * x6 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 2, 1.0 * x7 * a_p[0]));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 2, 1.0 * x8 * a_p[0]));
-
-						//
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 3, c_p[0] * x0 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 3, c_p[0] * x1 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 3, c_p[0] * x2 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 3, c_p[1] * x0 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 3, c_p[1] * x1 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 3, c_p[1] * x2 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 3, c_p[2] * x0 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 3, c_p[2] * x1 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 3, c_p[2] * x2 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 3, 1.0 * x0 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 3, 1.0 * x1 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 3, 1.0 * x2 * a_p[1]));
-						//
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 4, c_p[0] * x3 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 4, c_p[0] * x4 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 4, c_p[0] * x5 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 4, c_p[1] * x3 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 4, c_p[1] * x4 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 4, c_p[1] * x5 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 4, c_p[2] * x3 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 4, c_p[2] * x4 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 4, c_p[2] * x5 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 4, 1.0 * x3 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 4, 1.0 * x4 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 4, 1.0 * x5 * a_p[1]));
-
-						//
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 5, c_p[0] * x6 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 5, c_p[0] * x7 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 5, c_p[0] * x8 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 5, c_p[1] * x6 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 5, c_p[1] * x7 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 5, c_p[1] * x8 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 5, c_p[2] * x6 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 5, c_p[2] * x7 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 5, c_p[2] * x8 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 5, 1.0 * x6 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 5, 1.0 * x7 * a_p[1]));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 5, 1.0 * x8 * a_p[1]));
-
-						//
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 6, c_p[0] * x0 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 6, c_p[0] * x1 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 6, c_p[0] * x2 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 6, c_p[1] * x0 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 6, c_p[1] * x1 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 6, c_p[1] * x2 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 6, c_p[2] * x0 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 6, c_p[2] * x1 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 6, c_p[2] * x2 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 6, 1.0 * x0 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 6, 1.0 * x1 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 6, 1.0 * x2 * a_p[2]));
-
-						//
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 7, c_p[0] * x3 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 7, c_p[0] * x4 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 7, c_p[0] * x5 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 7, c_p[1] * x3 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 7, c_p[1] * x4 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 7, c_p[1] * x5 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 7, c_p[2] * x3 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 7, c_p[2] * x4 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 7, c_p[2] * x5 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 7, 1.0 * x3 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 7, 1.0 * x4 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 7, 1.0 * x5 * a_p[2]));
-
-						//
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 8, c_p[0] * x6 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 8, c_p[0] * x7 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 8, c_p[0] * x8 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 8, c_p[1] * x6 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 8, c_p[1] * x7 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 8, c_p[1] * x8 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 8, c_p[2] * x6 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 8, c_p[2] * x7 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 8, c_p[2] * x8 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 8, 1.0 * x6 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 8, 1.0 * x7 * a_p[2]));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 8, 1.0 * x8 * a_p[2]));
-
-						//
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 9, c_p[0] * x0 * 1.0));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 9, c_p[0] * x1 * 1.0));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 9, c_p[0] * x2 * 1.0));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 9, c_p[1] * x0 * 1.0));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 9, c_p[1] * x1 *1.0));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 9, c_p[1] * x2 * 1.0));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 9, c_p[2] * x0 * 1.0));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 9, c_p[2] * x1 * 1.0));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 9, c_p[2] * x2 * 1.0));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 9, 1.0 * x0 * 1.0));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 9, 1.0 * x1 * 1.0));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 9, 1.0 * x2 * 1.0));
-
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 10, c_p[0] * x3 * 1.0));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 10, c_p[0] * x4 * 1.0));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 10, c_p[0] * x5 * 1.0));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 10, c_p[1] * x3 * 1.0));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 10, c_p[1] * x4 *1.0));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 10, c_p[1] * x5 * 1.0));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 10, c_p[2] * x3 * 1.0));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 10, c_p[2] * x4 * 1.0));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 10, c_p[2] * x5 * 1.0));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 10, 1.0 * x3 * 1.0));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 10, 1.0 * x4 * 1.0));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 10, 1.0 * x5 * 1.0));
-
-						triplet.push_back(TripletX(c_offset + 0, a_offset + 11, c_p[0] * x6 * 1.0));
-						triplet.push_back(TripletX(c_offset + 1, a_offset + 11, c_p[0] * x7 * 1.0));
-						triplet.push_back(TripletX(c_offset + 2, a_offset + 11, c_p[0] * x8 * 1.0));
-						triplet.push_back(TripletX(c_offset + 3, a_offset + 11, c_p[1] * x6 * 1.0));
-						triplet.push_back(TripletX(c_offset + 4, a_offset + 11, c_p[1] * x7 *1.0));
-						triplet.push_back(TripletX(c_offset + 5, a_offset + 11, c_p[1] * x8 * 1.0));
-						triplet.push_back(TripletX(c_offset + 6, a_offset + 11, c_p[2] * x6 * 1.0));
-						triplet.push_back(TripletX(c_offset + 7, a_offset + 11, c_p[2] * x7 * 1.0));
-						triplet.push_back(TripletX(c_offset + 8, a_offset + 11, c_p[2] * x8 * 1.0));
-						triplet.push_back(TripletX(c_offset + 9, a_offset + 11, 1.0 * x6 * 1.0));
-						triplet.push_back(TripletX(c_offset + 10, a_offset + 11, 1.0 * x7 * 1.0));
-						triplet.push_back(TripletX(c_offset + 11, a_offset + 11, 1.0 * x8 * 1.0));
-					}
+					qeal* row = csrVal.data() + csrRowPtr[reducedFrameOffset[c] + i] + slot;
+					for (int j = 0; j < reducedFrameDim[a]; j++)
+						row[j] += reducedHess(reducedFrameLocalOffset[c] + i, reducedFrameLocalOffset[a] + j);
 				}
-
 			}
 		}
 	}
@@ -568,96 +318,99 @@ namespace MIPC
 
 		delta = 4 * A * C - B * B;
 
-		qeal temp_alpha, temp_beta;
-		qeal temp_dist;
-
-		distanceMode = TWO_ENDPOINTS;
-		alpha = 0.0, beta = 0.0;
-		distance = valueOfQuadircSurface2D(alpha, beta, A, B, C, D, E, F);
-
-		temp_alpha = 1.0, temp_beta = 0.0;
-		temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
-		if (distance > temp_dist)
+		if (!warmStartDistance())
 		{
-			distance = temp_dist;
-			alpha = temp_alpha; beta = temp_beta;
-		}
+			qeal temp_alpha, temp_beta;
+			qeal temp_dist;
 
-		temp_alpha = 0.0, temp_beta = 1.0;
-		temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
-		if (distance > temp_dist)
-		{
-			distance = temp_dist;
-			alpha = temp_alpha; beta = temp_beta;
-		}
+			distanceMode = TWO_ENDPOINTS;
+			alpha = 0.0, beta = 0.0;
+			distance = valueOfQuadircSurface2D(alpha, beta, A, B, C, D, E, F);
 
-		temp_alpha = 1.0, temp_beta = 1.0;
-		temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
-		if (distance > temp_dist)
-		{
-			distance = temp_dist;
-			alpha = temp_alpha; beta = temp_beta;
-		}
-
-		temp_alpha = 0.0; temp_beta = -E / (2.0 * C);
-		if (temp_beta > 0.0 && temp_beta < 1.0)
-		{
+			temp_alpha = 1.0, temp_beta = 0.0;
 			temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
 			if (distance > temp_dist)
 			{
 				distance = temp_dist;
 				alpha = temp_alpha; beta = temp_beta;
-				distanceMode = ALPHA_ZERO;
 			}
-		}
 
-		temp_alpha = 1.0; temp_beta = -(B + E) / (2.0 *C);
-		if (temp_beta > 0.0 && temp_beta < 1.0)
-		{
+			temp_alpha = 0.0, temp_beta = 1.0;
 			temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
 			if (distance > temp_dist)
 			{
 				distance = temp_dist;
 				alpha = temp_alpha; beta = temp_beta;
-				distanceMode = ALPHA_ONE;
 			}
-		}
 
-		temp_alpha = -D / (2.0 *A); temp_beta = 0.0;
-		if (temp_alpha > 0.0 && temp_alpha < 1.0)
-		{
+			temp_alpha = 1.0, temp_beta = 1.0;
 			temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
 			if (distance > temp_dist)
 			{
 				distance = temp_dist;
 				alpha = temp_alpha; beta = temp_beta;
-				distanceMode = BETA_ZERO;
 			}
-		}
 
-		temp_alpha = -(B + D) / (2.0 *A); temp_beta = 1.0;
-		if (temp_alpha > 0.0 && temp_alpha < 1.0)
-		{
-			temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
-			if (distance > temp_dist)
+			temp_alpha = 0.0; temp_beta = -E / (2.0 * C);
+			if (temp_beta > 0.0 && temp_beta < 1.0)
 			{
-				distance = temp_dist;
-				alpha = temp_alpha; beta = temp_beta;
-				distanceMode = BETA_ONE;
+				temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
+				if (distance > temp_dist)
+				{
+					distance = temp_dist;
+					alpha = temp_alpha; beta = temp_beta;
+					distanceMode = ALPHA_ZERO;
+				}
 			}
-		}
 
-		if (delta != 0.0)
-		{
-			temp_alpha = (B * E - 2.0 * C * D) / delta; temp_beta = (B * D - 2.0 * A * E) / delta;
-			if (temp_alpha > 0.0 && temp_alpha < 1.0 && temp_beta> 0.0 && temp_beta < 1.0)
+			temp_alpha = 1.0; temp_beta = -(B + E) / (2.0 *C);
+			if (temp_beta > 0.0 && temp_beta < 1.0)
+			{
+				temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
+				if (distance > temp_dist)
+				{
+					distance = temp_dist;
+					alpha = temp_alpha; beta = temp_beta;
+					distanceMode = ALPHA_ONE;
+				}
+			}
+
+			temp_alpha = -D / (2.0 *A); temp_beta = 0.0;
+			if (temp_alpha > 0.0 && temp_alpha < 1.0)
+			{
+				temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
+				if (distance > temp_dist)
+				{
+					distance = temp_dist;
+					alpha = temp_alpha; beta = temp_beta;
+					distanceMode = BETA_ZERO;
+				}
+			}
+
+			temp_alpha = -(B + D) / (2.0 *A); temp_beta = 1.0;
+			if (temp_alpha > 0.0 && temp_alpha < 1.0)
 			{
 				temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
 				if (distance > temp_dist)
 				{
 					distance = temp_dist;
 					alpha = temp_alpha; beta = temp_beta;
-					distanceMode = ALPHA_BETA;
+					distanceMode = BETA_ONE;
+				}
+			}
+
+			if (delta != 0.0)
+			{
+				temp_alpha = (B * E - 2.0 * C * D) / delta; temp_beta = (B * D - 2.0 * A * E) / delta;
+				if (temp_alpha > 0.0 && temp_alpha < 1.0 && temp_beta> 0.0 && temp_beta < 1.0)
+				{
+					temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
+					if (distance > temp_dist)
+					{
+						distance = temp_dist;
+						alpha = temp_alpha; beta = temp_beta;
+						distanceMode = ALPHA_BETA;
+					}
 				}
 			}
 		}
@@ -678,9 +431,66 @@ namespace MIPC
 		cloestPoints[0] = cp + dir * rp;
 		cloestPoints[1] = cq - dir * rq;
 
+		hasWarmStart = true;
 		return distance;
 	}
 
+	bool MipcConeConeConstraint::warmStartDistance()
+	{
+		if (!warmStart || !hasWarmStart)
+			return false;
+		// KKT conditions only guarantee the minimum for a strictly convex quadric
+		if (A <= 0.0 || C <= 0.0 || delta <= 0.0)
+			return false;
+
+		qeal a = alpha, b = beta;
+		bool aFree = false, bFree = false;
+		switch (distanceMode)
+		{
+		case TWO_ENDPOINTS:
+			break;
+		case ALPHA_ZERO:
+			a = 0.0; b = -E / (2.0 * C);
+			bFree = true;
+			break;
+		case ALPHA_ONE:
+			a = 1.0; b = -(B + E) / (2.0 * C);
+			bFree = true;
+			break;
+		case BETA_ZERO:
+			a = -D / (2.0 * A); b = 0.0;
+			aFree = true;
+			break;
+		case BETA_ONE:
+			a = -(B + D) / (2.0 * A); b = 1.0;
+			aFree = true;
+			break;
+		case ALPHA_BETA:
+			a = (B * E - 2.0 * C * D) / delta; b = (B * D - 2.0 * A * E) / delta;
+			aFree = true; bFree = true;
+			break;
+		default:
+			return false;
+		};
+
+		if (aFree && !(a > 0.0 && a < 1.0))
+			return false;
+		if (bFree && !(b > 0.0 && b < 1.0))
+			return false;
+
+		// a bounded parameter must have its gradient pointing out of the box
+		qeal fa = 2.0 * A * a + B * b + D;
+		qeal fb = B * a + 2.0 * C * b + E;
+		if (!aFree && ((a == 0.0 && fa < 0.0) || (a == 1.0 && fa > 0.0)))
+			return false;
+		if (!bFree && ((b == 0.0 && fb < 0.0) || (b == 1.0 && fb > 0.0)))
+			return false;
+
+		alpha = a; beta = b;
+		distance = valueOfQuadircSurface2D(alpha, beta, A, B, C, D, E, F);
+		return true;
+	}
+
 	void MipcConeConeConstraint::getTanBasis(Eigen::Matrix<qeal, 3, 2>& lagBasis)
 	{
 		lagBasis.setZero();
@@ -766,7 +576,7 @@ namespace MIPC
 		lagLamda = -kappa * getBarrierGradient() * 2.0 * sqrt(distance);
 	}
 
-	void MipcConeConeConstraint::getGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian)
+	void MipcConeConeConstraint::getLocalGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess)
 	{
 		qeal barrierGrad = getBarrierGradient();
 		qeal barrierHessian = getBarrierHessian();
@@ -777,234 +587,50 @@ namespace MIPC
 
 		MatrixX distHessina;
 		distHessina.resize(12, 12);
-		distHessina.setZero();
-
-		diff_F_x(distGrad);
-		//gradient
-		qeal scale = -1.0 * kappa * barrierGrad;
-		fillOverallGradient(scale, distGrad, gradient);
-
-		//hessian
-		switch (distanceMode)
-		{
-		case TWO_ENDPOINTS:
-			endPointsHessina(distHessina);
-			break;
-		case ALPHA_ZERO:
-			alphaIsZeroHessina(distHessina);
-			break;
-		case ALPHA_ONE:
-			alphaIsOneHessina(distHessina);
-			break;
-		case BETA_ZERO:
-			betaIsZeroHessina(distHessina);
-			break;
-		case BETA_ONE:
-			betaIsOneHessina(distHessina);
-			break;
-		case ALPHA_BETA:
-			alphaBetaHessina(distHessina);
-			break;
-		default:
-			break;
-		};
-
-		MatrixX hess = barrierGrad * distHessina + barrierHessian * (distGrad * distGrad.transpose());
-		makePD(hess);
-		hess *= kappa;
-
-		fillOverallHessian(1.0, hess, hessian);
-	}
-
-	void MipcConeConeConstraint::getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian)
-	{
-		Vector3 c11p, c12p, c21p, c22p;
-		spheres[0]->center->projectFullspacePreP(c11p.data());
-		spheres[1]->center->projectFullspacePreP(c12p.data());
-		spheres[2]->center->projectFullspacePreP(c21p.data());
-		spheres[3]->center->projectFullspacePreP(c22p.data());
-
-		Vector3 rel_u;
-		for (int i = 0; i < 3; i++)
-			rel_u.data()[i] = (lagAlpha * (spheres[0]->center->getP()[i] - c11p.data()[i]) + (1.0 - lagAlpha) * (spheres[1]->center->getP()[i] - c12p.data()[i])) - (lagBbeta * (spheres[2]->center->getP()[i] - c21p.data()[i]) + (1.0 - lagBbeta) * (spheres[3]->center->getP()[i] - c22p.data()[i]));
-
-		Vector2 rel_uk = lagBasis.transpose() * rel_u;
-		qeal rel_ukSqNorm = rel_uk.squaredNorm();
-		qeal rel_ukNorm = std::sqrt(rel_ukSqNorm);
-
-		qeal f1_div_relDXNorm, f2_term;
-		f1_SF_Div_RelDXNorm(rel_ukSqNorm, epsvh, f1_div_relDXNorm);
-		f2_SF_Term(rel_ukSqNorm, epsvh, f2_term);
-
-
-		Vector3 fricForce = -1.0 * f1_div_relDXNorm * mu *lagLamda * lagBasis * rel_uk;
-
-		MatrixX HessianI(12, 12);
-		HessianI.setZero();
-		MatrixX selectMatrix(12, 3);
-		selectMatrix.setZero();
-		selectMatrix.data()[0] = lagAlpha;   selectMatrix.data()[13] = lagAlpha;   selectMatrix.data()[26] = lagAlpha;
-		selectMatrix.data()[3] = 1 - lagAlpha;  selectMatrix.data()[16] = 1 - lagAlpha;  selectMatrix.data()[29] = 1 - lagAlpha;
-		selectMatrix.data()[6] = -lagBbeta;   selectMatrix.data()[19] = -lagBbeta;   selectMatrix.data()[32] = -lagBbeta;
-		selectMatrix.data()[9] = -(1.0 - lagBbeta); selectMatrix.data()[22] = -(1.0 - lagBbeta);  selectMatrix.data()[35] = -(1.0 - lagBbeta);
-
-		MatrixX TT = lagBasis.transpose() * selectMatrix.transpose();
-
-		if (rel_ukSqNorm >= (epsvh * epsvh)) {
-			// no SPD projection needed
-			Vector2 ubar;
-			ubar.data()[0] = -rel_uk.data()[1];
-			ubar.data()[1] = rel_uk.data()[0];
-			HessianI = (TT.transpose() * ((mu * lagLamda * f1_div_relDXNorm / rel_ukSqNorm) * ubar)) * (ubar.transpose() * TT);
-		}
-		else
-		{
-			if (rel_ukSqNorm == 0) {
-				HessianI = ((mu * lagLamda * f1_div_relDXNorm) * TT.transpose()) * TT;
-			}
-			else
-			{
-				MatrixX innerMtr = ((f2_term / rel_ukNorm) * rel_uk) * rel_uk.transpose();
-				innerMtr.diagonal().array() += f1_div_relDXNorm;
-				makePD(innerMtr);
-				innerMtr *= mu * lagLamda;
-				HessianI = TT.transpose() * innerMtr * TT;
-			}
-		}
-
-		VectorX ff(12);
-		ff.setZero();
-
-		if (spheres[0]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[0]->center->getFrameId();
-			ff.data()[0] = lagAlpha * fricForce.data()[0];
-			ff.data()[1] = lagAlpha * fricForce.data()[1];
-			ff.data()[2] = lagAlpha * fricForce.data()[2];
-		}
-
-		if (spheres[1]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[1]->center->getFrameId();
-			ff.data()[3] = (1.0 - lagAlpha) *  fricForce.data()[0];
-			ff.data()[4] = (1.0 - lagAlpha) *  fricForce.data()[1];
-			ff.data()[5] = (1.0 - lagAlpha) *  fricForce.data()[2];
-		}
-
-		if (spheres[2]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[2]->center->getFrameId();
-			ff.data()[6] = -lagBbeta * fricForce.data()[0];
-			ff.data()[7] = -lagBbeta * fricForce.data()[1];
-			ff.data()[8] = -lagBbeta * fricForce.data()[2];
-		}
-
-		if (spheres[3]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[3]->center->getFrameId();
-			ff.data()[9] = -(1.0 - lagBbeta) * fricForce.data()[0];
-			ff.data()[10] = -(1.0 - lagBbeta) * fricForce.data()[1];
-			ff.data()[11] = -(1.0 - lagBbeta) * fricForce.data()[2];
-		}
-		fillOverallGradient(1.0, ff, gradient);
-		fillOverallHessian(1.0, HessianI, hessian);
-	}
-
-	void MipcConeConeConstraint::getGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet)
-	{
-		Vector3 c11p, c12p, c21p, c22p;
-		spheres[0]->center->projectFullspacePreP(c11p.data());
-		spheres[1]->center->projectFullspacePreP(c12p.data());
-		spheres[2]->center->projectFullspacePreP(c21p.data());
-		spheres[3]->center->projectFullspacePreP(c22p.data());
-
-		Vector3 rel_u;
-		for (int i = 0; i < 3; i++)
-			rel_u.data()[i] = (lagAlpha * (spheres[0]->center->getP()[i] - c11p.data()[i]) + (1.0 - lagAlpha) * (spheres[1]->center->getP()[i] - c12p.data()[i])) - (lagBbeta * (spheres[2]->center->getP()[i] - c21p.data()[i]) + (1.0 - lagBbeta) * (spheres[3]->center->getP()[i] - c22p.data()[i]));
-
-		Vector2 rel_uk = lagBasis.transpose() * rel_u;
-		qeal rel_ukSqNorm = rel_uk.squaredNorm();
-		qeal rel_ukNorm = std::sqrt(rel_ukSqNorm);
-
-		qeal f1_div_relDXNorm, f2_term;
-		f1_SF_Div_RelDXNorm(rel_ukSqNorm, epsvh, f1_div_relDXNorm);
-		f2_SF_Term(rel_ukSqNorm, epsvh, f2_term);
-
-
-		Vector3 fricForce = -1.0 * f1_div_relDXNorm * mu *lagLamda * lagBasis * rel_uk;
-
-		MatrixX HessianI(12, 12);
-		HessianI.setZero();
-		MatrixX selectMatrix(12, 3);
-		selectMatrix.setZero();
-		selectMatrix.data()[0] = lagAlpha;   selectMatrix.data()[13] = lagAlpha;   selectMatrix.data()[26] = lagAlpha;
-		selectMatrix.data()[3] = 1 - lagAlpha;  selectMatrix.data()[16] = 1 - lagAlpha;  selectMatrix.data()[29] = 1 - lagAlpha;
-		selectMatrix.data()[6] = -lagBbeta;   selectMatrix.data()[19] = -lagBbeta;   selectMatrix.data()[32] = -lagBbeta;
-		selectMatrix.data()[9] = -(1.0 - lagBbeta); selectMatrix.data()[22] = -(1.0 - lagBbeta);  selectMatrix.data()[35] = -(1.0 - lagBbeta);
-
-		MatrixX TT = lagBasis.transpose() * selectMatrix.transpose();
-
-		if (rel_ukSqNorm >= (epsvh * epsvh)) {
-			// no SPD projection needed
-			Vector2 ubar;
-			ubar.data()[0] = -rel_uk.data()[1];
-			ubar.data()[1] = rel_uk.data()[0];
-			HessianI = (TT.transpose() * ((mu * lagLamda * f1_div_relDXNorm / rel_ukSqNorm) * ubar)) * (ubar.transpose() * TT);
-		}
-		else
-		{
-			if (rel_ukSqNorm == 0) {
-				HessianI = ((mu * lagLamda * f1_div_relDXNorm) * TT.transpose()) * TT;
-			}
-			else
-			{
-				MatrixX innerMtr = ((f2_term / rel_ukNorm) * rel_uk) * rel_uk.transpose();
-				innerMtr.diagonal().array() += f1_div_relDXNorm;
-				makePD(innerMtr);
-				innerMtr *= mu * lagLamda;
-				HessianI = TT.transpose() * innerMtr * TT;
-			}
-		}
-
-		VectorX ff(12);
-		ff.setZero();
-
-		if (spheres[0]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[0]->center->getFrameId();
-			ff.data()[0] = lagAlpha * fricForce.data()[0];
-			ff.data()[1] = lagAlpha * fricForce.data()[1];
-			ff.data()[2] = lagAlpha * fricForce.data()[2];
-		}
+		distHessina.setZero();
 
-		if (spheres[1]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[1]->center->getFrameId();
-			ff.data()[3] = (1.0 - lagAlpha) *  fricForce.data()[0];
-			ff.data()[4] = (1.0 - lagAlpha) *  fricForce.data()[1];
-			ff.data()[5] = (1.0 - lagAlpha) *  fricForce.data()[2];
-		}
+		diff_F_x(distGrad);
+		//gradient
+		qeal scale = -1.0 * kappa * barrierGrad;
+		localGrad = scale * distGrad;
 
-		if (spheres[2]->center->getFrameType() != FrameType::STATIC)
+		//hessian
+		switch (distanceMode)
 		{
-			int frameId = spheres[2]->center->getFrameId();
-			ff.data()[6] = -lagBbeta * fricForce.data()[0];
-			ff.data()[7] = -lagBbeta * fricForce.data()[1];
-			ff.data()[8] = -lagBbeta * fricForce.data()[2];
-		}
+		case TWO_ENDPOINTS:
+			endPointsHessina(distHessina);
+			break;
+		case ALPHA_ZERO:
+			alphaIsZeroHessina(distHessina);
+			break;
+		case ALPHA_ONE:
+			alphaIsOneHessina(distHessina);
+			break;
+		case BETA_ZERO:
+			betaIsZeroHessina(distHessina);
+			break;
+		case BETA_ONE:
+			betaIsOneHessina(distHessina);
+			break;
+		case ALPHA_BETA:
+			alphaBetaHessina(distHessina);
+			break;
+		default:
+			break;
+		};
 
-		if (spheres[3]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[3]->center->getFrameId();
-			ff.data()[9] = -(1.0 - lagBbeta) * fricForce.data()[0];
-			ff.data()[10] = -(1.0 - lagBbeta) * fricForce.data()[1];
-			ff.data()[11] = -(1.0 - lagBbeta) * fricForce.data()[2];
-		}
-		fillOverallGradient(1.0, ff, gradient);
-		fillOverallHessian(1.0, HessianI, triplet);
+		localHess = barrierGrad * distHessina + barrierHessian * (distGrad * distGrad.transpose());
+		makePD(localHess);
+		localHess *= kappa;
+	}
+
+	void MipcConeConeConstraint::getGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian)
+	{
+		computeLocalGradientAndHessian(kappa);
+		fillLocalGradientAndHessian(gradient, hessian);
 	}
 
-	void MipcConeConeConstraint::getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet)
+	void MipcConeConeConstraint::getLocalFrictionGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess)
 	{
 		Vector3 c11p, c12p, c21p, c22p;
 		spheres[0]->center->projectFullspacePreP(c11p.data());
@@ -1094,8 +720,14 @@ namespace MIPC
 			ff.data()[10] = -(1.0 - lagBbeta) * fricForce.data()[1];
 			ff.data()[11] = -(1.0 - lagBbeta) * fricForce.data()[2];
 		}
-		fillOverallGradient(1.0, ff, gradient);
-		fillOverallHessian(1.0, HessianI, triplet);
+		localGrad = ff;
+		localHess = HessianI;
+	}
+
+	void MipcConeConeConstraint::getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian)
+	{
+		computeLocalFrictionGradientAndHessian(kappa);
+		fillLocalFrictionGradientAndHessian(gradient, hessian);
 	}
 
 	void MipcConeConeConstraint::diff_F_x(VectorX& diff)
@@ -2951,69 +2583,57 @@ namespace MIPC
 
 		delta = 4 * A * C - B * B;
 
-		qeal temp_alpha, temp_beta;
-		qeal temp_dist;
-		distanceMode = TWO_ENDPOINTS;
-		alpha = 0.0, beta = 0.0;
-		distance = valueOfQuadircSurface2D(alpha, beta, A, B, C, D, E, F);
-
-		temp_alpha = 1.0; temp_beta = 0.0;
-		temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
-		if (distance > temp_dist)
-		{
-			distance = temp_dist;
-			alpha = temp_alpha; beta = temp_beta;
-		}
-
-		temp_alpha = 0.0; temp_beta = 1.0;
-		temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
-		if (distance > temp_dist)
-		{
-			distance = temp_dist;
-			alpha = temp_alpha; beta = temp_beta;
-		}
-
-		temp_alpha = 0.0; temp_beta = -E / (2.0 *C);
-		if (temp_beta > 0.0 && temp_beta < 1.0)
+		if (!warmStartDistance())
 		{
+			qeal temp_alpha, temp_beta;
+			qeal temp_dist;
+			distanceMode = TWO_ENDPOINTS;
+			interiorMode = false;
+			alpha = 0.0, beta = 0.0;
+			distance = valueOfQuadircSurface2D(alpha, beta, A, B, C, D, E, F);
+
+			temp_alpha = 1.0; temp_beta = 0.0;
 			temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
 			if (distance > temp_dist)
 			{
 				distance = temp_dist;
 				alpha = temp_alpha; beta = temp_beta;
-				distanceMode = ALPHA_ZERO;
 			}
-		}
 
-		temp_alpha = -D / (2.0 *A); temp_beta = 0.0;
-		if (temp_alpha > 0.0 && temp_alpha < 1.0)
-		{
+			temp_alpha = 0.0; temp_beta = 1.0;
 			temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
 			if (distance > temp_dist)
 			{
 				distance = temp_dist;
 				alpha = temp_alpha; beta = temp_beta;
-				distanceMode = BETA_ZERO;
 			}
-		}
 
-		temp_alpha = 0.5 * (2.0 * C + E - B - D) / (A - B + C); temp_beta = 1.0 - temp_alpha;
-		if (temp_alpha > 0.0 && temp_alpha < 1.0)
-		{
-			temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
-			if (distance > temp_dist)
+			temp_alpha = 0.0; temp_beta = -E / (2.0 *C);
+			if (temp_beta > 0.0 && temp_beta < 1.0)
 			{
-				distance = temp_dist;
-				alpha = temp_alpha; beta = temp_beta;
-				distanceMode = ALPHA_BETA_ONE;
+				temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
+				if (distance > temp_dist)
+				{
+					distance = temp_dist;
+					alpha = temp_alpha; beta = temp_beta;
+					distanceMode = ALPHA_ZERO;
+				}
 			}
-		}
 
-		// can be ignored
-		if (delta != 0.0)
-		{
-			temp_alpha = (B * E - 2.0 * C * D) / delta; temp_beta = (B * D - 2.0 * A * E) / delta;
-			if (temp_alpha > 0.0 && temp_alpha < 1.0 && temp_beta> 0.0 && temp_beta < 1.0 && temp_alpha + temp_beta < 1.0)
+			temp_alpha = -D / (2.0 *A); temp_beta = 0.0;
+			if (temp_alpha > 0.0 && temp_alpha < 1.0)
+			{
+				temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
+				if (distance > temp_dist)
+				{
+					distance = temp_dist;
+					alpha = temp_alpha; beta = temp_beta;
+					distanceMode = BETA_ZERO;
+				}
+			}
+
+			temp_alpha = 0.5 * (2.0 * C + E - B - D) / (A - B + C); temp_beta = 1.0 - temp_alpha;
+			if (temp_alpha > 0.0 && temp_alpha < 1.0)
 			{
 				temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
 				if (distance > temp_dist)
@@ -3023,6 +2643,23 @@ namespace MIPC
 					distanceMode = ALPHA_BETA_ONE;
 				}
 			}
+
+			// can be ignored
+			if (delta != 0.0)
+			{
+				temp_alpha = (B * E - 2.0 * C * D) / delta; temp_beta = (B * D - 2.0 * A * E) / delta;
+				if (temp_alpha > 0.0 && temp_alpha < 1.0 && temp_beta> 0.0 && temp_beta < 1.0 && temp_alpha + temp_beta < 1.0)
+				{
+					temp_dist = valueOfQuadircSurface2D(temp_alpha, temp_beta, A, B, C, D, E, F);
+					if (distance > temp_dist)
+					{
+						distance = temp_dist;
+						alpha = temp_alpha; beta = temp_beta;
+						distanceMode = ALPHA_BETA_ONE;
+						interiorMode = true;
+					}
+				}
+			}
 		}
 
 		Vector3 cp, cq;
@@ -3034,9 +2671,81 @@ namespace MIPC
 		cloestPoints[0] = cp;
 		cloestPoints[1] = cq;
 
+		hasWarmStart = true;
 		return distance;
 	}
 
+	bool MipcSlabSphereConstraint::warmStartDistance()
+	{
+		if (!warmStart || !hasWarmStart)
+			return false;
+		// KKT conditions only guarantee the minimum for a strictly convex quadric
+		if (A <= 0.0 || C <= 0.0 || delta <= 0.0)
+			return false;
+
+		qeal a = alpha, b = beta;
+		qeal fa, fb;
+		switch (distanceMode)
+		{
+		case TWO_ENDPOINTS:
+			fa = 2.0 * A * a + B * b + D;
+			fb = B * a + 2.0 * C * b + E;
+			if (a == 0.0 && b == 0.0)
+			{
+				if (fa < 0.0 || fb < 0.0)
+					return false;
+			}
+			else if (a == 1.0)
+			{
+				if (fa > 0.0 || fb < fa)
+					return false;
+			}
+			else if (fb > 0.0 || fa < fb)
+				return false;
+			break;
+		case ALPHA_ZERO:
+			a = 0.0; b = -E / (2.0 * C);
+			if (!(b > 0.0 && b < 1.0))
+				return false;
+			if (2.0 * A * a + B * b + D < 0.0)
+				return false;
+			break;
+		case BETA_ZERO:
+			a = -D / (2.0 * A); b = 0.0;
+			if (!(a > 0.0 && a < 1.0))
+				return false;
+			if (B * a + 2.0 * C * b + E < 0.0)
+				return false;
+			break;
+		case ALPHA_BETA_ONE:
+			if (interiorMode)
+			{
+				a = (B * E - 2.0 * C * D) / delta; b = (B * D - 2.0 * A * E) / delta;
+				if (!(a > 0.0 && b > 0.0 && a + b < 1.0))
+					return false;
+			}
+			else
+			{
+				if (A - B + C <= 0.0)
+					return false;
+				a = 0.5 * (2.0 * C + E - B - D) / (A - B + C); b = 1.0 - a;
+				if (!(a > 0.0 && a < 1.0))
+					return false;
+				fa = 2.0 * A * a + B * b + D;
+				fb = B * a + 2.0 * C * b + E;
+				if (fa + fb > 0.0)
+					return false;
+			}
+			break;
+		default:
+			return false;
+		};
+
+		alpha = a; beta = b;
+		distance = valueOfQuadircSurface2D(alpha, beta, A, B, C, D, E, F);
+		return true;
+	}
+
 	void MipcSlabSphereConstraint::getTanBasis(Eigen::Matrix<qeal, 3, 2>& lagBasis)
 	{
 		lagBasis.setZero();
@@ -3113,7 +2822,7 @@ namespace MIPC
 		lagLamda = -kappa * getBarrierGradient() * 2.0 * sqrt(distance);
 	}
 
-	void MipcSlabSphereConstraint::getGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian)
+	void MipcSlabSphereConstraint::getLocalGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess)
 	{
 		qeal barrierGrad = getBarrierGradient();
 		qeal barrierHessian = getBarrierHessian();
@@ -3125,7 +2834,7 @@ namespace MIPC
 		distHessina.setZero();
 		diff_F_x(distGrad);
 
-		fillOverallGradient(-1.0 * kappa * barrierGrad, distGrad, gradient);
+		localGrad = -1.0 * kappa * barrierGrad * distGrad;
 
 		switch (distanceMode)
 		{
@@ -3148,154 +2857,19 @@ namespace MIPC
 			break;
 		};
 
-		MatrixX hess = barrierGrad * distHessina + barrierHessian * (distGrad * distGrad.transpose());
-		makePD(hess);
-
-		hess *= kappa;
-		fillOverallHessian(1.0, hess, hessian);
-	}
-
-	void MipcSlabSphereConstraint::getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian)
-	{
-		Vector3 c11p, c12p, c13p, csp;
-		spheres[0]->center->projectFullspacePreP(c11p.data());
-		spheres[1]->center->projectFullspacePreP(c12p.data());
-		spheres[2]->center->projectFullspacePreP(c13p.data());
-		spheres[3]->center->projectFullspacePreP(csp.data());
-
-		Vector3 rel_u;
-		for (int i = 0; i < 3; i++)
-			rel_u.data()[i] = (lagAlpha * (spheres[0]->center->getP()[i] - c11p.data()[i]) + lagBbeta * (spheres[1]->center->getP()[i] - c12p.data()[i]) + (1.0 - lagAlpha - lagBbeta) * (spheres[2]->center->getP()[i] - c13p.data()[i])) - (spheres[3]->center->getP()[i] - csp.data()[i]);
-
-		Vector2 rel_uk = lagBasis.transpose() * rel_u;
-		qeal rel_ukSqNorm = rel_uk.squaredNorm();
-		qeal rel_ukNorm = std::sqrt(rel_ukSqNorm);
-		qeal f1_div_relDXNorm, f2_term;
-		f1_SF_Div_RelDXNorm(rel_ukSqNorm, epsvh, f1_div_relDXNorm);
-		f2_SF_Term(rel_ukSqNorm, epsvh, f2_term);
-
-		Vector3 fricForce = -1.0 * f1_div_relDXNorm * mu *lagLamda * lagBasis * rel_uk;
-
-		MatrixX HessianI(12, 12);
-		HessianI.setZero();
-		MatrixX selectMatrix(12, 3);
-		selectMatrix.setZero();
-		selectMatrix.data()[0] = lagAlpha;   selectMatrix.data()[13] = lagAlpha;   selectMatrix.data()[26] = lagAlpha;
-		selectMatrix.data()[3] = lagBbeta;  selectMatrix.data()[16] = lagBbeta;  selectMatrix.data()[29] = lagBbeta;
-		selectMatrix.data()[6] = 1.0 - lagAlpha - lagBbeta;   selectMatrix.data()[19] = 1.0 - lagAlpha - lagBbeta;   selectMatrix.data()[32] = 1.0 - lagAlpha - lagBbeta;
-		selectMatrix.data()[9] = -1.0; selectMatrix.data()[22] = -1.0;  selectMatrix.data()[35] = -1.0;
-
-		MatrixX TT = lagBasis.transpose() * selectMatrix.transpose();
-
-		if (rel_ukSqNorm >= (epsvh * epsvh)) {
-			// no SPD projection needed
-			Vector2 ubar;
-			ubar.data()[0] = -rel_uk.data()[1];
-			ubar.data()[1] = rel_uk.data()[0];
-			HessianI = (TT.transpose() * ((mu * lagLamda * f1_div_relDXNorm / rel_ukSqNorm) * ubar)) * (ubar.transpose() * TT);
-		}
-		else
-		{
-			if (rel_ukSqNorm == 0) {
-				// no SPD projection needed
-				HessianI = ((mu * lagLamda * f1_div_relDXNorm) * TT.transpose()) * TT;
-			}
-			else
-			{
-				// only need to project the inner 2x2 matrix to SPD
-				MatrixX innerMtr = ((f2_term / rel_ukNorm) * rel_uk) * rel_uk.transpose();
-				innerMtr.diagonal().array() += f1_div_relDXNorm;
-				makePD(innerMtr);
-				innerMtr *= mu * lagLamda;
-				// tensor product:
-				HessianI = TT.transpose() * innerMtr * TT;
-			}
-		}
-
-		VectorX ff(12);
-		ff.setZero();
-		if (spheres[0]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[0]->center->getFrameId();
-
-			ff.data()[0] = lagAlpha * fricForce.data()[0];
-			ff.data()[1] = lagAlpha * fricForce.data()[1];
-			ff.data()[2] = lagAlpha * fricForce.data()[2];
-		}
-
-		if (spheres[1]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[1]->center->getFrameId();
-
-			ff.data()[3] = lagBbeta * fricForce.data()[0];
-			ff.data()[4] = lagBbeta * fricForce.data()[1];
-			ff.data()[5] = lagBbeta * fricForce.data()[2];
-		}
-
-		if (spheres[2]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[2]->center->getFrameId();
-
-			ff.data()[6] = (1.0 - lagAlpha - lagBbeta) * fricForce.data()[0];
-			ff.data()[7] = (1.0 - lagAlpha - lagBbeta) * fricForce.data()[1];
-			ff.data()[8] = (1.0 - lagAlpha - lagBbeta) * fricForce.data()[2];
-		}
-
-		if (spheres[3]->center->getFrameType() != FrameType::STATIC)
-		{
-			int frameId = spheres[3]->center->getFrameId();
+		localHess = barrierGrad * distHessina + barrierHessian * (distGrad * distGrad.transpose());
+		makePD(localHess);
 
-			ff.data()[9] = -1.0 * fricForce.data()[0];
-			ff.data()[10] = -1.0 * fricForce.data()[1];
-			ff.data()[11] = -1.0 * fricForce.data()[2];
-		}
-		fillOverallGradient(1.0, ff, gradient);
-		fillOverallHessian(1.0, HessianI, hessian);
+		localHess *= kappa;
 	}
 
-	void MipcSlabSphereConstraint::getGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet)
+	void MipcSlabSphereConstraint::getGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian)
 	{
-		qeal barrierGrad = getBarrierGradient();
-		qeal barrierHessian = getBarrierHessian();
-		VectorX distGrad;
-		distGrad.resize(12);
-		distGrad.setZero();
-		MatrixX distHessina;
-		distHessina.resize(12, 12);
-		distHessina.setZero();
-		diff_F_x(distGrad);
-
-		fillOverallGradient(-1.0 * kappa * barrierGrad, distGrad, gradient);
-
-		switch (distanceMode)
-		{
-		case TWO_ENDPOINTS:
-			endPointsHessina(distHessina);
-			break;
-		case ALPHA_ZERO:
-			alphaIsZeroHessina(distHessina);
-			break;
-		case BETA_ZERO:
-			betaIsZeroHessina(distHessina);
-			break;
-		case ALPHA_BETA_ONE:
-			alphaBetaPlusOneHessina(distHessina);
-			break;
-		case ALPHA_BETA:
-			alphaBetaHessina(distHessina);
-			break;
-		default:
-			break;
-		};
-
-		MatrixX hess = barrierGrad * distHessina + barrierHessian * (distGrad * distGrad.transpose());
-		makePD(hess);
-
-		hess *= kappa;
-		fillOverallHessian(1.0, hess, triplet);
+		computeLocalGradientAndHessian(kappa);
+		fillLocalGradientAndHessian(gradient, hessian);
 	}
 
-	void MipcSlabSphereConstraint::getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet)
+	void MipcSlabSphereConstraint::getLocalFrictionGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess)
 	{
 		Vector3 c11p, c12p, c13p, csp;
 		spheres[0]->center->projectFullspacePreP(c11p.data());
@@ -3389,8 +2963,14 @@ namespace MIPC
 			ff.data()[10] = -1.0 * fricForce.data()[1];
 			ff.data()[11] = -1.0 * fricForce.data()[2];
 		}
-		fillOverallGradient(1.0, ff, gradient);
-		fillOverallHessian(1.0, HessianI, triplet);
+		localGrad = ff;
+		localHess = HessianI;
+	}
+
+	void MipcSlabSphereConstraint::getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian)
+	{
+		computeLocalFrictionGradientAndHessian(kappa);
+		fillLocalFrictionGradientAndHessian(gradient, hessian);
 	}
 
 	void MipcSlabSphereConstraint::diff_F_x(VectorX & diff)
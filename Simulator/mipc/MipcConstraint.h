@@ -37,6 +37,8 @@ namespace MIPC
 
 		int info;
 		int index;
+		// models of the two sides, static models are stored as -id - 1
+		int modelPair[2];
 		CollisionType collisionType;
 		std::vector<CollideMedialSphere* > spheres;
 		qeal distance;
@@ -60,6 +62,37 @@ namespace MIPC
 		qeal epsvh;
 		qeal lagAlpha, lagBbeta;//
 
+		// reuse alpha, beta and distance mode of the last evaluation when they still satisfy KKT
+		bool warmStart;
+		bool hasWarmStart;
+
+		// the exact distance is skipped while the accumulated motion of the spheres since the last
+		// evaluation stays below the motion budget of that evaluation
+		bool motionFilter;
+		bool hasMotionMark;
+		qeal motionBudget;
+		qeal motionMark[4];
+
+		// placed in the hot or cold list of the current step
+		bool hotColdSorted;
+
+		// d(sphere centers) / d(frame dofs), 12 x local dofs, constant since the original centers never change
+		bool hasReducedJacobian;
+		MatrixX reducedJacobian;
+		std::vector<int> reducedFrameId;
+		std::vector<int> reducedFrameOffset;
+		std::vector<int> reducedFrameLocalOffset;
+		std::vector<int> reducedFrameDim;
+		int reducedSphereBlock[4];
+		// column position of frame block a inside the csr rows of frame block c, indexed by c * blocks + a
+		std::vector<int> reducedBlockSlot;
+
+		// contributions w.r.t. the local frame dofs, filled into the reduced system afterwards
+		VectorX localGradient;
+		MatrixX localHessian;
+		VectorX localFrictionGradient;
+		MatrixX localFrictionHessian;
+
 		MipcConstraint(int id, CollideMedialSphere* s0, CollideMedialSphere* s1, CollideMedialSphere* s2, CollideMedialSphere* s3, qeal disHat = 1.0 / 1000.0, qeal fricMu = 0.0, qeal fricEpsvh = 1e-4, int debug_info = 0):
 			index(id), dHat(disHat), mu(fricMu), epsvh(fricEpsvh), info(debug_info)
 		{
@@ -71,9 +104,19 @@ namespace MIPC
 			relU.setZero();
 			lagLamda = 0;
 			lagBasis.setZero();
+			hasReducedJacobian = false;
+			warmStart = false;
+			hasWarmStart = false;
+			motionFilter = false;
+			hasMotionMark = false;
+			motionBudget = 0.0;
+			hotColdSorted = false;
+			modelPair[0] = 0;
+			modelPair[1] = 0;
 		}
 
 		CollisionType getCollisionType() { return collisionType; }
+		void setModelPair(int m0, int m1) { modelPair[0] = m0; modelPair[1] = m1; }
 		virtual qeal getDistanceHat() { return dHat; }
 		virtual void setDistanceHat(qeal disHat) {dHat = disHat; dHat2= disHat * disHat;}
 		virtual qeal getDistance() { return distance; }
@@ -100,20 +143,45 @@ namespace MIPC
 			return (dhat_d + 2) * dhat_d - 2 * log(distance / dHat2) - 3;
 		}
 		bool isActive() { return distance <= dHat2 && distance > 0.0; }
+		// relative center motion the event can absorb before it may become active
+		qeal getMotionBudget();
+		// |c| - r at the closest pair of the last evaluation, distance itself is |c|^2 - r^2
+		qeal getGap()
+		{
+			Vector3 c = alpha * sC1 + beta * sC2 + sC3;
+			return c.norm() - (alpha * sR1 + beta * sR2 + sR3);
+		}
 
+		void setWarmStart(bool enable) { warmStart = enable; }
+		void setMotionFilter(bool enable) { motionFilter = enable; hasMotionMark = false; }
 		virtual qeal computeDistance() = 0;
+		qeal updateDistance();
+		virtual bool warmStartDistance() = 0;
 		virtual void getTanBasis(Eigen::Matrix<qeal, 3, 2>& lagBasis) = 0;
 		virtual void computeLagTangentBasis(const qeal kappa) = 0;
 
+		virtual void getLocalGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess) = 0;
+		virtual void getLocalFrictionGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess) = 0;
+
 		virtual void getGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian) = 0;
 		virtual void getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian) = 0;
 
-		virtual void getGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet) = 0;
-		virtual void getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet) = 0;
-
-		void fillOverallGradient(qeal S, VectorX& dbdx, VectorX& gradient);
-		void fillOverallHessian(qeal S, MatrixX& dbdx2, MatrixX& hessian);
-		void fillOverallHessian(qeal S, MatrixX & dbdx2, std::vector<TripletX>& triplet);
+		void getGradientAndHessian(qeal kappa, VectorX& gradient, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal);
+		void getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal);
+
+		// two-pass assembly: compute local terms (thread safe), then fill
+		void computeLocalGradientAndHessian(qeal kappa);
+		void computeLocalFrictionGradientAndHessian(qeal kappa);
+		void fillLocalGradientAndHessian(VectorX& gradient, MatrixX& hessian);
+		void fillLocalFrictionGradientAndHessian(VectorX& gradient, MatrixX& hessian);
+		void fillLocalGradientAndHessian(VectorX& gradient, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal);
+		void fillLocalFrictionGradientAndHessian(VectorX& gradient, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal);
+
+		void computeReducedFrameBlocks();
+		void computeReducedJacobian();
+		void fillReducedGradient(VectorX& reducedGrad, VectorX& gradient);
+		void fillReducedHessian(MatrixX& reducedHess, MatrixX& hessian);
+		void fillReducedHessian(MatrixX& reducedHess, const std::vector<int>& csrRowPtr, std::vector<qeal>& csrVal);
 	};
 
 	class MipcConeConeConstraint : public MipcConstraint
@@ -137,15 +205,16 @@ namespace MIPC
 		}
 		virtual qeal frictionEnergy();
 		virtual qeal computeDistance();
+		virtual bool warmStartDistance();
 		virtual void getTanBasis(Eigen::Matrix<qeal, 3, 2>& lagBasis);
 		virtual void computeLagTangentBasis(const qeal kappa);
 
+		virtual void getLocalGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess);
+		virtual void getLocalFrictionGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess);
+
 		virtual void getGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian);
 		virtual void getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian);
 
-		virtual void getGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet);
-		virtual void getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet);
-
 		inline void diff_F_x(VectorX& diff);
 		inline void endPointsHessina(MatrixX& hessina);
 		inline void alphaIsZeroHessina(MatrixX& hessina);
@@ -168,6 +237,7 @@ namespace MIPC
 			ALPHA_BETA = 4
 		};
 		DistanceMode distanceMode;
+		bool interiorMode; // ALPHA_BETA_ONE is also used for the interior case
 
 		MipcSlabSphereConstraint(int id, CollideMedialSphere* s0, CollideMedialSphere* s1, CollideMedialSphere* s2, CollideMedialSphere* s3, qeal disHat = 1.0 / 1000.0, qeal fricMu = 0.0, qeal fricEpsvh = 1e-4, int debug_info = 0) :MipcConstraint(index, s0, s1, s2, s3, disHat, fricMu, fricEpsvh, debug_info)
 		{
@@ -178,15 +248,16 @@ namespace MIPC
 		virtual qeal frictionEnergy();
 
 		virtual qeal computeDistance();
+		virtual bool warmStartDistance();
 		virtual void getTanBasis(Eigen::Matrix<qeal, 3, 2>& lagBasis);
 		virtual void computeLagTangentBasis(const qeal kappa);
 
+		virtual void getLocalGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess);
+		virtual void getLocalFrictionGradientAndHessian(qeal kappa, VectorX& localGrad, MatrixX& localHess);
+
 		virtual void getGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian);
 		virtual void getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, MatrixX& hessian);
 		
-		virtual void getGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet);
-		virtual void getFrictionGradientAndHessian(qeal kappa, VectorX& gradient, std::vector<TripletX>& triplet);
-
 		inline void diff_F_x(VectorX& diff);
 		inline void endPointsHessina(MatrixX& hessina);
 		inline void alphaIsZeroHessina(MatrixX& hessina);
@@ -1,4 +1,5 @@
 #include "MipcModel.h"
+#include "Simulator\FiniteElementMethod\StableNeoHookean.h"
 
 namespace MIPC
 {
@@ -41,8 +42,13 @@ namespace MIPC
 		std::ifstream fin(filename.c_str());
 		if (fin.is_open())
 		{
-			int linearNum, quadNum, transNum;
-			fin >> linearNum >> quadNum >> transNum;
+			int linearNum = 0, quadNum = 0, transNum = 0;
+			std::string line;
+			std::getline(fin, line);
+			std::istringstream counts(line);
+			counts >> linearNum >> quadNum;
+			if (!(counts >> transNum))
+				transNum = 0;
 
 			_staticFramesNum = medialPointsNum - linearNum - quadNum - transNum;
 			_linearFramesNum = linearNum;
@@ -100,25 +106,28 @@ namespace MIPC
 			return false;
 
 		std::ofstream fout(filename.c_str());
+		if (!fout.is_open())
+			return false;
 		std::vector<int> linearList;
 		std::vector<int> quadList;
-		for (size_t i = 0; i < _reducedTypes.size(); i++)
+		std::vector<int> transList;
+		for (size_t i = 0; i < _matFrameId.size(); i++)
 		{
 			int mid = _matFrameId[i];
-			if (_reducedTypes[i] == ReducedFrameType::LINEAR)
-			{
+			if (_reducedTypes[mid] == ReducedFrameType::LINEAR)
 				linearList.push_back(mid);
-			}
-			else if (_reducedTypes[i] == ReducedFrameType::Quadratic)
-			{
+			else if (_reducedTypes[mid] == ReducedFrameType::Quadratic)
 				quadList.push_back(mid);
-			}
+			else if (_reducedTypes[mid] == ReducedFrameType::Translation)
+				transList.push_back(mid);
 		}
-		fout << linearList.size() << " " << quadList.size() << std::endl;
+		fout << linearList.size() << " " << quadList.size() << " " << transList.size() << std::endl;
 		for (size_t i = 0; i < linearList.size(); i++)
 			fout << linearList[i] << std::endl;
 		for (size_t i = 0; i < quadList.size(); i++)
 			fout << quadList[i] << std::endl;
+		for (size_t i = 0; i < transList.size(); i++)
+			fout << transList[i] << std::endl;
 		fout.close();
 		return true;
 	}
@@ -162,6 +171,183 @@ namespace MIPC
 		}
 	}
 
+	void MipcModel::setFrameList(std::vector<int>& linearList, std::vector<int>& quadList)
+	{
+		_reducedTypes.assign(medialPointsNum, ReducedFrameType::STATIC);
+		_matFrameId.clear();
+		for (size_t i = 0; i < linearList.size(); i++)
+		{
+			_matFrameId.push_back(linearList[i]);
+			_reducedTypes[linearList[i]] = ReducedFrameType::LINEAR;
+		}
+		for (size_t i = 0; i < quadList.size(); i++)
+		{
+			_matFrameId.push_back(quadList[i]);
+			_reducedTypes[quadList[i]] = ReducedFrameType::Quadratic;
+		}
+		_linearFramesNum = linearList.size();
+		_quadFramesNum = quadList.size();
+		_translaFramesNum = 0;
+		_staticFramesNum = medialPointsNum - _linearFramesNum - _quadFramesNum;
+		_reducedDim = 12 * _linearFramesNum + 30 * _quadFramesNum;
+	}
+
+	bool MipcModel::selectFrames(int linearNum, int quadNum, MatrixX& samples, std::string filename)
+	{
+		if (!isMedialMeshValid() || !isBindedTetMesh())
+			return false;
+		int budget = std::min(linearNum + quadNum, medialPointsNum);
+		quadNum = std::min(quadNum, budget);
+		if (budget <= 0)
+			return false;
+		if (samples.rows() != 3 * tetPointsNum || samples.cols() == 0)
+			generateFrameSamples(FRAME_RANDOM_SAMPLE_NUM, samples);
+
+		std::vector<int> frames;
+		std::vector<bool> selected(medialPointsNum, false);
+		std::vector<int> empty;
+
+		// farthest point sampling over the medial points, started from the one farthest from their center
+		Vector3 center = Vector3::Zero();
+		for (int i = 0; i < medialPointsNum; i++)
+			center += getMedialPoint(i);
+		center /= medialPointsNum;
+		VectorX dist(medialPointsNum);
+		for (int i = 0; i < medialPointsNum; i++)
+			dist[i] = (getMedialPoint(i) - center).norm();
+
+		int seedNum = std::max(1, budget / 2);
+		while (frames.size() < seedNum)
+		{
+			int next;
+			dist.maxCoeff(&next);
+			frames.push_back(next);
+			selected[next] = true;
+			Vector3 p = getMedialPoint(next);
+			for (int i = 0; i < medialPointsNum; i++)
+				dist[i] = frames.size() == 1 ? (getMedialPoint(i) - p).norm() : std::min(dist[i], (getMedialPoint(i) - p).norm());
+			for (int i = 0; i < frames.size(); i++)
+				dist[frames[i]] = -1;
+		}
+
+		// the weights of the candidate sets are refactored from the cache, so every refinement only folds in the new frame
+		bool locality = setWeightLocality;
+		setWeightLocality = false;
+		VectorX error;
+		while (true)
+		{
+			setFrameList(frames, empty);
+			MatrixX weight = computeHarmonicWeight();
+			error = computeFrameFittingError(weight, samples);
+			if (frames.size() >= budget)
+			{
+				// the frames covering most of the remaining error get the quadratic terms
+				std::vector<std::pair<qeal, int>> frameError(frames.size());
+				for (int j = 0; j < frames.size(); j++)
+					frameError[j] = std::pair<qeal, int>(weight.col(j).cwiseAbs().dot(error), frames[j]);
+				std::sort(frameError.begin(), frameError.end(), std::greater<std::pair<qeal, int>>());
+				std::vector<int> linearList, quadList;
+				for (int j = 0; j < frameError.size(); j++)
+				{
+					if (j < quadNum)
+						quadList.push_back(frameError[j].second);
+					else linearList.push_back(frameError[j].second);
+				}
+				setFrameList(linearList, quadList);
+				break;
+			}
+
+			int next = -1;
+			qeal maxError = -1;
+			for (int i = 0; i < medialPointsNum; i++)
+			{
+				if (selected[i] || error[bindedTM[i]] <= maxError)
+					continue;
+				maxError = error[bindedTM[i]];
+				next = i;
+			}
+			if (next < 0)
+				break;
+			frames.push_back(next);
+			selected[next] = true;
+		}
+		setWeightLocality = locality;
+
+		return writeFrameMatList(filename);
+	}
+
+	void MipcModel::generateFrameSamples(int num, MatrixX& samples)
+	{
+		Vector3 bMin = getTetPoint(0), bMax = getTetPoint(0);
+		for (int i = 1; i < tetPointsNum; i++)
+		{
+			bMin = bMin.cwiseMin(getTetPoint(i));
+			bMax = bMax.cwiseMax(getTetPoint(i));
+		}
+		qeal size = (bMax - bMin).norm();
+
+		std::mt19937 generator(0);
+		std::normal_distribution<qeal> normal(0.0, 1.0);
+		std::uniform_int_distribution<int> medial(0, medialPointsNum - 1);
+		samples.resize(3 * tetPointsNum, num);
+		for (int s = 0; s < num; s++)
+		{
+			// the rotation about axis grows along dir, a twist if they are parallel and a bend otherwise
+			Vector3 c = getMedialPoint(medial(generator));
+			Vector3 dir(normal(generator), normal(generator), normal(generator));
+			Vector3 axis(normal(generator), normal(generator), normal(generator));
+			dir.normalize();
+			axis.normalize();
+			#pragma omp parallel for
+			for (int i = 0; i < tetPointsNum; i++)
+			{
+				Vector3 r = getTetPoint(i) - c;
+				qeal angle = FRAME_SAMPLE_ANGLE * r.dot(dir) / size;
+				Vector3 u = Eigen::AngleAxis<qeal>(angle, axis) * r - r;
+				samples.block(3 * i, s, 3, 1) = u;
+			}
+		}
+	}
+
+	VectorX MipcModel::computeFrameFittingError(MatrixX& weight, MatrixX& samples)
+	{
+		int tn = tetPointsNum;
+		int fn = weight.cols();
+		VectorX error(tn);
+		error.setZero();
+		if (samples.cols() == 0)
+			return error;
+
+		std::vector<TripletX> triplet;
+		for (int i = 0; i < tn; i++)
+		{
+			Vector3 p = getTetPoint(i);
+			qeal u[4] = { p[0], p[1], p[2], 1.0 };
+			for (int j = 0; j < fn; j++)
+			{
+				qeal w = weight(i, j);
+				if (IS_QEAL_ZERO(w))
+					continue;
+				for (int c = 0; c < 4; c++)
+					for (int a = 0; a < 3; a++)
+						triplet.push_back(TripletX(3 * i + a, 12 * j + 3 * c + a, w * u[c]));
+			}
+		}
+		SparseMatrix P(3 * tn, 12 * fn);
+		P.setFromTriplets(triplet.begin(), triplet.end());
+		SparseMatrix PT = P.transpose();
+		SparseMatrix S = PT * P;
+		for (int k = 0; k < S.rows(); k++)
+			S.coeffRef(k, k) += 1e-10;
+		Eigen::SimplicialLDLT<SparseMatrix> LDLT(S);
+		MatrixX rhs = PT * samples;
+		MatrixX q = LDLT.solve(rhs);
+		MatrixX r = P * q - samples;
+		for (int i = 0; i < tn; i++)
+			error[i] = r.middleRows(3 * i, 3).squaredNorm();
+		return error;
+	}
+
 	void MipcModel::computeLaplacianMatrix(std::vector<TripletX>& matValue)
 	{
 		for (size_t i = 0; i < tetPointsNum; i++)
@@ -197,11 +383,13 @@ namespace MIPC
 		std::vector<TripletX> matValue;
 		computeLaplacianMatrix(matValue);
 
+		std::vector<int> frameTetPoints(fn);
 		int rowIndex = tn;
 		for (size_t frameId = 0; frameId < _matFrameId.size(); frameId++)
 		{
 			int mid = _matFrameId[frameId];
 			int tetId = bindedTM[mid];
+			frameTetPoints[frameId] = tetId;
 			matValue.push_back(TripletX(rowIndex++, tetId, 1));
 		}
 
@@ -236,27 +424,40 @@ namespace MIPC
 			ccs.push_back(*it);
 		}
 		fixedTetNodesNum = ccs.size();
+		_fixedTetPoints = ccs;
 		for (int i = 0; i < fixedTetNodesNum; i++)
 		{
 			matValue.push_back(TripletX(rowDim + i, ccs[i], 1));
 		}
 
-		rowDim += fixedTetNodesNum;
-		coeffMat.resize(rowDim, colDim);
-		coeffMat.setFromTriplets(matValue.begin(), matValue.end());
+		std::string cacheFilename = dir + "harmonic_weight.cache";
+		unsigned long long key = computeHarmonicWeightKey(matValue, ccs);
 
+		// frames only added to a cached scene are folded into the cached columns, the cache itself keeps the factorized frames
 		MatrixX weight;
-		weight.resize(tn, fn);
-		weight.setZero();
-		SparseMatrix transpose = coeffMat.transpose();
-		SparseMatrix S = transpose * coeffMat;
-
-		Eigen::SimplicialLDLT<SparseMatrix> LDLT(S);
-		for (int i = 0; i < fn; i++)
+		if (!readHarmonicWeightCache(cacheFilename, key, frameTetPoints, weight))
 		{
-			VectorX d = transpose.col(tn + i);
-			VectorX w = LDLT.solve(d);
-			weight.col(i) = w;
+			rowDim += fixedTetNodesNum;
+			coeffMat.resize(rowDim, colDim);
+			coeffMat.setFromTriplets(matValue.begin(), matValue.end());
+
+			weight.resize(tn, fn);
+			weight.setZero();
+			SparseMatrix transpose = coeffMat.transpose();
+			SparseMatrix S = transpose * coeffMat;
+
+			Eigen::SimplicialLDLT<SparseMatrix> LDLT(S);
+			// one pass over the factors per block of frames, the blocks spread over the threads
+			int blockNum = (fn + HARMONIC_WEIGHT_SOLVE_BLOCK - 1) / HARMONIC_WEIGHT_SOLVE_BLOCK;
+			#pragma omp parallel for schedule(dynamic)
+			for (int b = 0; b < blockNum; b++)
+			{
+				int begin = b * HARMONIC_WEIGHT_SOLVE_BLOCK;
+				int num = std::min(HARMONIC_WEIGHT_SOLVE_BLOCK, fn - begin);
+				MatrixX d = transpose.middleCols(tn + begin, num);
+				weight.middleCols(begin, num) = LDLT.solve(d);
+			}
+			writeHarmonicWeightCache(cacheFilename, key, frameTetPoints, LDLT, weight);
 		}
 
 		if (setWeightLocality)
@@ -267,7 +468,7 @@ namespace MIPC
 				qeal sum = 0;
 				for (int j = 0; j < ws.size(); j++)
 				{
-					if (abs(ws.data()[j]) < weightLocalityThreshold)
+					if (std::abs(ws.data()[j]) < weightLocalityThreshold)
 					{
 						ws.data()[j] = 0;
 					}
@@ -276,7 +477,7 @@ namespace MIPC
 				}
 				for (int j = 0; j < ws.size(); j++)
 				{
-					if (abs(sum) < 1e-13)
+					if (std::abs(sum) < 1e-13)
 						continue;
 					ws.data()[j] = ws.data()[j] / sum;
 				}
@@ -288,36 +489,252 @@ namespace MIPC
 
 	}
 
+	unsigned long long MipcModel::computeHarmonicWeightKey(std::vector<TripletX>& laplacian, std::vector<int>& fixedTetPoints)
+	{
+		// fnv-1a, the frame rows of the system are left out on purpose, they are matched column by column
+		unsigned long long key = 14695981039346656037ULL;
+		std::vector<char> bytes;
+		int tn = tetPointsNum;
+		bytes.insert(bytes.end(), (char*)&tn, (char*)&tn + sizeof(int));
+		for (size_t i = 0; i < laplacian.size(); i++)
+		{
+			if (laplacian[i].row() >= tn)
+				continue;
+			int row = laplacian[i].row();
+			int col = laplacian[i].col();
+			qeal value = laplacian[i].value();
+			bytes.insert(bytes.end(), (char*)&row, (char*)&row + sizeof(int));
+			bytes.insert(bytes.end(), (char*)&col, (char*)&col + sizeof(int));
+			bytes.insert(bytes.end(), (char*)&value, (char*)&value + sizeof(qeal));
+		}
+		for (size_t i = 0; i < fixedTetPoints.size(); i++)
+			bytes.insert(bytes.end(), (char*)&fixedTetPoints[i], (char*)&fixedTetPoints[i] + sizeof(int));
+
+		for (size_t i = 0; i < bytes.size(); i++)
+		{
+			key ^= (unsigned char)bytes[i];
+			key *= 1099511628211ULL;
+		}
+		return key;
+	}
+
+	unsigned long long MipcModel::computeRestStateKey()
+	{
+		// fnv-1a like the weight key, over the rest state rather than the laplacian, which does not see a uniform scale
+		unsigned long long key = 14695981039346656037ULL;
+		std::vector<char> bytes;
+		for (int i = 0; i < tetPointsNum; i++)
+		{
+			Vector3 p = getTetPoint(i);
+			bytes.insert(bytes.end(), (char*)p.data(), (char*)p.data() + 3 * sizeof(qeal));
+		}
+		for (int i = 0; i < tetElementNum; i++)
+		{
+			Vector4i ele = getTetElement(i);
+			bytes.insert(bytes.end(), (char*)ele.data(), (char*)ele.data() + 4 * sizeof(int));
+		}
+		for (size_t i = 0; i < _fixedTetPoints.size(); i++)
+			bytes.insert(bytes.end(), (char*)&_fixedTetPoints[i], (char*)&_fixedTetPoints[i] + sizeof(int));
+		for (size_t i = 0; i < _matFrameId.size(); i++)
+		{
+			int tetId = bindedTM[_matFrameId[i]];
+			bytes.insert(bytes.end(), (char*)&tetId, (char*)&tetId + sizeof(int));
+		}
+
+		for (size_t i = 0; i < bytes.size(); i++)
+		{
+			key ^= (unsigned char)bytes[i];
+			key *= 1099511628211ULL;
+		}
+		return key;
+	}
+
+	bool MipcModel::readHarmonicWeightCache(const std::string filename, unsigned long long key, std::vector<int>& frameTetPoints, MatrixX& weight)
+	{
+		std::ifstream fin(filename.c_str(), std::ios::binary);
+		if (!fin.is_open())
+			return false;
+		unsigned long long cacheKey = 0;
+		int cacheTetPointsNum = 0;
+		fin.read((char*)&cacheKey, sizeof(unsigned long long));
+		fin.read((char*)&cacheTetPointsNum, sizeof(int));
+		if (!fin.good() || cacheKey != key || cacheTetPointsNum != tetPointsNum)
+			return false;
+
+		std::vector<int> cacheFrameTetPoints;
+		MatrixX cacheWeight;
+		StlBinaryIO::readOneLevelVector(fin, cacheFrameTetPoints);
+		EigenMatrixIO::read_binary(fin, cacheWeight);
+		if (!fin.good() || cacheWeight.rows() != tetPointsNum || cacheWeight.cols() != cacheFrameTetPoints.size())
+			return false;
+
+		// a column only depends on the binded tet point of its frame, whatever the frame order or type
+		std::multimap<int, int> cacheColumns;
+		for (int i = 0; i < cacheFrameTetPoints.size(); i++)
+			cacheColumns.insert(std::pair<int, int>(cacheFrameTetPoints[i], i));
+		int fn = frameTetPoints.size();
+		std::vector<int> columnMap(fn, -1);
+		std::vector<int> newFrames;
+		for (int i = 0; i < fn; i++)
+		{
+			std::multimap<int, int>::iterator it = cacheColumns.find(frameTetPoints[i]);
+			if (it == cacheColumns.end())
+			{
+				newFrames.push_back(i);
+				continue;
+			}
+			columnMap[i] = it->second;
+			cacheColumns.erase(it);
+		}
+		// a removed frame changes every other column, solve again
+		if (cacheColumns.size() > 0)
+			return false;
+
+		weight.resize(tetPointsNum, fn);
+		for (int i = 0; i < fn; i++)
+		{
+			if (columnMap[i] >= 0)
+				weight.col(i) = cacheWeight.col(columnMap[i]);
+		}
+		if (newFrames.size() == 0)
+			return true;
+
+		SparseMatrix L;
+		VectorX D;
+		std::vector<int> P;
+		EigenMatrixIO::read_sp_binary(fin, L);
+		EigenMatrixIO::read_binary(fin, D);
+		StlBinaryIO::readOneLevelVector(fin, P);
+		if (!fin.good() || L.rows() != tetPointsNum || D.size() != tetPointsNum || P.size() != tetPointsNum)
+			return false;
+
+		// each added frame adds e_t * e_t^T to S, so S' = S + U * U^T. By Woodbury the new columns S'^-1 * U are Z * M^-1
+		// with Z = S^-1 * U from the stored factorization and M = I + U^T * Z, and every cached column w loses Z * M^-1 * U^T * w
+		int k = newFrames.size();
+		// as SimplicialLDLT::solve, x = P^-1 * L^-T * D^-1 * L^-1 * P * b, blocked like the full solve
+		MatrixX Y(tetPointsNum, k);
+		Y.setZero();
+		for (int j = 0; j < k; j++)
+			Y(P[frameTetPoints[newFrames[j]]], j) = 1.0;
+		int blockNum = (k + HARMONIC_WEIGHT_SOLVE_BLOCK - 1) / HARMONIC_WEIGHT_SOLVE_BLOCK;
+		#pragma omp parallel for schedule(dynamic)
+		for (int b = 0; b < blockNum; b++)
+		{
+			int begin = b * HARMONIC_WEIGHT_SOLVE_BLOCK;
+			int num = std::min(HARMONIC_WEIGHT_SOLVE_BLOCK, k - begin);
+			Eigen::Ref<MatrixX> y = Y.middleCols(begin, num);
+			L.triangularView<Eigen::UnitLower>().solveInPlace(y);
+			y = D.asDiagonal().inverse() * y;
+			L.transpose().triangularView<Eigen::UnitUpper>().solveInPlace(y);
+		}
+		MatrixX Z(tetPointsNum, k);
+		for (int r = 0; r < tetPointsNum; r++)
+			Z.row(r) = Y.row(P[r]);
+
+		MatrixX M(k, k);
+		for (int i = 0; i < k; i++)
+			for (int j = 0; j < k; j++)
+				M(i, j) = Z(frameTetPoints[newFrames[i]], j) + (i == j ? 1.0 : 0.0);
+		MatrixX newWeight = M.ldlt().solve(Z.transpose()).transpose();
+
+		for (int i = 0; i < fn; i++)
+		{
+			if (columnMap[i] < 0)
+				continue;
+			VectorX uw(k);
+			for (int j = 0; j < k; j++)
+				uw.data()[j] = weight(frameTetPoints[newFrames[j]], i);
+			weight.col(i) -= newWeight * uw;
+		}
+		for (int j = 0; j < k; j++)
+			weight.col(newFrames[j]) = newWeight.col(j);
+		return true;
+	}
+
+	bool MipcModel::writeHarmonicWeightCache(const std::string filename, unsigned long long key, std::vector<int>& frameTetPoints, Eigen::SimplicialLDLT<SparseMatrix>& LDLT, MatrixX& weight)
+	{
+		std::ofstream fout(filename.c_str(), std::ios::binary);
+		if (!fout.is_open())
+			return false;
+		int tn = tetPointsNum;
+		fout.write((const char*)&key, sizeof(unsigned long long));
+		fout.write((const char*)&tn, sizeof(int));
+		StlBinaryIO::writeOneLevelVector(fout, frameTetPoints);
+		EigenMatrixIO::write_binary(fout, weight);
+
+		// the factors of S = transpose * coeffMat, for the frames added later
+		SparseMatrix L = LDLT.matrixL().nestedExpression();
+		VectorX D = LDLT.vectorD();
+		std::vector<int> P(tn);
+		for (int i = 0; i < tn; i++)
+			P[i] = LDLT.permutationP().size() == tn ? LDLT.permutationP().indices().data()[i] : i;
+		EigenMatrixIO::write_sp_binary(fout, L);
+		EigenMatrixIO::write_binary(fout, D);
+		StlBinaryIO::writeOneLevelVector(fout, P);
+		fout.close();
+		return true;
+	}
+
+	void MipcModel::computeSparseHarmonicWeight(MatrixX& weight)
+	{
+		int tn = weight.rows();
+		int fn = weight.cols();
+		std::vector<TripletX> triplet;
+		std::vector<std::pair<qeal, int>> row(fn);
+		for (int i = 0; i < tn; i++)
+		{
+			int num = 0;
+			for (int j = 0; j < fn; j++)
+			{
+				qeal w = weight.data()[j * tn + i];
+				if (IS_QEAL_ZERO(w))
+					continue;
+				row[num++] = std::pair<qeal, int>(std::abs(w), j);
+			}
+
+			qeal scale = 1.0;
+			if (weightTopK > 0 && num > weightTopK)
+			{
+				std::partial_sort(row.begin(), row.begin() + weightTopK, row.begin() + num, std::greater<std::pair<qeal, int>>());
+				num = weightTopK;
+				qeal sum = 0;
+				for (int k = 0; k < num; k++)
+					sum += weight.data()[row[k].second * tn + i];
+				if (std::abs(sum) > 1e-13)
+					scale = 1.0 / sum;
+			}
+			for (int k = 0; k < num; k++)
+				triplet.push_back(TripletX(i, row[k].second, scale * weight.data()[row[k].second * tn + i]));
+		}
+		_harmonicWeight.resize(tn, fn);
+		_harmonicWeight.setFromTriplets(triplet.begin(), triplet.end());
+	}
+
 	void MipcModel::getGlobalSparseProjectionMatrixTriplet(int rOffset, int cOffset, std::vector<TripletX>& globalTriplet)
 	{
-		assert(_matFrameId.size() == _reducedFrames.size() && _matFrameId.size() == _reducedTypes.size());
+		assert(_reducedFrames.size() == _reducedTypes.size());
 		assert(_matFrameId.size() == (_linearFramesNum + _quadFramesNum + _translaFramesNum));
 
 		size_t tn = tetPointsNum;
-		size_t rows = 3 * tn;
-		size_t cols = _reducedDim;
-
-		_reducedProjection.resize(rows, cols);
 
 		_tetPointShareFramesList.resize(tetPointsNum);
 		_tetElementShareFramesList.resize(tetElementNum);
 		_frameShareTetPointsList.resize(_reducedFrames.size());
 		_frameShareTetElementList.resize(_reducedFrames.size());
 
-		_harmonicWeight = computeHarmonicWeight();
+		MatrixX weight = computeHarmonicWeight();
+		computeSparseHarmonicWeight(weight);
 
 		for (size_t i = 0; i < tn; i++)
 		{
 			Vector3 p = getTetPoint(i);
-			int offset = 0;
-			for (size_t it = 0; it < _reducedFrames.size(); it++)
+			for (SparseWeightMatrix::InnerIterator wit(_harmonicWeight, i); wit; ++wit)
 			{
-				qeal w = _harmonicWeight.data()[it * _harmonicWeight.rows() + i];
-				if (IS_QEAL_ZERO(w))
-				{
-					offset += 12;
-					continue;
-				}
+				// the weight columns follow _matFrameId, the frame offset already counts the frames of the previous models
+				int it = wit.col();
+				qeal w = wit.value();
+				ReducedFrame* frame = getNonStaticFrame(it);
+				int offset = frame->getOffset() - cOffset;
 				_tetPointShareFramesList[i].insert(it);
 				_frameShareTetPointsList[it].insert(i);
 
@@ -328,65 +745,588 @@ namespace MIPC
 					_frameShareTetElementList[it].insert(eleId);
 				}
 
-				MatrixX u = _reducedFrames[it]->getUMatrix(p.data(), w);
-				if (_reducedTypes[it] == ReducedFrameType::LINEAR)
+				// u(a, 3 * c + a) is the c-th coefficient (x, y, z, ..., 1) of the frame for axis a, 12 columns for linear, 30 for quadratic and 3 for translation frames
+				MatrixX u = frame->getUMatrix(p.data(), w);
+				for (int k = 0; k < u.cols(); k++)
+					globalTriplet.push_back(TripletX(rOffset + 3 * i + k % 3, cOffset + offset + k, u(k % 3, k)));
+			}
+		}
+
+
+	}
+
+	void MipcModel::computeSurfaceProjection()
+	{
+		if (!isTetMeshValid())
+			return;
+		_surfaceRestPoints.resize(3 * pointsNum);
+		_surfaceFrameProjectionNum.resize(pointsNum);
+		_surfaceFrameProjectionOffset.resize(pointsNum);
+		_surfaceFrameProjectionFrame.clear();
+		_surfaceFrameProjectionCoeffNum.clear();
+		_surfaceFrameProjectionBufferOffset.clear();
+		_surfaceFrameProjectionBuffer.clear();
+		for (int i = 0; i < pointsNum; i++)
+		{
+			int offset = _surfaceFrameProjectionFrame.size();
+			Vector4i ele = getTetElement(tetMeshInterpolationIndices[i]);
+			Vector3 rest = Vector3::Zero();
+			for (int k = 0; k < 4; k++)
+			{
+				qeal b = tetMeshInterpolationWeight[4 * i + k];
+				Vector3 p = getTetPoint(ele[k]);
+				rest += b * p;
+				for (SparseWeightMatrix::InnerIterator it(_harmonicWeight, ele[k]); it; ++it)
 				{
+					ReducedFrame* frame = getNonStaticFrame(it.col());
+					MatrixX u = frame->getUMatrix(p.data(), b * it.value());
+					// the four tet points mostly share their frames, merge them into one entry
+					int j = offset;
+					while (j < _surfaceFrameProjectionFrame.size() && _surfaceFrameProjectionFrame[j] != frame->getOffset())
+						j++;
+					if (j == _surfaceFrameProjectionFrame.size())
+					{
+						_surfaceFrameProjectionFrame.push_back(frame->getOffset());
+						_surfaceFrameProjectionCoeffNum.push_back(u.cols() / 3);
+						_surfaceFrameProjectionBufferOffset.push_back(_surfaceFrameProjectionBuffer.size());
+						_surfaceFrameProjectionBuffer.resize(_surfaceFrameProjectionBuffer.size() + u.cols() / 3, 0.0);
+					}
+					qeal* coeff = _surfaceFrameProjectionBuffer.data() + _surfaceFrameProjectionBufferOffset[j];
+					for (int c = 0; c < u.cols() / 3; c++)
+						coeff[c] += u(0, 3 * c);
+				}
+			}
+			_surfaceFrameProjectionOffset[i] = offset;
+			_surfaceFrameProjectionNum[i] = _surfaceFrameProjectionFrame.size() - offset;
+			_surfaceRestPoints[3 * i] = rest[0];
+			_surfaceRestPoints[3 * i + 1] = rest[1];
+			_surfaceRestPoints[3 * i + 2] = rest[2];
+		}
+	}
+
+	void MipcModel::updateSurfaceFromReduced(const qeal* reduced)
+	{
+		if (_surfaceFrameProjectionNum.size() != pointsNum)
+			return;
+		#pragma omp parallel for
+		for (int i = 0; i < pointsNum; i++)
+		{
+			int offset = _surfaceFrameProjectionOffset[i];
+			Vector3 p = Eigen::Map<const Vector3>(_surfaceRestPoints.data() + 3 * i);
+			for (int j = offset; j < offset + _surfaceFrameProjectionNum[i]; j++)
+			{
+				int coeffNum = _surfaceFrameProjectionCoeffNum[j];
+				Eigen::Map<const MatrixX> r(reduced + _surfaceFrameProjectionFrame[j], 3, coeffNum);
+				Eigen::Map<const VectorX> u(_surfaceFrameProjectionBuffer.data() + _surfaceFrameProjectionBufferOffset[j], coeffNum);
+				p.noalias() += r * u;
+			}
+			points.buffer[3 * i] = p[0];
+			points.buffer[3 * i + 1] = p[1];
+			points.buffer[3 * i + 2] = p[2];
+		}
+	}
 
-					_reducedProjection.block(3 * i, offset, 3, 12) = u;
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 0, cOffset + offset + 0, u.data()[0]));
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 1, cOffset + offset + 1, u.data()[4]));
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 2, cOffset + offset + 2, u.data()[8]));
+	void MipcModel::getLocalProjectionMatrix(int reducedOffset, SparseProjectionMatrix& P)
+	{
+		std::vector<TripletX> triplet;
+		for (int i = 0; i < tetPointsNum; i++)
+		{
+			Vector3 p = getTetPoint(i);
+			for (SparseWeightMatrix::InnerIterator it(_harmonicWeight, i); it; ++it)
+			{
+				ReducedFrame* frame = getNonStaticFrame(it.col());
+				int offset = frame->getOffset() - reducedOffset;
+				MatrixX u = frame->getUMatrix(p.data(), it.value());
+				for (int k = 0; k < u.cols(); k++)
+					triplet.push_back(TripletX(3 * i + k % 3, offset + k, u(k % 3, k)));
+			}
+		}
+		P.resize(3 * tetPointsNum, _reducedDim);
+		P.setFromTriplets(triplet.begin(), triplet.end());
+	}
 
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 0, cOffset + offset + 3, u.data()[9]));
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 1, cOffset + offset + 4, u.data()[13]));
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 2, cOffset + offset + 5, u.data()[17]));
+	qeal MipcModel::computeElementForce(int eid, const qeal* x, qeal* force)
+	{
+		BaseTetElementParam* para = getTetMeshHandle()->getTetElementParam(eid);
+		ENuMaterial * material = downcastENuMaterial(getTetMeshHandle()->getElementMaterial(eid));
+		qeal mu = material->getMu();
+		qeal lamda = material->getLambda();
 
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 0, cOffset + offset + 6, u.data()[18]));
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 1, cOffset + offset + 7, u.data()[22]));
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 2, cOffset + offset + 8, u.data()[26]));
+		Vector4i ele = getTetElement(eid);
+		Matrix3 Ds = para->Dm;
+		for (int j = 0; j < 3; j++)
+			for (int a = 0; a < 3; a++)
+				Ds(a, j) += x[3 * ele[j] + a] - x[3 * ele[3] + a];
+		Matrix3 F = Ds * para->invDm;
+		Matrix3 FPK;
+		qeal e = stableNeoHookeanStress(F.data(), mu, lamda, FPK.data());
+		Matrix3 H = para->volume * FPK * para->invDm.transpose();
+		for (int a = 0; a < 3; a++)
+		{
+			force[a] = H(a, 0);
+			force[3 + a] = H(a, 1);
+			force[6 + a] = H(a, 2);
+			force[9 + a] = -(H(a, 0) + H(a, 1) + H(a, 2));
+		}
+		return para->volume * e;
+	}
 
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 0, cOffset + offset + 9, u.data()[27]));
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 1, cOffset + offset + 10, u.data()[31]));
-					globalTriplet.push_back(TripletX(rOffset + 3 * i + 2, cOffset + offset + 11, u.data()[35]));
+	bool MipcModel::computeElementCubature(MatrixX& poses, int reducedOffset, std::string filename)
+	{
+		if (!isTetMeshValid() || cubatureBudget <= 0)
+			return false;
+		SparseProjectionMatrix P;
+		getLocalProjectionMatrix(reducedOffset, P);
+		if (poses.rows() != _reducedDim || poses.cols() == 0)
+			generateCubaturePoses(CUBATURE_RANDOM_POSE_NUM, P, poses);
+		int sn = poses.cols();
+		int rn = _reducedDim + 1;
+		MatrixX X = P * poses;
 
-					offset += 12;
+		// the reduced force and the energy of every pose are scaled to unit size, so the small deformations weigh as much as the large ones
+		VectorX b(sn * rn);
+		VectorX forceScale(sn);
+		VectorX energyScale(sn);
+		#pragma omp parallel for
+		for (int s = 0; s < sn; s++)
+		{
+			VectorX f = VectorX::Zero(3 * tetPointsNum);
+			qeal e = 0.0;
+			qeal fe[12];
+			for (int eid = 0; eid < tetElementNum; eid++)
+			{
+				e += computeElementForce(eid, X.col(s).data(), fe);
+				Vector4i ele = getTetElement(eid);
+				for (int k = 0; k < 4; k++)
+					for (int a = 0; a < 3; a++)
+						f[3 * ele[k] + a] += fe[3 * k + a];
+			}
+			VectorX g = P.transpose() * f;
+			forceScale[s] = g.norm() > 1e-13 ? 1.0 / g.norm() : 1.0;
+			energyScale[s] = std::abs(e) > 1e-13 ? 1.0 / std::abs(e) : 1.0;
+			b.segment(s * rn, _reducedDim) = forceScale[s] * g;
+			b[s * rn + _reducedDim] = energyScale[s] * e;
+		}
+
+		std::vector<int> elements;
+		std::vector<Eigen::SparseVector<qeal>> columns;
+		MatrixX G;
+		VectorX c;
+		VectorX weights;
+		VectorX residual = b;
+		std::vector<int> candidates(tetElementNum);
+		for (int i = 0; i < tetElementNum; i++)
+			candidates[i] = i;
+		std::mt19937 generator(0);
+		while ((int)elements.size() < cubatureBudget && candidates.size() > 0 && residual.norm() > cubatureTolerance * b.norm())
+		{
+			// the first candidateNum of the shuffled candidates are scored
+			int candidateNum = std::min<int>(CUBATURE_CANDIDATE_NUM, candidates.size());
+			for (int i = 0; i < candidateNum; i++)
+			{
+				std::uniform_int_distribution<int> pick(i, candidates.size() - 1);
+				std::swap(candidates[i], candidates[pick(generator)]);
+			}
+			std::vector<qeal> score(candidateNum, 0.0);
+			#pragma omp parallel for
+			for (int i = 0; i < candidateNum; i++)
+			{
+				Eigen::SparseVector<qeal> column;
+				computeElementCubatureColumn(candidates[i], X, P, forceScale, energyScale, column);
+				qeal norm = column.norm();
+				if (norm > 0)
+					score[i] = column.dot(residual) / norm;
+			}
+			int best = std::max_element(score.begin(), score.end()) - score.begin();
+			if (score[best] <= 0)
+				break;
+			elements.push_back(candidates[best]);
+			columns.push_back(Eigen::SparseVector<qeal>());
+			computeElementCubatureColumn(candidates[best], X, P, forceScale, energyScale, columns.back());
+			candidates[best] = candidates.back();
+			candidates.pop_back();
+
+			int n = elements.size();
+			G.conservativeResize(n, n);
+			c.conservativeResize(n);
+			for (int i = 0; i < n; i++)
+			{
+				G(n - 1, i) = columns[n - 1].dot(columns[i]);
+				G(i, n - 1) = G(n - 1, i);
+			}
+			c[n - 1] = columns[n - 1].dot(b);
+			solveNonNegativeLeastSquares(G, c, weights);
+
+			// the elements left with a zero weight go back to the candidates
+			std::vector<int> keep;
+			for (int i = 0; i < n; i++)
+			{
+				if (weights[i] > 0)
+					keep.push_back(i);
+				else candidates.push_back(elements[i]);
+			}
+			if ((int)keep.size() < n)
+			{
+				MatrixX keepG(keep.size(), keep.size());
+				VectorX keepC(keep.size());
+				VectorX keepWeights(keep.size());
+				std::vector<int> keepElements(keep.size());
+				std::vector<Eigen::SparseVector<qeal>> keepColumns(keep.size());
+				for (int i = 0; i < keep.size(); i++)
+				{
+					for (int j = 0; j < keep.size(); j++)
+						keepG(i, j) = G(keep[i], keep[j]);
+					keepC[i] = c[keep[i]];
+					keepWeights[i] = weights[keep[i]];
+					keepElements[i] = elements[keep[i]];
+					keepColumns[i] = columns[keep[i]];
 				}
+				G = keepG;
+				c = keepC;
+				weights = keepWeights;
+				elements = keepElements;
+				columns = keepColumns;
 			}
+
+			residual = b;
+			for (int i = 0; i < elements.size(); i++)
+				residual -= weights[i] * columns[i];
 		}
 
+		_cubatureElements = elements;
+		_cubatureWeights.resize(elements.size());
+		for (int i = 0; i < elements.size(); i++)
+			_cubatureWeights[i] = weights[i];
+		return writeElementCubature(filename);
+	}
 
+	void MipcModel::generateCubaturePoses(int num, SparseProjectionMatrix& P, MatrixX& poses)
+	{
+		Vector3 bMin = getTetPoint(0), bMax = getTetPoint(0);
+		for (int i = 1; i < tetPointsNum; i++)
+		{
+			bMin = bMin.cwiseMin(getTetPoint(i));
+			bMax = bMax.cwiseMax(getTetPoint(i));
+		}
+		qeal amplitude = CUBATURE_POSE_AMPLITUDE * (bMax - bMin).norm();
+
+		// a reduced coordinate moves the tet points by at most its largest entry in the projection
+		VectorX scale = VectorX::Zero(_reducedDim);
+		for (int i = 0; i < P.outerSize(); i++)
+			for (SparseProjectionMatrix::InnerIterator it(P, i); it; ++it)
+				scale[it.col()] = std::max(scale[it.col()], std::abs(it.value()));
+
+		std::mt19937 generator(0);
+		std::normal_distribution<qeal> normal(0.0, 1.0);
+		std::uniform_real_distribution<qeal> magnitude(0.0, 1.0);
+		poses.resize(_reducedDim, num);
+		for (int s = 0; s < num; s++)
+		{
+			qeal m = amplitude * magnitude(generator);
+			for (int i = 0; i < _reducedDim; i++)
+				poses(i, s) = scale[i] > 0 ? m * normal(generator) / scale[i] : 0.0;
+		}
 	}
 
-	MatrixX MipcModel::getReducedProjection()
+	void MipcModel::computeElementCubatureColumn(int eid, MatrixX& X, SparseProjectionMatrix& P, VectorX& forceScale, VectorX& energyScale, Eigen::SparseVector<qeal>& column)
 	{
-		MatrixX pro;
+		int rn = _reducedDim + 1;
+		Vector4i ele = getTetElement(eid);
+		column.resize(X.cols() * rn);
+		column.setZero();
+		std::vector<std::pair<int, qeal>> entries;
+		for (int s = 0; s < X.cols(); s++)
+		{
+			qeal fe[12];
+			qeal e = computeElementForce(eid, X.col(s).data(), fe);
+			entries.clear();
+			for (int k = 0; k < 4; k++)
+				for (int a = 0; a < 3; a++)
+					for (SparseProjectionMatrix::InnerIterator it(P, 3 * ele[k] + a); it; ++it)
+						entries.push_back(std::pair<int, qeal>(it.col(), forceScale[s] * fe[3 * k + a] * it.value()));
+			std::sort(entries.begin(), entries.end());
+			for (int j = 0; j < entries.size();)
+			{
+				int col = entries[j].first;
+				qeal v = 0.0;
+				for (; j < entries.size() && entries[j].first == col; j++)
+					v += entries[j].second;
+				column.insertBack(s * rn + col) = v;
+			}
+			column.insertBack(s * rn + _reducedDim) = energyScale[s] * e;
+		}
+	}
 
-		size_t tn = tetPointsNum;
-		size_t rows = 3 * tn;
-		size_t cols = _reducedDim;
-		pro.resize(rows, cols);
-		for (size_t i = 0; i < tn; i++)
+	void MipcModel::solveNonNegativeLeastSquares(MatrixX& G, VectorX& c, VectorX& x)
+	{
+		int n = c.size();
+		x = VectorX::Zero(n);
+		if (n == 0)
+			return;
+		std::vector<bool> passive(n, false);
+		qeal eps = 1e-12 * c.cwiseAbs().maxCoeff();
+		for (int iter = 0; iter < 3 * n; iter++)
 		{
-			Vector3 p = getTetPoint(i);
-			int offset = 0;
-			for (size_t it = 0; it < _reducedFrames.size(); it++)
+			VectorX w = c - G * x;
+			int next = -1;
+			qeal maxW = eps;
+			for (int i = 0; i < n; i++)
 			{
-				qeal w = _harmonicWeight.data()[it * _harmonicWeight.rows() + i];
-				if (IS_QEAL_ZERO(w))
-				{
-					offset += 12;
+				if (passive[i] || w[i] <= maxW)
 					continue;
+				maxW = w[i];
+				next = i;
+			}
+			if (next < 0)
+				break;
+			passive[next] = true;
+
+			while (true)
+			{
+				std::vector<int> ids;
+				for (int i = 0; i < n; i++)
+					if (passive[i])
+						ids.push_back(i);
+				int m = ids.size();
+				if (m == 0)
+					break;
+				MatrixX Gp(m, m);
+				VectorX cp(m);
+				for (int i = 0; i < m; i++)
+				{
+					for (int j = 0; j < m; j++)
+						Gp(i, j) = G(ids[i], ids[j]);
+					cp[i] = c[ids[i]];
+				}
+				VectorX z = Gp.ldlt().solve(cp);
+
+				// step towards z until the first weight hits zero, which leaves the passive set
+				qeal alpha = 1.0;
+				int blocking = -1;
+				for (int i = 0; i < m; i++)
+				{
+					if (z[i] > 0)
+						continue;
+					qeal a = x[ids[i]] > 0 ? x[ids[i]] / (x[ids[i]] - z[i]) : 0.0;
+					if (blocking < 0 || a < alpha)
+					{
+						alpha = a;
+						blocking = i;
+					}
 				}
-				MatrixX u = _reducedFrames[it]->getUMatrix(p.data(), w);
-				if (_reducedTypes[it] == ReducedFrameType::LINEAR)
+				if (blocking < 0)
 				{
-					pro.block(3 * i, offset, 3, 12) = u;
-					offset += 12;
+					for (int i = 0; i < m; i++)
+						x[ids[i]] = z[i];
+					break;
+				}
+				for (int i = 0; i < m; i++)
+				{
+					x[ids[i]] += alpha * (z[i] - x[ids[i]]);
+					if (i == blocking || x[ids[i]] <= 0)
+					{
+						x[ids[i]] = 0.0;
+						passive[ids[i]] = false;
+					}
 				}
 			}
 		}
+	}
+
+	bool MipcModel::readElementCubature(std::string filename)
+	{
+		std::ifstream fin(filename.c_str());
+		if (!fin.is_open())
+			return false;
+		std::vector<int> key;
+		std::vector<qeal> material;
+		getElasticCacheKey(key, material);
+		int keyNum, materialNum;
+		fin >> keyNum >> materialNum;
+		if (fin.fail() || keyNum != (int)key.size() || materialNum != (int)material.size())
+			return false;
+		for (int i = 0; i < keyNum; i++)
+		{
+			int k;
+			fin >> k;
+			if (fin.fail() || k != key[i])
+				return false;
+		}
+		for (int i = 0; i < materialNum; i++)
+		{
+			qeal m;
+			fin >> m;
+			if (fin.fail() || m != material[i])
+				return false;
+		}
+		int num;
+		fin >> num;
+		if (fin.fail() || num < 0 || num > tetElementNum)
+			return false;
+		std::vector<int> elements(num);
+		std::vector<qeal> weights(num);
+		for (int i = 0; i < num; i++)
+		{
+			fin >> elements[i] >> weights[i];
+			if (fin.fail() || elements[i] < 0 || elements[i] >= tetElementNum)
+				return false;
+		}
+		_cubatureElements = elements;
+		_cubatureWeights = weights;
+		return true;
+	}
 
-		return pro;
+	bool MipcModel::writeElementCubature(std::string filename)
+	{
+		std::ofstream fout(filename.c_str());
+		if (!fout.is_open())
+			return false;
+		std::vector<int> key;
+		std::vector<qeal> material;
+		getElasticCacheKey(key, material);
+		fout << key.size() << " " << material.size() << std::endl;
+		for (size_t i = 0; i < key.size(); i++)
+			fout << key[i] << std::endl;
+		// the material is compared exactly, so it is written at full precision
+		fout.precision(17);
+		for (size_t i = 0; i < material.size(); i++)
+			fout << material[i] << std::endl;
+		fout << _cubatureElements.size() << std::endl;
+		for (size_t i = 0; i < _cubatureElements.size(); i++)
+			fout << _cubatureElements[i] << " " << _cubatureWeights[i] << std::endl;
+		fout.close();
+		return true;
+	}
+
+	bool MipcModel::computeStVKPolynomial(int reducedOffset, std::string filename)
+	{
+		int r = _reducedDim;
+		if (!isTetMeshValid() || r == 0 || r > STVK_POLYNOMIAL_MAX_DIM)
+			return false;
+		SparseProjectionMatrix sP;
+		getLocalProjectionMatrix(reducedOffset, sP);
+		MatrixX P = sP;
+
+		_stvkK = MatrixX::Zero(r, r);
+		_stvkV = MatrixX::Zero(r, r * r);
+		_stvkW = MatrixX::Zero(r * r, r * r);
+		// per element the columns s * L_ab, s * vec(N_ab) with Q_ab = q^T * N_ab * q / 2 for the nine ab and the traces,
+		// s^2 = vol * mu / 4 or vol * lambda / 8, so K += 8 * L * L^T, V += 4 * L * N^T and W += N * N^T
+		for (int begin = 0; begin < tetElementNum; begin += STVK_POLYNOMIAL_BATCH)
+		{
+			int num = std::min(STVK_POLYNOMIAL_BATCH, tetElementNum - begin);
+			MatrixX L(r, 10 * num);
+			MatrixX N(r * r, 10 * num);
+			#pragma omp parallel for
+			for (int k = 0; k < num; k++)
+			{
+				int eid = begin + k;
+				BaseTetElementParam* para = getTetMeshHandle()->getTetElementParam(eid);
+				ENuMaterial * material = downcastENuMaterial(getTetMeshHandle()->getElementMaterial(eid));
+				qeal sMu = sqrt(para->volume * material->getMu() / 4.0);
+				qeal sLamda = sqrt(para->volume * material->getLambda() / 8.0);
+
+				// row c + 3 * a is G(c, a) over q, G = (Ds - Dm) * invDm
+				Vector4i ele = getTetElement(eid);
+				MatrixX m = MatrixX::Zero(9, r);
+				for (int a = 0; a < 3; a++)
+					for (int c = 0; c < 3; c++)
+						for (int j = 0; j < 3; j++)
+							m.row(c + 3 * a) += para->invDm(j, a) * (P.row(3 * ele[j] + c) - P.row(3 * ele[3] + c));
+
+				VectorX lTr = VectorX::Zero(r);
+				VectorX nTr = VectorX::Zero(r * r);
+				for (int b = 0; b < 3; b++)
+					for (int a = 0; a < 3; a++)
+					{
+						VectorX l = 0.5 * (m.row(a + 3 * b) + m.row(b + 3 * a)).transpose();
+						MatrixX Nab = MatrixX::Zero(r, r);
+						for (int c = 0; c < 3; c++)
+							Nab += m.row(c + 3 * a).transpose() * m.row(c + 3 * b);
+						Nab = (0.5 * (Nab + Nab.transpose())).eval();
+						Eigen::Map<VectorX> n(Nab.data(), r * r);
+						L.col(10 * k + a + 3 * b) = sMu * l;
+						N.col(10 * k + a + 3 * b) = sMu * n;
+						if (a == b)
+						{
+							lTr += l;
+							nTr += n;
+						}
+					}
+				L.col(10 * k + 9) = sLamda * lTr;
+				N.col(10 * k + 9) = sLamda * nTr;
+			}
+			_stvkK.noalias() += 8.0 * L * L.transpose();
+			_stvkV.noalias() += 4.0 * L * N.transpose();
+			_stvkW.selfadjointView<Eigen::Lower>().rankUpdate(N);
+		}
+		_stvkW.triangularView<Eigen::StrictlyUpper>() = _stvkW.transpose();
+
+		writeStVKPolynomial(filename);
+		return true;
+	}
+
+	void MipcModel::getElasticCacheKey(std::vector<int>& key, std::vector<qeal>& material)
+	{
+		key = { tetPointsNum, tetElementNum, _linearFramesNum, _quadFramesNum, _translaFramesNum, weightTopK };
+		key.insert(key.end(), _matFrameId.begin(), _matFrameId.end());
+		// a moved rest point, fixed point or binding changes the basis with the same sizes
+		unsigned long long restKey = computeRestStateKey();
+		key.push_back((int)(restKey & 0xffffffffULL));
+		key.push_back((int)(restKey >> 32));
+		// the polynomial sums every element with its own material
+		material.resize(2 * tetElementNum);
+		for (int eid = 0; eid < tetElementNum; eid++)
+		{
+			ENuMaterial * m = downcastENuMaterial(getTetMeshHandle()->getElementMaterial(eid));
+			material[2 * eid] = m->getMu();
+			material[2 * eid + 1] = m->getLambda();
+		}
+	}
+
+	bool MipcModel::readStVKPolynomial(std::string filename)
+	{
+		std::ifstream fin(filename.c_str(), std::ios::binary);
+		if (!fin.is_open())
+			return false;
+		std::vector<int> key;
+		std::vector<qeal> material;
+		getElasticCacheKey(key, material);
+		std::vector<int> cacheKey;
+		std::vector<qeal> cacheMaterial;
+		StlBinaryIO::readOneLevelVector(fin, cacheKey);
+		StlBinaryIO::readOneLevelVector(fin, cacheMaterial);
+		if (!fin.good() || cacheKey != key || cacheMaterial != material)
+			return false;
+
+		MatrixX K, V, W;
+		EigenMatrixIO::read_binary(fin, K);
+		EigenMatrixIO::read_binary(fin, V);
+		EigenMatrixIO::read_binary(fin, W);
+		int r = _reducedDim;
+		if (!fin.good() || K.rows() != r || V.cols() != r * r || W.rows() != r * r)
+			return false;
+		_stvkK = K;
+		_stvkV = V;
+		_stvkW = W;
+		return true;
+	}
+
+	bool MipcModel::writeStVKPolynomial(std::string filename)
+	{
+		std::ofstream fout(filename.c_str(), std::ios::binary);
+		if (!fout.is_open())
+			return false;
+		std::vector<int> key;
+		std::vector<qeal> material;
+		getElasticCacheKey(key, material);
+		StlBinaryIO::writeOneLevelVector(fout, key);
+		StlBinaryIO::writeOneLevelVector(fout, material);
+		EigenMatrixIO::write_binary(fout, _stvkK);
+		EigenMatrixIO::write_binary(fout, _stvkV);
+		EigenMatrixIO::write_binary(fout, _stvkW);
+		fout.close();
+		return true;
 	}
 
 }
\ No newline at end of file
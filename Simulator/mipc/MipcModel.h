@@ -3,10 +3,30 @@
 #define Mipc_MODEL_H
 #include "Simulator\FiniteElementMethod\FemModel.h"
 #include "Simulator\FiniteElementMethod\Reduced\ReducedFrame.h"
+#include "Commom\FileIO.h"
+#include "Commom\EigenMatrixIO.h"
+#include <map>
+#include <random>
 
 
 namespace MIPC
 {
+	// frame columns per multi-rhs solve of the harmonic weights
+#define HARMONIC_WEIGHT_SOLVE_BLOCK 16
+	// random elements scored per pick of the cubature training
+#define CUBATURE_CANDIDATE_NUM 1024
+	// poses generated when the model has no cubature_poses.dat, their displacements reach about the amplitude times the model size
+#define CUBATURE_RANDOM_POSE_NUM 32
+#define CUBATURE_POSE_AMPLITUDE 0.05
+	// bend and twist samples generated when the model has no frame_samples.dat, the angle is reached across the model size
+#define FRAME_RANDOM_SAMPLE_NUM 16
+#define FRAME_SAMPLE_ANGLE 0.5
+	// the reduced stvk polynomial keeps reducedDim^4 coefficients, larger models stay on the elements: W is reducedDim^2 x reducedDim^2,
+	// at 64 that is 16.8M doubles (128 MB) per model on the host and again on the device
+#define STVK_POLYNOMIAL_MAX_DIM 64
+	// elements per rank update of the stvk coefficients
+#define STVK_POLYNOMIAL_BATCH 64
+
 	using namespace FiniteElementMethod;
 	class MipcModel : public FemModel
 	{
@@ -15,7 +35,13 @@ namespace MIPC
 			DENSE = 0,
 			SPARSE = 1
 		} ReducedType;
-		MipcModel(ReducedType type = DENSE) :_type(type), _linearFramesNum(0), _quadFramesNum(0), _reducedDim(0), setWeightLocality(false), weightLocalityThreshold(0) {}
+		typedef enum {
+			STABLE_NEO_HOOKEAN = 0,
+			STVK = 1
+		} ElasticMaterial;
+		typedef Eigen::SparseMatrix<qeal, Eigen::RowMajor> SparseWeightMatrix;
+		typedef Eigen::SparseMatrix<qeal, Eigen::RowMajor> SparseProjectionMatrix;
+		MipcModel(ReducedType type = DENSE) :_type(type), _linearFramesNum(0), _quadFramesNum(0), _reducedDim(0), setWeightLocality(false), weightLocalityThreshold(0), weightTopK(0), linearFrameBudget(0), quadFrameBudget(0), cubatureBudget(0), cubatureTolerance(0.01), elasticMaterial(STABLE_NEO_HOOKEAN) {}
 
 		ReducedType getReducedType() { return _type; }
 		int getNonStaticFramesNum() { return _matFrameId.size(); }
@@ -28,9 +54,23 @@ namespace MIPC
 		int getNonStaticFrameMedialId(int id) { return _matFrameId[id]; }
 		ReducedFrame* getReducedFrame(int id) { return _reducedFrames[id]; }
 		ReducedFrameType getReducedFrameType(int id) { return _reducedTypes[id]; }
+		// id-th column of the weights, _reducedFrames and _reducedTypes are indexed by medial point
+		ReducedFrame* getNonStaticFrame(int id) { return _reducedFrames[_matFrameId[id]]; }
 
+		// frames.dofs starts with the linear, quadratic and translation counts, older files only have the first two
 		virtual bool readFrameMatList(std::string filename);
 		virtual bool writeFrameMatList(std::string filename);
+		// only fills _reducedTypes, _matFrameId and the frame counts like readFrameMatList, the frames are made by createReducedFrame
+		void setFrameList(std::vector<int>& linearList, std::vector<int>& quadList);
+		// picks linearNum + quadNum frames among the medial points and writes them to filename (frames.dofs):
+		// farthest point sampling seeds half of the budget, each further frame goes to the medial point whose binded tet point the current
+		// frames fit worst over the sample displacements (3 * tetPointsNum x samples, generateFrameSamples if there are none),
+		// at last the quadNum frames carrying the most fitting error become quadratic
+		virtual bool selectFrames(int linearNum, int quadNum, MatrixX& samples, std::string filename);
+		// random bends and twists of the rest pose, each about a random medial point, which affine frames cannot fit exactly
+		virtual void generateFrameSamples(int num, MatrixX& samples);
+		// squared error per tet point of the least squares fit of the samples by linear frames with these weights
+		virtual VectorX computeFrameFittingError(MatrixX& weight, MatrixX& samples);
 
 		void createReducedFrame(int& frameOffset, int& bufferOffset, qeal* X, qeal* preX, qeal* Xtilde, qeal* Vel, qeal* preVel, qeal* Acc, qeal* preAcc, std::vector<ReducedFrame*>& frameList);
 
@@ -39,14 +79,67 @@ namespace MIPC
 
 		virtual void computeLaplacianMatrix(std::vector<TripletX>& matValue);
 		virtual MatrixX computeHarmonicWeight();
+		// the weights are kept in dir + "harmonic_weight.cache" together with the factorization they were solved with,
+		// the key hashes the laplacian of the tet mesh and the fixed tet points, the columns are matched to the frames by their binded tet point
+		unsigned long long computeHarmonicWeightKey(std::vector<TripletX>& laplacian, std::vector<int>& fixedTetPoints);
+		// hashes the rest tet points, the tet elements, the fixed tet points and the tet point every frame is binded to,
+		// the caches derived from the weights are keyed with it
+		unsigned long long computeRestStateKey();
+		bool readHarmonicWeightCache(const std::string filename, unsigned long long key, std::vector<int>& frameTetPoints, MatrixX& weight);
+		bool writeHarmonicWeightCache(const std::string filename, unsigned long long key, std::vector<int>& frameTetPoints, Eigen::SimplicialLDLT<SparseMatrix>& LDLT, MatrixX& weight);
+
+		// keeps the nonzero weights of every tet point, only the weightTopK largest ones renormalized to sum to one if weightTopK > 0
+		virtual void computeSparseHarmonicWeight(MatrixX& weight);
 
 		virtual void getGlobalSparseProjectionMatrixTriplet(int rOffset, int cOffset, std::vector<TripletX>& triplet);
-		MatrixX getReducedProjection();
+
+		// surface points = rest + S * reduced, S is the barycentric interpolation in the tet mesh composed with the skinning weights,
+		// stored as the coefficients of the frame (w * x, w * y, w * z, w for linear frames) per (surface point, frame) like the tet point projection
+		virtual void computeSurfaceProjection();
+		virtual void updateSurfaceFromReduced(const qeal* reduced);
+
+		// 3 * tetPointsNum x reducedDim projection of the model alone, reducedOffset is the global offset of its first reduced coordinate
+		void getLocalProjectionMatrix(int reducedOffset, SparseProjectionMatrix& P);
+		// elastic force (the gradient of the stable neo-hookean energy, in the layout of the gpu element force) and energy of one element
+		// at the tet point displacements x of the model
+		qeal computeElementForce(int eid, const qeal* x, qeal* force);
+		// picks at most cubatureBudget elements with nonnegative weights whose weighted U_e^T * f_e and energy match the sum over all elements
+		// at the poses (reducedDim x poses, random ones if there are none) to cubatureTolerance: every pick is the best of CUBATURE_CANDIDATE_NUM
+		// random elements against the residual, then the weights are solved again by nonnegative least squares, written to filename
+		virtual bool computeElementCubature(MatrixX& poses, int reducedOffset, std::string filename);
+		virtual void generateCubaturePoses(int num, SparseProjectionMatrix& P, MatrixX& poses);
+		// U_e^T * f_e of every pose followed by the element energy, each pose scaled like the full force and energy
+		void computeElementCubatureColumn(int eid, MatrixX& X, SparseProjectionMatrix& P, VectorX& forceScale, VectorX& energyScale, Eigen::SparseVector<qeal>& column);
+		// lawson-hanson on the normal equations G * x = c
+		static void solveNonNegativeLeastSquares(MatrixX& G, VectorX& c, VectorX& x);
+		// the cubature is only read back with the key of getElasticCacheKey it was trained with
+		bool readElementCubature(std::string filename);
+		bool writeElementCubature(std::string filename);
+
+		// the stvk energy of the model is 1/2 * q^T * K * q + q^T * V * y + y^T * W * y with y = vec(q * q^T), exactly as the sum over the elements:
+		// every element adds its strain terms L = sym(G) and Q = G^T * G / 2 of the displacement gradient G over q as rank updates,
+		// false if the reduced dimension exceeds STVK_POLYNOMIAL_MAX_DIM, otherwise written to filename (stvk_polynomial.cache)
+		virtual bool computeStVKPolynomial(int reducedOffset, std::string filename);
+		// the cache is only read back for the tet mesh, frames and material it was computed with
+		bool readStVKPolynomial(std::string filename);
+		bool writeStVKPolynomial(std::string filename);
+		// mesh and frame sizes and the rest state key in key, mu and lambda of every element in material,
+		// shared by the stvk polynomial and the cubature caches
+		void getElasticCacheKey(std::vector<int>& key, std::vector<qeal>& material);
+		bool hasStVKPolynomial() { return _stvkK.size() > 0; }
 
 
 		friend class MipcSimulator;
 		bool setWeightLocality;
 		qeal weightLocalityThreshold;
+		int weightTopK;
+		// frames.dofs is generated by selectFrames with this budget when it is missing
+		int linearFrameBudget;
+		int quadFrameBudget;
+		// the elastic forces are evaluated on the cubature elements if cubatureBudget > 0
+		int cubatureBudget;
+		qeal cubatureTolerance;
+		ElasticMaterial elasticMaterial;
 	
 	//protected:
 		ReducedType _type;
@@ -60,10 +153,27 @@ namespace MIPC
 		std::vector<std::set<int>> _tetElementShareFramesList;
 		std::vector<std::set<int>> _frameShareTetPointsList;
 		std::vector<std::set<int>> _frameShareTetElementList;
-		MatrixX _reducedProjection;
 
-		MatrixX _harmonicWeight;
+		// tet points x frames, a handful of frames per row
+		SparseWeightMatrix _harmonicWeight;
+		// read from fixed_tet_points.txt by computeHarmonicWeight
+		std::vector<int> _fixedTetPoints;
 		SparseMatrix _reducedSpProjection;
+
+		std::vector<qeal> _surfaceRestPoints;
+		std::vector<int> _surfaceFrameProjectionNum;
+		std::vector<int> _surfaceFrameProjectionOffset;
+		std::vector<int> _surfaceFrameProjectionFrame;
+		std::vector<int> _surfaceFrameProjectionCoeffNum;
+		std::vector<int> _surfaceFrameProjectionBufferOffset;
+		std::vector<qeal> _surfaceFrameProjectionBuffer;
+
+		std::vector<int> _cubatureElements;
+		std::vector<qeal> _cubatureWeights;
+
+		MatrixX _stvkK;
+		MatrixX _stvkV;
+		MatrixX _stvkW;
 	};
 
 
@@ -15,6 +15,11 @@ bool  MIPC::MipcSimulator::addModelFromConfigFile(const std::string filename, Ti
 	int enableGravity = 1;
 	bool locality = false;
 	qeal localityThreshold = 0.0;
+	int weightTopK = 0;
+	int linearFrameBudget = 0, quadFrameBudget = 0;
+	int cubatureBudget = 0;
+	qeal cubatureTolerance = 0.01;
+	std::string elasticMaterial;
 	TiXmlElement* childItem = item->FirstChildElement();
 	std::strstream ss;
 	while (childItem)
@@ -70,6 +75,30 @@ bool  MIPC::MipcSimulator::addModelFromConfigFile(const std::string filename, Ti
 			ss >> localityThreshold;
 			if (localityThreshold != 0.0) locality = true;
 		}
+		else if (itemName == std::string("frameBudget"))
+		{
+			std::string str = childItem->GetText();
+			ss << str;
+			ss >> linearFrameBudget >> quadFrameBudget;
+		}
+		else if (itemName == std::string("weightTopK"))
+		{
+			std::string str = childItem->GetText();
+			ss << str;
+			ss >> weightTopK;
+		}
+		else if (itemName == std::string("cubature"))
+		{
+			std::string str = childItem->GetText();
+			ss << str;
+			ss >> cubatureBudget >> cubatureTolerance;
+		}
+		else if (itemName == std::string("material"))
+		{
+			std::string str = childItem->GetText();
+			ss << str;
+			ss >> elasticMaterial;
+		}
 
 		childItem = childItem->NextSiblingElement();
 	}
@@ -79,6 +108,12 @@ bool  MIPC::MipcSimulator::addModelFromConfigFile(const std::string filename, Ti
 	m->enableGravityForce(enableGravity);
 	m->setWeightLocality = locality;
 	m->weightLocalityThreshold = localityThreshold;
+	m->weightTopK = weightTopK;
+	m->linearFrameBudget = linearFrameBudget;
+	m->quadFrameBudget = quadFrameBudget;
+	m->cubatureBudget = cubatureBudget;
+	m->cubatureTolerance = cubatureTolerance;
+	m->elasticMaterial = elasticMaterial == std::string("StVK") ? MipcModel::STVK : MipcModel::STABLE_NEO_HOOKEAN;
 	m->initMeshesHandel();
 	ENuMaterial * material = downcastENuMaterial(m->getTetMeshHandle()->getElementMaterialById(0));
 	material->setDensity(density);
@@ -87,6 +122,56 @@ bool  MIPC::MipcSimulator::addModelFromConfigFile(const std::string filename, Ti
 	return true;
 }
 
+// the first value of the text of item
+template<typename T>
+static T readItemValue(TiXmlElement* item)
+{
+	std::strstream ss;
+	ss << item->GetText();
+	T value = T();
+	ss >> value;
+	return value;
+}
+
+void MIPC::MipcSimulator::readExtraAttributeFromConfigFile(TiXmlElement * item)
+{
+	if (!item)
+		return;
+	std::string itemName = item->Value();
+	if (itemName == std::string("ParallelAssembly"))
+		_parallelAssembly = readItemValue<int>(item) != 0;
+	else if (itemName == std::string("WarmStartDistance"))
+		_warmStartDistance = readItemValue<int>(item) != 0;
+	else if (itemName == std::string("MotionBudgetFilter"))
+		_motionBudgetFilter = readItemValue<int>(item) != 0;
+	else if (itemName == std::string("SelfExclusionRing"))
+		_selfExclusionRing = readItemValue<int>(item);
+	else if (itemName == std::string("SelfExclusionRestDistance"))
+		_selfExclusionRestDistance = readItemValue<qeal>(item);
+	else if (itemName == std::string("ModelCulling"))
+		_modelCulling = readItemValue<int>(item) != 0;
+	else if (itemName == std::string("HotColdEvents"))
+		_hotColdEvents = readItemValue<int>(item) != 0;
+	else if (itemName == std::string("HotColdMotionScale"))
+		_hotColdMotionScale = readItemValue<qeal>(item);
+	else if (itemName == std::string("HostCCD"))
+		_hostCCD = readItemValue<int>(item) != 0;
+	else if (itemName == std::string("HostProjection"))
+		_hostProjection = readItemValue<int>(item) != 0;
+	else if (itemName == std::string("SurfaceSkinning"))
+		_surfaceSkinning = readItemValue<int>(item) != 0;
+	else if (itemName == std::string("HostCCDLowerBound"))
+		_hostCCDLowerBound = readItemValue<qeal>(item);
+	else if (itemName == std::string("CCDType"))
+		_ccdType = (CCDType)readItemValue<int>(item);
+	else if (itemName == std::string("ACCDGap"))
+		_accdGap = readItemValue<qeal>(item);
+	else if (itemName == std::string("StaticBVHFile"))
+		_staticBVHFilename = readItemValue<std::string>(item);
+	else if (itemName == std::string("BroadPhase"))
+		_broadPhase = (BroadPhaseType)readItemValue<int>(item);
+}
+
 void MIPC::MipcSimulator::doTimeGpuDenseSystem(int frame)
 {
 	int newton_iter = 0;
@@ -96,18 +181,6 @@ void MIPC::MipcSimulator::doTimeGpuDenseSystem(int frame)
 	cudaMemcpy(_devReducedXn, _devReducedX, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToDevice);
 	cudaMemcpy(_devReducedVn, _devReducedVelocity, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToDevice);
 
-	// compute fullspace/reduced external force
-	cudaMemcpy(_devExternalForce, _sysGravityForce.data(), _sysGravityForce.size() * sizeof(qeal), cudaMemcpyHostToDevice);
-
-	for (int mid = 0; mid < models.size(); mid++)
-	{
-		for (int idx = 0; idx < 3; idx++)
-		{
-			cublasDgemv(blasHandle, CUBLAS_OP_T, _hostTetPointProjectionRowsXYZ[mid], _hostTetPointProjectionColsXYZ[mid], &cublas_pos_one, _devTetPointProjectionXYZ[mid], _hostTetPointProjectionRowsXYZ[mid], _devExternalForce + _hostTetPointXOffset[mid] + idx, 3, &cublas_zero, _devReducedExternalForce + _hostFrameBufferOffset[mid] + idx, 3);
-			cudaDeviceSynchronize();
-		}
-	}
-
 	// compute predictive pos
 	updatePredictivePos
 	(
@@ -118,13 +191,12 @@ void MIPC::MipcSimulator::doTimeGpuDenseSystem(int frame)
 		_devTimeStep,
 		_devReducedXtilde
 	);
-	for (int mid = 0; mid < models.size(); mid++)
+	projectToFullspaceGpu(_devReducedXtilde, _devSysXtilde);
+
+	if (_hotColdEvents)
 	{
-		for (int idx = 0; idx < 3; idx++)
-		{
-			cublasDgemv(blasHandle, CUBLAS_OP_N, _hostTetPointProjectionRowsXYZ[mid], _hostTetPointProjectionColsXYZ[mid], &cublas_pos_one, _devTetPointProjectionXYZ[mid], _hostTetPointProjectionRowsXYZ[mid], _devReducedXtilde + _hostFrameBufferOffset[mid] + idx, 3, &cublas_zero, _devSysXtilde + _hostTetPointXOffset[mid] + idx, 3);
-			cudaDeviceSynchronize();
-		}
+		cudaMemcpy(_sysReducedXtilde.data(), _devReducedXtilde, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToHost);
+		splitHotColdCollisionEvents();
 	}
 
 	constructConstraintSet(_kappa, true);
@@ -135,11 +207,8 @@ void MIPC::MipcSimulator::doTimeGpuDenseSystem(int frame)
 	{
 		computeElasticsHessianAndGradient(_sysReducedRhs.data(), _sysReducedMatrix.data());
 
-		for (int i = 0; i < _activeCollisionEvents.size(); i++)
-			_activeCollisionEvents[i]->getGradientAndHessian(_kappa, _sysReducedRhs, _sysReducedMatrix);
-
-		for (int i = 0; i < _frictionCollisionEvents.size(); i++)
-			_frictionCollisionEvents[i]->getFrictionGradientAndHessian(_kappa, _sysReducedRhs, _sysReducedMatrix);
+		assembleCollisionGradientAndHessian(_activeCollisionEvents, false, _sysReducedRhs, _sysReducedMatrix);
+		assembleCollisionGradientAndHessian(_frictionCollisionEvents, true, _sysReducedRhs, _sysReducedMatrix);
 
 		// solve
 		cudaMemcpy(_devReducedMatrix, _sysReducedMatrix.data(), _sysReducedDim * _sysReducedDim * sizeof(qeal), cudaMemcpyHostToDevice);
@@ -147,15 +216,158 @@ void MIPC::MipcSimulator::doTimeGpuDenseSystem(int frame)
 		computeSystemUsingCusolverDenseChol(_devReducedMatrix, _devReducedRhs, _devReducedDir, _sysReducedDim);
 		cudaMemcpy(_sysReducedDir.data(), _devReducedDir, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToHost);
 
-		for (int mid = 0; mid < models.size(); mid++)
+		if (_hostProjection)
+			projectToFullspaceHost(_sysReducedDir.data(), _sysDir.data());
+		else
+		{
+			projectToFullspaceGpu(_devReducedDir, _devDir);
+			cudaMemcpy(_sysDir.data(), _devDir, _sysDim * sizeof(qeal), cudaMemcpyDeviceToHost);
+		}
+
+		qeal res = _sysDir.cwiseAbs().maxCoeff() / dt;	
+		if (newton_iter > 0 && res <= tol)
+		{
+			std::cout << "Frame " << frame << " converges to " << res << " after " << newton_iter <<" iters."<< std::endl;
+			break;
+		}
+
+		// line search, the medial points are transformed on the device with their moving dir so nothing is uploaded
+		for (int type = ReducedFrameType::LINEAR; type <= ReducedFrameType::Translation; type++)
+		{
+			int begin = _hostFrameBatchOffset[type - 1];
+			int num = _hostFrameBatchOffset[type] - begin;
+			if (num == 0)
+				continue;
+			transformReducedFrames
+			(
+				num,
+				type,
+				_devFrameBatchPointId + begin,
+				_devFrameBatchReducedOffset + begin,
+				_devFrameBatchRestPosition + 3 * begin,
+				_devReducedX,
+				_devReducedDir,
+				_devMedialPointPosition,
+				_devMedialPointMovingDir
+			);
+		}
+
+		// the broad phase and the host ccd take the moving dir from the reduced dir already on the host
+		if (_broadPhase != ALL_PAIRS || _hostCCD || _ccdType == ADDITIVE_CCD)
+			computeMedialPointsMovingDirHost(_sysReducedDir.data());
+		if (_broadPhase != ALL_PAIRS)
+			updateBroadPhaseCollisionEvents(_hostMedialPointMovingDir.data());
+
+		qeal toi = 1.0;	
+		getToI(toi);
+
+		qeal E; 	
+		cudaMemcpy(_devSearchReducedX, _devReducedX, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToDevice);
+		do
 		{
-			for (int idx = 0; idx < 3; idx++)
+			updateLineSearchX
+			(
+				_sysReducedDim,
+				_devReducedDim,
+				_devSearchReducedX,
+				_devReducedDir,
+				toi,
+				_devReducedX
+			);
+			cudaMemcpy(_sysReducedX.data(), _devReducedX, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToHost);
+
+			if (_hostProjection)
 			{
-				cublasDgemv(blasHandle, CUBLAS_OP_N, _hostTetPointProjectionRowsXYZ[mid], _hostTetPointProjectionColsXYZ[mid], &cublas_pos_one, _devTetPointProjectionXYZ[mid], _hostTetPointProjectionRowsXYZ[mid], _devReducedDir + _hostFrameBufferOffset[mid] + idx, 3, &cublas_zero, _devDir + _hostTetPointXOffset[mid] + idx, 3);
-				cudaDeviceSynchronize();
+				projectToFullspaceHost(_sysReducedX.data(), _sysX.data());
+				CUDA_CALL(cudaMemcpy(_devSysX, _sysX.data(), _sysDim * sizeof(qeal), cudaMemcpyHostToDevice));
 			}
+			else
+				projectToFullspaceGpu(_devReducedX, _devSysX);
+			constructConstraintSet(_kappa, false);
+			E = computeEnergy(_devSysX, _devSysXtilde);
+			toi *= 0.5;
+		} while ((E - Ep) > MIN_VALUE);
+		Ep = E;
+
+	} while (++newton_iter);
+
+
+	updatedVelocity
+	(
+		_sysReducedDim,
+		_devReducedDim,
+		_devReducedX,
+		_devReducedXtilde,
+		_devTimeStep,
+		_devReducedVelocity
+	);
+
+	projectToFullspaceGpu(_devReducedVelocity, _devSysVelocity);
+	// with surface skinning _sysX is only rebuilt on demand by reconstructTetPoints
+	if (_surfaceSkinning)
+		return;
+	// with host projection _sysX already holds the last line search trial
+	if (!_hostProjection)
+		cudaMemcpy(_sysX.data(), _devSysX, _sysDim * sizeof(qeal), cudaMemcpyDeviceToHost);
+
+}
+
+void MIPC::MipcSimulator::doTimeGpuSparseSystem(int frame)
+{
+	int newton_iter = 0;
+	qeal dt = _timeStep;
+
+	cudaMemcpy(_devSysXn, _devSysX, _sysDim * sizeof(qeal), cudaMemcpyDeviceToDevice);
+	cudaMemcpy(_devReducedXn, _devReducedX, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToDevice);
+	cudaMemcpy(_devReducedVn, _devReducedVelocity, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToDevice);
+
+	// compute predictive pos
+	updatePredictivePos
+	(
+		_sysReducedDim,
+		_devReducedDim,
+		_devReducedXn,
+		_devReducedVelocity,
+		_devTimeStep,
+		_devReducedXtilde
+	);
+	projectToFullspaceGpu(_devReducedXtilde, _devSysXtilde);
+
+	if (_hotColdEvents)
+	{
+		cudaMemcpy(_sysReducedXtilde.data(), _devReducedXtilde, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToHost);
+		splitHotColdCollisionEvents();
+	}
+
+	constructConstraintSet(_kappa, true);
+	
+	qeal Ep = computeEnergy(_devSysX, _devSysXtilde);
+	// compute ipc constraint set
+	do
+	{
+		// M + dt^2 K is written straight into _devReducedSparseSysMatrixCsrVal
+		computeElasticsHessianAndGradient(_sysReducedRhs.data(), nullptr);
+
+		// the collision & friction hessian is scattered into its own csr values and added on the device
+		std::fill(_hostReducedSparseCFHessinaCsrVal.begin(), _hostReducedSparseCFHessinaCsrVal.end(), 0.0);
+		assembleCollisionGradientAndHessian(_activeCollisionEvents, false, _sysReducedRhs, _hostReducedSparseCFHessinaCsrVal);
+		assembleCollisionGradientAndHessian(_frictionCollisionEvents, true, _sysReducedRhs, _hostReducedSparseCFHessinaCsrVal);
+
+		// solve
+		int nnz = _hostReducedSparseSysMatrixCsrNonZero;
+		cudaMemcpy(_devReducedSparseCFHessinaCsrVal, _hostReducedSparseCFHessinaCsrVal.data(), nnz * sizeof(qeal), cudaMemcpyHostToDevice);
+		cublasDaxpy(blasHandle, nnz, &cublas_pos_one, _devReducedSparseCFHessinaCsrVal, 1, _devReducedSparseSysMatrixCsrVal, 1);
+		cudaMemcpy(_devReducedRhs, _sysReducedRhs.data(), _sysReducedDim * sizeof(qeal), cudaMemcpyHostToDevice);
+		computeSystemUsingCusolverSparseChol(_devReducedSparseSysMatrixCsrVal, _devReducedSparseSysMatrixCsrRowPtr, _devReducedSparseSysMatrixCsrColInd, nnz, _devReducedRhs, _devReducedDir, _sysReducedDim);
+		cudaMemcpy(_sysReducedDir.data(), _devReducedDir, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToHost);
+
+		if (_hostProjection)
+			projectToFullspaceHost(_sysReducedDir.data(), _sysDir.data());
+		else
+		{
+			projectToFullspaceGpu(_devReducedDir, _devDir);
+			cudaMemcpy(_sysDir.data(), _devDir, _sysDim * sizeof(qeal), cudaMemcpyDeviceToHost);
 		}
-		cudaMemcpy(_sysDir.data(), _devDir, _sysDim * sizeof(qeal), cudaMemcpyDeviceToHost);
 
 		qeal res = _sysDir.cwiseAbs().maxCoeff() / dt;	
 		if (newton_iter > 0 && res <= tol)
@@ -164,16 +376,32 @@ void MIPC::MipcSimulator::doTimeGpuDenseSystem(int frame)
 			break;
 		}
 
-		// line search
-		cudaMemcpy(_devMedialPointPosition, medialPointsBuffer.buffer.data(), 3 * totalMedialPoinsNum * sizeof(qeal), cudaMemcpyHostToDevice);
-		computeMedialPointsMovingDir
-		(
-			totalMedialPoinsNum,
-			_devMedialPointsNum,
-			_devMedialOriPointPosition,
-			_devReducedDir,
-			_devMedialPointMovingDir
-		);
+		// line search, the medial points are transformed on the device with their moving dir so nothing is uploaded
+		for (int type = ReducedFrameType::LINEAR; type <= ReducedFrameType::Translation; type++)
+		{
+			int begin = _hostFrameBatchOffset[type - 1];
+			int num = _hostFrameBatchOffset[type] - begin;
+			if (num == 0)
+				continue;
+			transformReducedFrames
+			(
+				num,
+				type,
+				_devFrameBatchPointId + begin,
+				_devFrameBatchReducedOffset + begin,
+				_devFrameBatchRestPosition + 3 * begin,
+				_devReducedX,
+				_devReducedDir,
+				_devMedialPointPosition,
+				_devMedialPointMovingDir
+			);
+		}
+
+		// the broad phase and the host ccd take the moving dir from the reduced dir already on the host
+		if (_broadPhase != ALL_PAIRS || _hostCCD || _ccdType == ADDITIVE_CCD)
+			computeMedialPointsMovingDirHost(_sysReducedDir.data());
+		if (_broadPhase != ALL_PAIRS)
+			updateBroadPhaseCollisionEvents(_hostMedialPointMovingDir.data());
 
 		qeal toi = 1.0;	
 		getToI(toi);
@@ -193,14 +421,13 @@ void MIPC::MipcSimulator::doTimeGpuDenseSystem(int frame)
 			);
 			cudaMemcpy(_sysReducedX.data(), _devReducedX, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToHost);
 
-			for (int mid = 0; mid < models.size(); mid++)
+			if (_hostProjection)
 			{
-				for (int idx = 0; idx < 3; idx++)
-				{
-					cublasDgemv(blasHandle, CUBLAS_OP_N, _hostTetPointProjectionRowsXYZ[mid], _hostTetPointProjectionColsXYZ[mid], &cublas_pos_one, _devTetPointProjectionXYZ[mid], _hostTetPointProjectionRowsXYZ[mid], _devReducedX + _hostFrameBufferOffset[mid] + idx, 3, &cublas_zero, _devSysX + _hostTetPointXOffset[mid] + idx, 3);
-					cudaDeviceSynchronize();
-				}
+				projectToFullspaceHost(_sysReducedX.data(), _sysX.data());
+				CUDA_CALL(cudaMemcpy(_devSysX, _sysX.data(), _sysDim * sizeof(qeal), cudaMemcpyHostToDevice));
 			}
+			else
+				projectToFullspaceGpu(_devReducedX, _devSysX);
 			constructConstraintSet(_kappa, false);
 			E = computeEnergy(_devSysX, _devSysXtilde);
 			toi *= 0.5;
@@ -220,21 +447,87 @@ void MIPC::MipcSimulator::doTimeGpuDenseSystem(int frame)
 		_devReducedVelocity
 	);
 
-	for (int mid = 0; mid < models.size(); mid++)
+	projectToFullspaceGpu(_devReducedVelocity, _devSysVelocity);
+	// with surface skinning _sysX is only rebuilt on demand by reconstructTetPoints
+	if (_surfaceSkinning)
+		return;
+	// with host projection _sysX already holds the last line search trial
+	if (!_hostProjection)
+		cudaMemcpy(_sysX.data(), _devSysX, _sysDim * sizeof(qeal), cudaMemcpyDeviceToHost);
+
+}
+
+void MIPC::MipcSimulator::projectToFullspaceGpu(qeal* devReduced, qeal* devX)
+{
+	projectReducedToTetPoints
+	(
+		totalTetPointsNum,
+		_devTotalTetPointsNum,
+		_devTetPointFrameProjectionNum,
+		_devTetPointFrameProjectionOffset,
+		_devTetPointFrameProjectionFrame,
+		_devTetPointFrameProjectionCoeffNum,
+		_devTetPointFrameProjectionBufferOffset,
+		_devTetPointFrameProjectionBuffer,
+		devReduced,
+		devX
+	);
+}
+
+void MIPC::MipcSimulator::projectToReducedGpu(qeal* devX, qeal* devReduced)
+{
+	projectTetPointsToReduced
+	(
+		_nonStaticFramesNum,
+		_devNonStaticFramesNum,
+		_devFrameReducedOffset,
+		_devFrameCoeffNum,
+		_devFrameTetPointProjectionNum,
+		_devFrameTetPointProjectionOffset,
+		_devFrameTetPointProjectionBufferOffset,
+		_devFrameTetPointProjectionPoint,
+		_devFrameTetPointProjectionBuffer,
+		devX,
+		devReduced
+	);
+}
+
+void MIPC::MipcSimulator::projectToFullspaceHost(const qeal* reduced, qeal* x)
+{
+	#pragma omp parallel for
+	for (int i = 0; i < totalTetPointsNum; i++)
 	{
-		for (int idx = 0; idx < 3; idx++)
+		int offset = _hostTetPointFrameProjectionOffset[i];
+		Vector3 p = Vector3::Zero();
+		for (int j = offset; j < offset + _hostTetPointFrameProjectionNum[i]; j++)
 		{
-			cublasDgemv(blasHandle, CUBLAS_OP_N, _hostTetPointProjectionRowsXYZ[mid], _hostTetPointProjectionColsXYZ[mid], &cublas_pos_one, _devTetPointProjectionXYZ[mid], _hostTetPointProjectionRowsXYZ[mid], _devReducedVelocity + _hostFrameBufferOffset[mid] + idx, 3, &cublas_zero, _devSysVelocity + _hostTetPointXOffset[mid] + idx, 3);
-			cudaDeviceSynchronize();
+			// column c of the 3 x coeffNum frame block is reduced[3c, 3c + 2]
+			int coeffNum = _hostTetPointFrameProjectionCoeffNum[j];
+			Eigen::Map<const MatrixX> r(reduced + _hostTetPointFrameProjectionFrame[j], 3, coeffNum);
+			Eigen::Map<const VectorX> u(_hostTetPointFrameProjectionBuffer.data() + _hostTetPointFrameProjectionBufferOffset[j], coeffNum);
+			p.noalias() += r * u;
 		}
+		Eigen::Map<Vector3>(x + 3 * i) = p;
 	}
-	cudaMemcpy(_sysX.data(), _devSysX, _sysDim * sizeof(qeal), cudaMemcpyDeviceToHost);
-
 }
 
-void MIPC::MipcSimulator::doTimeGpuSparseSystem(int frame)
+void MIPC::MipcSimulator::projectToReducedHost(const qeal* x, qeal* reduced)
 {
-
+	#pragma omp parallel for
+	for (int i = 0; i < _nonStaticFramesNum; i++)
+	{
+		int offset = _hostFrameTetPointProjectionOffset[i];
+		int coeffNum = _hostFrameCoeffNum[i];
+		const qeal* buffer = _hostFrameTetPointProjectionBuffer.data() + _hostFrameTetPointProjectionBufferOffset[i];
+		Eigen::Map<MatrixX> r(reduced + _hostFrameReducedOffset[i], 3, coeffNum);
+		r.setZero();
+		for (int j = 0; j < _hostFrameTetPointProjectionNum[i]; j++)
+		{
+			Eigen::Map<const Vector3> p(x + 3 * _hostFrameTetPointProjectionPoint[offset + j]);
+			Eigen::Map<const VectorX> u(buffer + coeffNum * j, coeffNum);
+			r.noalias() += p * u.transpose();
+		}
+	}
 }
 
 qeal MIPC::MipcSimulator::computeEnergy(qeal* devXn, qeal* devXtilde)
@@ -260,28 +553,34 @@ qeal MIPC::MipcSimulator::computeEnergy(qeal* devXn, qeal* devXtilde)
 	e1 *= 0.5;
 	
 	// compute elastics energy
-	assembleTetELementX
-	(
-		totalTetElementNum,
-		_devTotalTetElementNum,
-		_devTetElementIndices,
-		_devSysX,
-		_devTetElementX
-	);
-	computeElementsEnergy
-	(
-		totalTetElementNum,
-		_devTotalTetElementNum,
-		_devTetElementX,
-		_devTetElementDm,
-		_devTetElementInvDm,
-		_devTetElementAttri,
-		_devTetElementVol,
-		_devTimeStep,
-		_devTetElementPotentialEnergy
-	);
-	qeal e2;
-	cublasDdot(blasHandle, totalTetElementNum, _devTetElementPotentialEnergy, 1, _devTetElementSizeOne, 1, &e2);
+	if (_hostElasticElementNum > 0)
+	{
+		assembleTetELementX
+		(
+			_hostElasticElementNum,
+			_devElasticElementNum,
+			_devTetElementIndices,
+			_devSysX,
+			_devTetElementX
+		);
+		computeElementsEnergy
+		(
+			_hostElasticElementNum,
+			_devElasticElementNum,
+			_devTetElementX,
+			_devTetElementDm,
+			_devTetElementInvDm,
+			_devTetElementAttri,
+			_devTetElementVol,
+			_devTimeStep,
+			_devTetElementPotentialEnergy
+		);
+	}
+	qeal e2 = 0.0;
+	if (_hostElasticElementNum > 0)
+		cublasDdot(blasHandle, _hostElasticElementNum, _devTetElementPotentialEnergy, 1, _devTetElementSizeOne, 1, &e2);
+	if (_hostStVKModel.size() > 0)
+		e2 += computeStVKPolynomial(false);
 
 	qeal e3;
 	e3 = 0.0;
@@ -301,82 +600,122 @@ qeal MIPC::MipcSimulator::computeEnergy(qeal* devXn, qeal* devXtilde)
 void MIPC::MipcSimulator::computeElasticsHessianAndGradient(qeal * elasticsDerivative, qeal * elasticsHessian)
 {
 	qeal timeStep2 = _timeStep * _timeStep;
-	assembleTetELementX
-	(
-		totalTetElementNum,
-		_devTotalTetElementNum,
-		_devTetElementIndices,
-		_devSysX,
-		_devTetElementX
-	);
+	bool sparse = _sysMatType == SPARSE;
+	// the sparse system starts from the mass values on its pattern, the stiffness blocks are added into them
+	if (sparse)
+		cudaMemcpy(_devReducedSparseSysMatrixCsrVal, _devReducedSparseMassCsrVal, _hostReducedSparseSysMatrixCsrNonZero * sizeof(qeal), cudaMemcpyDeviceToDevice);
+	if (_hostElasticElementNum > 0)
+	{
+		assembleTetELementX
+		(
+			_hostElasticElementNum,
+			_devElasticElementNum,
+			_devTetElementIndices,
+			_devSysX,
+			_devTetElementX
+		);
 
-	computeTetElementInternalForce
-	(
-		totalTetElementNum,
-		_devTotalTetElementNum,
-		_devTetElementX,
-		_devTetElementDm,
-		_devTetElementInvDm,
-		_devTetElementdFPK,
-		_devTetElementAttri,
-		_devTetElementForce
-	);
+		computeTetElementInternalForce
+		(
+			_hostElasticElementNum,
+			_devElasticElementNum,
+			_devTetElementX,
+			_devTetElementDm,
+			_devTetElementInvDm,
+			_devTetElementdFPK,
+			_devTetElementAttri,
+			_devTetElementForce
+		);
 
-	computeTetElementStiffness
-	(
-		totalTetElementNum,
-		_devTotalTetElementNum,
-		_devTetElementX,
-		_devTetElementDm,
-		_devTetElementInvDm,
-		_devTetElementdFdu,
-		_devTetElementdFPK,// as eigen value of dPdF
-		_devTetElementdPdF,// as eigen vector of dPdF
-		_devTetElementAttri,
-		_devTetElementStiffness
-	);
+		computeTetElementStiffness
+		(
+			_hostElasticElementNum,
+			_devElasticElementNum,
+			_devTetElementX,
+			_devTetElementDm,
+			_devTetElementInvDm,
+			_devTetElementdFdu,
+			_devTetElementdFPK,// as eigen value of dPdF
+			_devTetElementdPdF,// as eigen vector of dPdF
+			_devTetElementAttri,
+			_devTetElementStiffness
+		);
 
-	assembleTetPointsForceFromElementForce
-	(
-		totalTetPointsNum,
-		_devTotalTetPointsNum,
-		_devTetPointsSharedElementNum,
-		_devTetPointsSharedElementOffset,
-		_devTetPointsSharedElementList,
-		_devTetElementForce,
-		_devInternalForce
-	);
+		assembleTetPointsForceFromElementForce
+		(
+			totalTetPointsNum,
+			_devTotalTetPointsNum,
+			_devTetPointsSharedElementNum,
+			_devTetPointsSharedElementOffset,
+			_devTetPointsSharedElementList,
+			_devTetElementForce,
+			_devInternalForce
+		);
 
-	for (int mid = 0; mid < models.size(); mid++)
+		projectToReducedGpu(_devInternalForce, _devReducedInternalForce);
+
+		if (sparse)
+			assembleReducedStiffnessToCsr
+			(
+				_hostAssembleBlockNum,
+				_hostAssembleBlockDim,
+				_devAssembleBlockNum,
+				_devAssembleBlockIndex,
+				_devStiffnessBlockSharedTetElementList,
+				_devStiffnessBlockSharedTetElementNum,
+				_devStiffnessBlockSharedTetElementOffset,
+				_devPojectionStiffnessList,
+				_devTetElementSharedFrameList,
+				_devTetElementSharedFrameOffset,
+				_devTetElementFrameProjectionBuffer,
+				_devTetElementFrameProjectionCoeffNum,
+				_devTetElementFrameProjectionBufferOffset,
+				_devFrameReducedOffset,
+				_devFrameCoeffNum,
+				_devTetElementStiffness,
+				_devReducedDim,
+				_devAssembleBlockCsrSlot,
+				_devReducedSparseSysMatrixCsrRowPtr,
+				_devReducedSparseSysMatrixCsrVal,
+				timeStep2
+			);
+		else
+			assembleReducedStiffness
+			(
+				_hostAssembleBlockNum,
+				_hostAssembleBlockDim,
+				_devAssembleBlockNum,
+				_devAssembleBlockIndex,
+				_devStiffnessBlockSharedTetElementList,
+				_devStiffnessBlockSharedTetElementNum,
+				_devStiffnessBlockSharedTetElementOffset,
+				_devPojectionStiffnessList,
+				_devTetElementSharedFrameList,
+				_devTetElementSharedFrameOffset,
+				_devTetElementFrameProjectionBuffer,
+				_devTetElementFrameProjectionCoeffNum,
+				_devTetElementFrameProjectionBufferOffset,
+				_devFrameReducedOffset,
+				_devFrameCoeffNum,
+				_devTetElementStiffness,
+				_devReducedDim,
+				_devReducedStiffness
+			);
+	}
+	else
 	{
-		for (int idx = 0; idx < 3; idx++)
-		{
-			cublasDgemv(blasHandle, CUBLAS_OP_T, _hostTetPointProjectionRowsXYZ[mid], _hostTetPointProjectionColsXYZ[mid], &cublas_pos_one, _devTetPointProjectionXYZ[mid], _hostTetPointProjectionRowsXYZ[mid], _devInternalForce + _hostTetPointXOffset[mid] + idx, 3, &cublas_zero, _devReducedInternalForce + _hostFrameBufferOffset[mid] + idx, 3);
-			cudaDeviceSynchronize();
-		}
+		cudaMemset(_devReducedInternalForce, 0, _sysReducedDim * sizeof(qeal));
+		if (!sparse)
+			cudaMemset(_devReducedStiffness, 0, _sysReducedDim * _sysReducedDim * sizeof(qeal));
 	}
+	if (_hostStVKModel.size() > 0)
+		computeStVKPolynomial(true);
 
-	assembleReducedStiffness
-	(
-		_hostAssembleBlockNum,
-		_devAssembleBlockNum,
-		_devAssembleBlockIndex,
-		_devStiffnessBlockSharedTetElementList,
-		_devStiffnessBlockSharedTetElementNum,
-		_devStiffnessBlockSharedTetElementOffset,
-		_devPojectionStiffnessList,
-		_devTetElementSharedFrameList,
-		_devTetElementSharedFrameOffset,
-		_devTetElementFrameProjectionBuffer,
-		_devTetElementFrameProjectionNum,
-		_devTetElementFrameProjectionOffset,
-		_devTetElementStiffness,
-		_devReducedDim,
-		_devReducedStiffness
-	);
-
-	cudaMemcpy(_devReducedMatrix, _devReducedMassMatrix, _sysReducedDim * _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToDevice);
-	cublasDaxpy(blasHandle, _sysReducedDim * _sysReducedDim, &timeStep2, _devReducedStiffness, 1, _devReducedMatrix, 1);
+	if (!sparse)
+	{
+		cudaMemcpy(_devReducedMatrix, _devReducedMassMatrix, _sysReducedDim * _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToDevice);
+		cublasDaxpy(blasHandle, _sysReducedDim * _sysReducedDim, &timeStep2, _devReducedStiffness, 1, _devReducedMatrix, 1);
+	}
 
 	computeReducedInertia
 	(
@@ -389,7 +728,10 @@ void MIPC::MipcSimulator::computeElasticsHessianAndGradient(qeal * elasticsDeriv
 		_devInertia
 	);
 
-	cublasDgemv(blasHandle, CUBLAS_OP_N, _sysReducedDim, _sysReducedDim, &cublas_pos_one, _devReducedMassMatrix, _sysReducedDim, _devInertia, 1, &cublas_zero, _devReducedRhs, 1);
+	if (sparse)
+		csrMatrixVectorProduct(_sysReducedDim, _devReducedDim, _devReducedSparseSysMatrixCsrRowPtr, _devReducedSparseSysMatrixCsrColInd, _devReducedSparseMassCsrVal, _devInertia, _devReducedRhs);
+	else
+		cublasDgemv(blasHandle, CUBLAS_OP_N, _sysReducedDim, _sysReducedDim, &cublas_pos_one, _devReducedMassMatrix, _sysReducedDim, _devInertia, 1, &cublas_zero, _devReducedRhs, 1);
 	cudaDeviceSynchronize();
 
 	cublasDaxpy(blasHandle, _sysReducedDim, &timeStep2, _devReducedInternalForce, 1, _devReducedRhs, 1);
@@ -401,33 +743,442 @@ void MIPC::MipcSimulator::computeElasticsHessianAndGradient(qeal * elasticsDeriv
 	cublasDscal(blasHandle, _sysReducedDim, &alpha, _devReducedRhs, 1);
 
 	cudaMemcpy(elasticsDerivative, _devReducedRhs, _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToHost);
-	cudaMemcpy(elasticsHessian, _devReducedMatrix, _sysReducedDim * _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToHost);
+	// the sparse system keeps its hessian in _devReducedSparseSysMatrixCsrVal
+	if (elasticsHessian != nullptr)
+		cudaMemcpy(elasticsHessian, _devReducedMatrix, _sysReducedDim * _sysReducedDim * sizeof(qeal), cudaMemcpyDeviceToHost);
+}
+
+qeal MIPC::MipcSimulator::computeStVKPolynomial(bool derivatives)
+{
+	qeal energy = 0.0;
+	for (int s = 0; s < _hostStVKModel.size(); s++)
+	{
+		int mid = _hostStVKModel[s];
+		int r = getModel(mid)->getReducedDim();
+		int r2 = r * r;
+		int r3 = r2 * r;
+		int o = _sysReducedOffsetByModel[mid];
+		qeal* q = _devReducedX + o;
+		qeal* y = _devStVKBuffer;
+		qeal* U = y + r2;
+		qeal* S = U + r3;
+		qeal* R = S + r2;
+		qeal* T = R + r2;
+		qeal* Pm = T + r2;
+		qeal* H = Pm + r2;
+		qeal* Vy = H + r2;
+		qeal* g = Vy + r;
+
+		// y = vec(q * q^T), U = W * (q x q x q) contracted once, S = U * q
+		cudaMemset(y, 0, r2 * sizeof(qeal));
+		cublasDger(blasHandle, r, r, &cublas_pos_one, q, 1, q, 1, y, r);
+		cublasDgemv(blasHandle, CUBLAS_OP_N, r3, r, &cublas_pos_one, _devStVKW[s], r3, q, 1, &cublas_zero, U, 1);
+		cublasDgemv(blasHandle, CUBLAS_OP_N, r2, r, &cublas_pos_one, U, r2, q, 1, &cublas_zero, S, 1);
+		cublasDgemv(blasHandle, CUBLAS_OP_N, r, r2, &cublas_pos_one, _devStVKV[s], r, y, 1, &cublas_zero, Vy, 1);
+		cublasDgemv(blasHandle, CUBLAS_OP_N, r, r, &cublas_pos_one, _devStVKK[s], r, q, 1, &cublas_zero, g, 1);
+
+		// E = q^T * K * q / 2 + q^T * V * y + y^T * W * y
+		qeal eK, eV, eW;
+		cublasDdot(blasHandle, r, q, 1, g, 1, &eK);
+		cublasDdot(blasHandle, r, q, 1, Vy, 1, &eV);
+		cublasDdot(blasHandle, r2, y, 1, S, 1, &eW);
+		energy += 0.5 * eK + eV + eW;
+		if (!derivatives)
+			continue;
+
+		cublasDgemv(blasHandle, CUBLAS_OP_T, r, r2, &cublas_pos_one, U, r, q, 1, &cublas_zero, R, 1);
+		cublasDgemv(blasHandle, CUBLAS_OP_T, r, r2, &cublas_pos_one, _devStVKV[s], r, q, 1, &cublas_zero, T, 1);
+		cublasDgemv(blasHandle, CUBLAS_OP_N, r2, r, &cublas_pos_one, _devStVKV[s], r2, q, 1, &cublas_zero, Pm, 1);
+
+		// g = K * q + V * y + 2 * T * q + 4 * S * q
+		qeal two = 2.0, four = 4.0, eight = 8.0;
+		cublasDaxpy(blasHandle, r, &cublas_pos_one, Vy, 1, g, 1);
+		cublasDgemv(blasHandle, CUBLAS_OP_N, r, r, &two, T, r, q, 1, &cublas_pos_one, g, 1);
+		cublasDgemv(blasHandle, CUBLAS_OP_N, r, r, &four, S, r, q, 1, &cublas_pos_one, g, 1);
+		cublasDaxpy(blasHandle, r, &cublas_pos_one, g, 1, _devReducedInternalForce + o, 1);
+
+		// H = K + 2 * (Pm + Pm^T) + 2 * T + 4 * S + 8 * R, the model has no elements so its diagonal block is only this
+		cublasDgeam(blasHandle, CUBLAS_OP_N, CUBLAS_OP_T, r, r, &cublas_pos_one, _devStVKK[s], r, &two, Pm, r, H, r);
+		cublasDaxpy(blasHandle, r2, &two, Pm, 1, H, 1);
+		cublasDaxpy(blasHandle, r2, &two, T, 1, H, 1);
+		cublasDaxpy(blasHandle, r2, &four, S, 1, H, 1);
+		cublasDaxpy(blasHandle, r2, &eight, R, 1, H, 1);
+		if (_sysMatType == SPARSE)
+			addDenseBlockToCsr(r, r, o, o, H, _timeStep * _timeStep, _devReducedSparseSysMatrixCsrRowPtr, _devReducedSparseSysMatrixCsrColInd, _devReducedSparseSysMatrixCsrVal);
+		else
+			cudaMemcpy2D(_devReducedStiffness + o * _sysReducedDim + o, _sysReducedDim * sizeof(qeal), H, r * sizeof(qeal), r * sizeof(qeal), r, cudaMemcpyDeviceToDevice);
+	}
+	return energy * _timeStep * _timeStep;
+}
+
+void MIPC::MipcSimulator::buildReducedFrameBatch()
+{
+	std::vector<std::vector<ReducedFrame*>> typeFrames(ReducedFrameType::Translation + 1);
+	for (int i = 0; i < _reducedFrameList.size(); i++)
+	{
+		ReducedFrame* frame = _reducedFrameList[i];
+		if (frame->getOffset() < 0 || frame->getFrameType() == ReducedFrameType::STATIC)
+			continue;
+		typeFrames[frame->getFrameType()].push_back(frame);
+	}
+
+	_hostFrameBatchOffset.resize(ReducedFrameType::Translation + 1);
+	_hostFrameBatchOffset[0] = 0;
+	_hostFrameBatchPointId.clear();
+	_hostFrameBatchReducedOffset.clear();
+	_hostFrameBatchRestPosition.clear();
+	_hostFrameBatchFrame.clear();
+	for (int type = ReducedFrameType::LINEAR; type <= ReducedFrameType::Translation; type++)
+	{
+		std::vector<ReducedFrame*>& frames = typeFrames[type];
+		std::vector<qeal> rest(3 * frames.size());
+		for (int i = 0; i < frames.size(); i++)
+		{
+			qeal oriP[3];
+			frames[i]->getOriginalP(oriP);
+			for (int c = 0; c < 3; c++)
+				rest[c * frames.size() + i] = oriP[c];
+			_hostFrameBatchPointId.push_back((frames[i]->getP() - medialPointsBuffer.buffer.data()) / 3);
+			_hostFrameBatchReducedOffset.push_back(frames[i]->getOffset());
+			_hostFrameBatchFrame.push_back(frames[i]);
+		}
+		_hostFrameBatchRestPosition.insert(_hostFrameBatchRestPosition.end(), rest.begin(), rest.end());
+		_hostFrameBatchOffset[type] = _hostFrameBatchFrame.size();
+	}
+}
+
+void MIPC::MipcSimulator::transformReducedFramesHost()
+{
+	const qeal* X = _sysReducedX.data();
+	qeal* points = medialPointsBuffer.buffer.data();
+	for (int type = ReducedFrameType::LINEAR; type <= ReducedFrameType::Translation; type++)
+	{
+		int begin = _hostFrameBatchOffset[type - 1];
+		int num = _hostFrameBatchOffset[type] - begin;
+		const int* pointId = _hostFrameBatchPointId.data() + begin;
+		const int* reducedOffset = _hostFrameBatchReducedOffset.data() + begin;
+		const qeal* restX = _hostFrameBatchRestPosition.data() + 3 * begin;
+		const qeal* restY = restX + num;
+		const qeal* restZ = restY + num;
+		#pragma omp parallel for
+		for (int i = 0; i < num; i++)
+		{
+			qeal x = restX[i], y = restY[i], z = restZ[i];
+			const qeal* q = X + reducedOffset[i];
+			qeal d[3];
+			for (int c = 0; c < 3; c++)
+			{
+				if (type == ReducedFrameType::LINEAR)
+					d[c] = x * q[c] + y * q[3 + c] + z * q[6 + c] + q[9 + c];
+				else if (type == ReducedFrameType::Quadratic)
+					d[c] = x * q[c] + y * q[3 + c] + z * q[6 + c] + x * x * q[9 + c] + y * y * q[12 + c] + z * z * q[15 + c] + x * y * q[18 + c] + y * z * q[21 + c] + x * z * q[24 + c] + q[27 + c];
+				else d[c] = q[c];
+			}
+
+			qeal* p = points + 3 * pointId[i];
+			ReducedFrame* frame = _hostFrameBatchFrame[begin + i];
+			frame->_lastX = p[0];
+			frame->_lastY = p[1];
+			frame->_lastZ = p[2];
+			p[0] = x + d[0];
+			p[1] = y + d[1];
+			p[2] = z + d[2];
+			frame->accumulateMotion();
+		}
+	}
+}
+
+void MIPC::MipcSimulator::computeMedialPointsMovingDirHost(const qeal* reducedDir)
+{
+	qeal* dir = _hostMedialPointMovingDir.data();
+	for (int type = ReducedFrameType::LINEAR; type <= ReducedFrameType::Translation; type++)
+	{
+		int begin = _hostFrameBatchOffset[type - 1];
+		int num = _hostFrameBatchOffset[type] - begin;
+		const int* pointId = _hostFrameBatchPointId.data() + begin;
+		const int* reducedOffset = _hostFrameBatchReducedOffset.data() + begin;
+		const qeal* restX = _hostFrameBatchRestPosition.data() + 3 * begin;
+		const qeal* restY = restX + num;
+		const qeal* restZ = restY + num;
+		#pragma omp parallel for
+		for (int i = 0; i < num; i++)
+		{
+			qeal x = restX[i], y = restY[i], z = restZ[i];
+			const qeal* q = reducedDir + reducedOffset[i];
+			qeal* d = dir + 3 * pointId[i];
+			for (int c = 0; c < 3; c++)
+			{
+				if (type == ReducedFrameType::LINEAR)
+					d[c] = x * q[c] + y * q[3 + c] + z * q[6 + c] + q[9 + c];
+				else if (type == ReducedFrameType::Quadratic)
+					d[c] = x * q[c] + y * q[3 + c] + z * q[6 + c] + x * x * q[9 + c] + y * y * q[12 + c] + z * z * q[15 + c] + x * y * q[18 + c] + y * z * q[21 + c] + x * z * q[24 + c] + q[27 + c];
+				else d[c] = q[c];
+			}
+		}
+	}
 }
 
 void MIPC::MipcSimulator::constructConstraintSet(const qeal kappa, bool updateFriction)
 {
 	// update collision set
-	for (int i = 0; i < _reducedFrameList.size(); i++)
-		_reducedFrameList[i]->transform();
+	transformReducedFramesHost();
 	_activeCollisionEvents.clear();
 	if (updateFriction && enableFriction)
 		_frictionCollisionEvents.clear();
 
-	for (int i = 0; i < _overallCollisionEvents.size(); i++)
+	if (_hotColdEvents)
+		promoteColdCollisionEvents();
+	if (_modelCulling)
+		updateModelBoundingBoxes();
+	std::vector<MipcConstraint*>& events = _hotColdEvents ? _hotCollisionEvents : _overallCollisionEvents;
+
+	for (int i = 0; i < events.size(); i++)
 	{
-		_overallCollisionEvents[i]->computeDistance();
-		if (_overallCollisionEvents[i]->isActive())
+		if (_modelCulling && !isModelPairNear(events[i]))
 		{
-			_activeCollisionEvents.push_back(_overallCollisionEvents[i]);
+			events[i]->distance = QEAL_MAX;
+			continue;
+		}
+		events[i]->updateDistance();
+		if (events[i]->isActive())
+		{
+			_activeCollisionEvents.push_back(events[i]);
 			if (updateFriction && enableFriction)
 			{
-				_overallCollisionEvents[i]->computeLagTangentBasis(kappa);
-				_frictionCollisionEvents.push_back(_overallCollisionEvents[i]);
+				events[i]->computeLagTangentBasis(kappa);
+				_frictionCollisionEvents.push_back(events[i]);
 			}
 		}
 	}
 }
 
+void MIPC::MipcSimulator::updateModelBoundingBoxes()
+{
+	int modelsNum = models.size();
+	int totalModelsNum = modelsNum + staticModels.size();
+	_modelBoundingBox.resize(6 * totalModelsNum);
+	#pragma omp parallel for
+	for (int k = 0; k < totalModelsNum; k++)
+	{
+		bool isStatic = k >= modelsNum;
+		BaseMedialMesh* m = isStatic ? staticModels[k - modelsNum]->getMedialMeshHandle()->getMesh() : models[k]->getMedialMeshHandle()->getMesh();
+		qeal* box = _modelBoundingBox.data() + 6 * k;
+		for (int j = 0; j < 3; j++)
+		{
+			box[j] = QEAL_MAX;
+			box[3 + j] = -QEAL_MAX;
+		}
+		if (m == nullptr)
+			continue;
+		for (int i = 0; i < m->medialPointsNum; i++)
+		{
+			int gid = m->getMedialPointOverallId(i);
+			qeal* p = isStatic ? staticModelPool.medialPointsBuffer.buffer.data() + 3 * gid : medialPointsBuffer.buffer.data() + 3 * gid;
+			qeal r = isStatic ? staticModelPool.medialRadiusBuffer.buffer[gid] : medialRadiusBuffer.buffer[gid];
+			for (int j = 0; j < 3; j++)
+			{
+				box[j] = std::min(box[j], p[j] - r - _dHat);
+				box[3 + j] = std::max(box[3 + j], p[j] + r + _dHat);
+			}
+		}
+	}
+
+	// sweep and prune along x
+	std::vector<int> order(totalModelsNum);
+	for (int k = 0; k < totalModelsNum; k++)
+		order[k] = k;
+	std::sort(order.begin(), order.end(), [&](int a, int b) {return _modelBoundingBox[6 * a] < _modelBoundingBox[6 * b]; });
+	_modelPairNear.assign(totalModelsNum * totalModelsNum, 0);
+	for (int a = 0; a < totalModelsNum; a++)
+	{
+		int ka = order[a];
+		qeal* boxA = _modelBoundingBox.data() + 6 * ka;
+		_modelPairNear[ka * totalModelsNum + ka] = 1;
+		for (int b = a + 1; b < totalModelsNum; b++)
+		{
+			int kb = order[b];
+			qeal* boxB = _modelBoundingBox.data() + 6 * kb;
+			if (boxB[0] > boxA[3])
+				break;
+			if (boxA[1] > boxB[4] || boxB[1] > boxA[4] || boxA[2] > boxB[5] || boxB[2] > boxA[5])
+				continue;
+			_modelPairNear[ka * totalModelsNum + kb] = 1;
+			_modelPairNear[kb * totalModelsNum + ka] = 1;
+		}
+	}
+}
+
+bool MIPC::MipcSimulator::isModelPairNear(MipcConstraint* event)
+{
+	int modelsNum = models.size();
+	int totalModelsNum = modelsNum + staticModels.size();
+	int k0 = event->modelPair[0] >= 0 ? event->modelPair[0] : modelsNum - event->modelPair[0] - 1;
+	int k1 = event->modelPair[1] >= 0 ? event->modelPair[1] : modelsNum - event->modelPair[1] - 1;
+	return _modelPairNear[k0 * totalModelsNum + k1] != 0;
+}
+
+void MIPC::MipcSimulator::splitHotColdCollisionEvents()
+{
+	transformReducedFramesHost();
+
+	// the largest frame motion predicted by Xtilde bounds how far this step is expected to go
+	int framesNum = _reducedFrameList.size();
+	_hotColdStepFramePosition.resize(3 * framesNum);
+	qeal predictMotion = 0.0;
+	for (int i = 0; i < framesNum; i++)
+	{
+		ReducedFrame* frame = _reducedFrameList[i];
+		qeal* p = frame->getP();
+		_hotColdStepFramePosition[3 * i] = p[0];
+		_hotColdStepFramePosition[3 * i + 1] = p[1];
+		_hotColdStepFramePosition[3 * i + 2] = p[2];
+		if (frame->getOffset() < 0)
+			continue;
+		qeal oriP[3], u[3];
+		frame->getOriginalP(oriP);
+		frame->projectFullspaceXtilde(u);
+		qeal dx = oriP[0] + u[0] - p[0];
+		qeal dy = oriP[1] + u[1] - p[1];
+		qeal dz = oriP[2] + u[2] - p[2];
+		qeal motion = std::sqrt(dx * dx + dy * dy + dz * dz);
+		if (motion > predictMotion)
+			predictMotion = motion;
+	}
+	// both sides of an event may move
+	_hotColdBudget = 2.0 * _hotColdMotionScale * predictMotion;
+	for (int i = 0; i < _hotCollisionEvents.size(); i++)
+		_hotCollisionEvents[i]->hotColdSorted = false;
+	for (int i = 0; i < _coldCollisionEvents.size(); i++)
+		_coldCollisionEvents[i]->hotColdSorted = false;
+
+	int eventsNum = _overallCollisionEvents.size();
+	std::vector<qeal> budget(eventsNum);
+	#pragma omp parallel for
+	for (int i = 0; i < eventsNum; i++)
+	{
+		_overallCollisionEvents[i]->computeDistance();
+		budget[i] = _overallCollisionEvents[i]->getMotionBudget();
+	}
+
+	_hotCollisionEvents.clear();
+	std::vector<int> coldList;
+	for (int i = 0; i < eventsNum; i++)
+	{
+		_overallCollisionEvents[i]->hotColdSorted = true;
+		if (budget[i] <= _hotColdBudget)
+			_hotCollisionEvents.push_back(_overallCollisionEvents[i]);
+		else coldList.push_back(i);
+	}
+
+	// cheapest to reach first, promotion only has to look at a prefix
+	std::sort(coldList.begin(), coldList.end(), [&](int a, int b) {return budget[a] < budget[b]; });
+	_coldCollisionEvents.resize(coldList.size());
+	_coldCollisionBudget.resize(coldList.size());
+	for (int i = 0; i < coldList.size(); i++)
+	{
+		_coldCollisionEvents[i] = _overallCollisionEvents[coldList[i]];
+		_coldCollisionBudget[i] = budget[coldList[i]];
+	}
+	_coldPromotedNum = 0;
+}
+
+void MIPC::MipcSimulator::classifyHotColdCollisionEvents(std::vector<MipcConstraint*>& events)
+{
+	std::vector<MipcConstraint*> newEvents;
+	for (int i = 0; i < events.size(); i++)
+		if (!events[i]->hotColdSorted)
+			newEvents.push_back(events[i]);
+	if (newEvents.size() == 0)
+		return;
+
+	int eventsNum = newEvents.size();
+	std::vector<qeal> budget(eventsNum);
+	#pragma omp parallel for
+	for (int i = 0; i < eventsNum; i++)
+	{
+		newEvents[i]->computeDistance();
+		budget[i] = newEvents[i]->getMotionBudget();
+	}
+
+	// the budget is measured from the current positions, the motion already made since the step start
+	// is taken off so the promotion against the step start reference stays conservative
+	qeal reach = getHotColdStepReach();
+	std::vector<MipcConstraint*> coldEvents;
+	std::vector<qeal> coldBudget;
+	for (int i = 0; i < eventsNum; i++)
+	{
+		newEvents[i]->hotColdSorted = true;
+		qeal b = budget[i] - reach;
+		if (b <= _hotColdBudget)
+			_hotCollisionEvents.push_back(newEvents[i]);
+		else
+		{
+			coldEvents.push_back(newEvents[i]);
+			coldBudget.push_back(b);
+		}
+	}
+	if (coldEvents.size() == 0)
+		return;
+
+	// merge into the part not yet promoted, which stays sorted by budget
+	std::vector<int> order(coldEvents.size());
+	for (int i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) {return coldBudget[a] < coldBudget[b]; });
+
+	std::vector<MipcConstraint*> mergedEvents(_coldCollisionEvents.begin(), _coldCollisionEvents.begin() + _coldPromotedNum);
+	std::vector<qeal> mergedBudget(_coldCollisionBudget.begin(), _coldCollisionBudget.begin() + _coldPromotedNum);
+	int i = _coldPromotedNum, j = 0;
+	while (i < _coldCollisionEvents.size() || j < order.size())
+	{
+		if (j == order.size() || (i < _coldCollisionEvents.size() && _coldCollisionBudget[i] <= coldBudget[order[j]]))
+		{
+			mergedEvents.push_back(_coldCollisionEvents[i]);
+			mergedBudget.push_back(_coldCollisionBudget[i]);
+			i++;
+		}
+		else
+		{
+			mergedEvents.push_back(coldEvents[order[j]]);
+			mergedBudget.push_back(coldBudget[order[j]]);
+			j++;
+		}
+	}
+	_coldCollisionEvents.swap(mergedEvents);
+	_coldCollisionBudget.swap(mergedBudget);
+}
+
+qeal MIPC::MipcSimulator::getHotColdStepReach()
+{
+	qeal stepMotion = 0.0;
+	for (int i = 0; i < _reducedFrameList.size(); i++)
+	{
+		if (_reducedFrameList[i]->getOffset() < 0)
+			continue;
+		qeal* p = _reducedFrameList[i]->getP();
+		qeal dx = p[0] - _hotColdStepFramePosition[3 * i];
+		qeal dy = p[1] - _hotColdStepFramePosition[3 * i + 1];
+		qeal dz = p[2] - _hotColdStepFramePosition[3 * i + 2];
+		qeal motion = std::sqrt(dx * dx + dy * dy + dz * dz);
+		if (motion > stepMotion)
+			stepMotion = motion;
+	}
+	return 2.0 * stepMotion;
+}
+
+void MIPC::MipcSimulator::promoteColdCollisionEvents()
+{
+	if (_coldPromotedNum >= _coldCollisionEvents.size())
+		return;
+
+	qeal reach = getHotColdStepReach();
+	while (_coldPromotedNum < _coldCollisionEvents.size() && _coldCollisionBudget[_coldPromotedNum] <= reach)
+	{
+		_hotCollisionEvents.push_back(_coldCollisionEvents[_coldPromotedNum]);
+		_coldPromotedNum++;
+	}
+}
+
 void MIPC::MipcSimulator::getToI(qeal& toi)
 {
 	if (_hostCollisionEventNum == 0)
@@ -436,28 +1187,187 @@ void MIPC::MipcSimulator::getToI(qeal& toi)
 		return;
 	}
 
-	MPsCCD
-	(
-		_hostCollisionEventNum,
-		_devCollisionEventNum,
-		_devMedialPointPosition,
-		_devMedialPointRadius,
-		_devStaticMedialPointPosition,
-		_devStaticMedialPointRadius,
-		_devMedialPointMovingDir,
-		_devCollisionEventList,
-		_devCCD
-	);
+	// every ccd scales a toi below 1 by the same 0.8 so that the step stays off the contact, the additive ccd included
+	if (_ccdType == ADDITIVE_CCD)
+		toi = MPsACCDHost
+		(
+			_hostCollisionEventNum,
+			medialPointsBuffer.buffer.data(),
+			medialRadiusBuffer.buffer.data(),
+			staticModelPool.medialPointsBuffer.buffer.data(),
+			staticModelPool.medialRadiusBuffer.buffer.data(),
+			_hostMedialPointMovingDir.data(),
+			_hostCollisionEventList.data(),
+			_accdGap
+		);
+	else if (_hostCCD)
+		toi = MPsCCDHost
+		(
+			_hostCollisionEventNum,
+			medialPointsBuffer.buffer.data(),
+			medialRadiusBuffer.buffer.data(),
+			staticModelPool.medialPointsBuffer.buffer.data(),
+			staticModelPool.medialRadiusBuffer.buffer.data(),
+			_hostMedialPointMovingDir.data(),
+			_hostCollisionEventList.data(),
+			_hostCCDLowerBound
+		);
+	else
+	{
+		MPsCCD
+		(
+			_hostCollisionEventNum,
+			_devCollisionEventNum,
+			_devMedialPointPosition,
+			_devMedialPointRadius,
+			_devStaticMedialPointPosition,
+			_devStaticMedialPointRadius,
+			_devMedialPointMovingDir,
+			_devCollisionEventList,
+			_devCCD
+		);
 
-	int idx = 0;
-	cublasIdamin(blasHandle, _hostCollisionEventNum,
-		_devCCD, 1, &idx);
-	cudaMemcpy(&toi, _devCCD + (idx - 1), sizeof(qeal), cudaMemcpyDeviceToHost);
+		int idx = 0;
+		cublasIdamin(blasHandle, _hostCollisionEventNum,
+			_devCCD, 1, &idx);
+		cudaMemcpy(&toi, _devCCD + (idx - 1), sizeof(qeal), cudaMemcpyDeviceToHost);
+	}
 
 	if (toi < 1.0)
 		toi *= 0.8;
 }
 
+void MIPC::MipcSimulator::assembleCollisionGradientAndHessian(std::vector<MipcConstraint*>& events, bool isFriction, VectorX& gradient, MatrixX& hessian)
+{
+	int eventsNum = events.size();
+	if (!_parallelAssembly)
+	{
+		for (int i = 0; i < eventsNum; i++)
+		{
+			if (isFriction)
+				events[i]->getFrictionGradientAndHessian(_kappa, gradient, hessian);
+			else events[i]->getGradientAndHessian(_kappa, gradient, hessian);
+		}
+		return;
+	}
+
+	// local 12 x 12 terms are independent
+	#pragma omp parallel for
+	for (int i = 0; i < eventsNum; i++)
+	{
+		if (isFriction)
+			events[i]->computeLocalFrictionGradientAndHessian(_kappa);
+		else events[i]->computeLocalGradientAndHessian(_kappa);
+	}
+
+	// scatter color by color, no two events of a color touch the same frame
+	colorCollisionEvents(events, _assembleColorList, _assembleSerialList);
+	for (int c = 0; c < _assembleColorList.size(); c++)
+	{
+		std::vector<int>& colorSet = _assembleColorList[c];
+		int colorSize = colorSet.size();
+		#pragma omp parallel for
+		for (int i = 0; i < colorSize; i++)
+		{
+			if (isFriction)
+				events[colorSet[i]]->fillLocalFrictionGradientAndHessian(gradient, hessian);
+			else events[colorSet[i]]->fillLocalGradientAndHessian(gradient, hessian);
+		}
+	}
+
+	for (int i = 0; i < _assembleSerialList.size(); i++)
+	{
+		if (isFriction)
+			events[_assembleSerialList[i]]->fillLocalFrictionGradientAndHessian(gradient, hessian);
+		else events[_assembleSerialList[i]]->fillLocalGradientAndHessian(gradient, hessian);
+	}
+}
+
+void MIPC::MipcSimulator::assembleCollisionGradientAndHessian(std::vector<MipcConstraint*>& events, bool isFriction, VectorX& gradient, std::vector<qeal>& csrVal)
+{
+	int eventsNum = events.size();
+	const std::vector<int>& csrRowPtr = _hostReducedSparseSysMatrixCsrRowPtr;
+	if (!_parallelAssembly)
+	{
+		for (int i = 0; i < eventsNum; i++)
+		{
+			if (isFriction)
+				events[i]->getFrictionGradientAndHessian(_kappa, gradient, csrRowPtr, csrVal);
+			else events[i]->getGradientAndHessian(_kappa, gradient, csrRowPtr, csrVal);
+		}
+		return;
+	}
+
+	#pragma omp parallel for
+	for (int i = 0; i < eventsNum; i++)
+	{
+		if (isFriction)
+			events[i]->computeLocalFrictionGradientAndHessian(_kappa);
+		else events[i]->computeLocalGradientAndHessian(_kappa);
+	}
+
+	colorCollisionEvents(events, _assembleColorList, _assembleSerialList);
+	for (int c = 0; c < _assembleColorList.size(); c++)
+	{
+		std::vector<int>& colorSet = _assembleColorList[c];
+		int colorSize = colorSet.size();
+		#pragma omp parallel for
+		for (int i = 0; i < colorSize; i++)
+		{
+			if (isFriction)
+				events[colorSet[i]]->fillLocalFrictionGradientAndHessian(gradient, csrRowPtr, csrVal);
+			else events[colorSet[i]]->fillLocalGradientAndHessian(gradient, csrRowPtr, csrVal);
+		}
+	}
+
+	for (int i = 0; i < _assembleSerialList.size(); i++)
+	{
+		if (isFriction)
+			events[_assembleSerialList[i]]->fillLocalFrictionGradientAndHessian(gradient, csrRowPtr, csrVal);
+		else events[_assembleSerialList[i]]->fillLocalGradientAndHessian(gradient, csrRowPtr, csrVal);
+	}
+}
+
+void MIPC::MipcSimulator::colorCollisionEvents(std::vector<MipcConstraint*>& events, std::vector<std::vector<int>>& colorList, std::vector<int>& serialList)
+{
+	const int maxColorNum = 64;
+	colorList.clear();
+	serialList.clear();
+	// greedy coloring, each frame records the colors already touching it
+	std::vector<unsigned long long> frameColorMask(_nonStaticFramesNum, 0);
+	for (int i = 0; i < events.size(); i++)
+	{
+		unsigned long long mask = 0;
+		for (int k = 0; k < 4; k++)
+		{
+			MedialSphereFrame* frame = events[i]->spheres[k]->center;
+			if (frame->getFrameType() == FrameType::STATIC)
+				continue;
+			mask |= frameColorMask[frame->getFrameId()];
+		}
+
+		int color = 0;
+		while (color < maxColorNum && (mask & (1ull << color)))
+			color++;
+		if (color == maxColorNum)
+		{
+			serialList.push_back(i);
+			continue;
+		}
+
+		for (int k = 0; k < 4; k++)
+		{
+			MedialSphereFrame* frame = events[i]->spheres[k]->center;
+			if (frame->getFrameType() == FrameType::STATIC)
+				continue;
+			frameColorMask[frame->getFrameId()] |= (1ull << color);
+		}
+		if (color >= colorList.size())
+			colorList.resize(color + 1);
+		colorList[color].push_back(i);
+	}
+}
+
 void MIPC::MipcSimulator::computeSystemUsingCusolverDenseChol(qeal* devSys, qeal* devRhs, qeal* devX, int dim)
 {
 	int bufferSize = 0;
@@ -526,7 +1436,18 @@ void MIPC::MipcSimulator::initialization()
 	{
 		MipcModel* m = getModel(mid);
 		std::string frameFilename = m->dir + "frames.dofs";
-		m->readFrameMatList(frameFilename);
+		std::ifstream frameFile(frameFilename.c_str());
+		bool hasFrameFile = frameFile.is_open();
+		frameFile.close();
+		if (!hasFrameFile && m->linearFrameBudget + m->quadFrameBudget > 0)
+		{
+			// displacements of the tet points the frames should reproduce, one per column
+			MatrixX samples;
+			std::string sampleFilename = m->dir + "frame_samples.dat";
+			EigenMatrixIO::read_binary(sampleFilename.c_str(), samples);
+			m->selectFrames(m->linearFrameBudget, m->quadFrameBudget, samples, frameFilename);
+		}
+		else m->readFrameMatList(frameFilename);
 		_sysReducedOffsetByModel[mid] = _sysReducedDim;
 		_sysReducedDim += m->getReducedDim();
 		for (size_t i = 0; i < m->getNonStaticFramesNum(); i++)
@@ -576,6 +1497,7 @@ void MIPC::MipcSimulator::initialization()
 	int frameOffset = 0;
 	for (size_t mid = 0; mid < models.size(); mid++)
 		getModel(mid)->createReducedFrame(frameOffset, bufferOffset, _sysReducedX.data(), _sysReducedXn.data(), _sysReducedXtilde.data(), _sysReducedVelocity.data(), _sysReducedVn.data(), _sysReducedAccrelation.data(), _sysReducedAccn.data(), _reducedFrameList);
+	buildReducedFrameBatch();
 
 	_sysReducedSparseProjection.resize(getSysDimension(), _sysReducedDim);
 
@@ -591,6 +1513,34 @@ void MIPC::MipcSimulator::initialization()
 
 	_sysReducedSparseProjection.setFromTriplets(triplet.begin(), triplet.end());
 	_sysReducedSparseProjectionT = _sysReducedSparseProjection.transpose();
+	if (_surfaceSkinning)
+		for (size_t mid = 0; mid < models.size(); mid++)
+			getModel(mid)->computeSurfaceProjection();
+	_hostStVKModel.clear();
+	for (size_t mid = 0; mid < models.size(); mid++)
+	{
+		MipcModel* m = getModel(mid);
+		if (m->elasticMaterial != MipcModel::STVK)
+			continue;
+		std::string stvkFilename = m->dir + "stvk_polynomial.cache";
+		if (m->readStVKPolynomial(stvkFilename) || m->computeStVKPolynomial(_sysReducedOffsetByModel[mid], stvkFilename))
+			_hostStVKModel.push_back(mid);
+		else std::cout << "the stvk polynomial of " << m->getReducedDim() << " reduced coordinates is too large, the elements keep the stable neo-hookean material" << std::endl;
+	}
+	for (size_t mid = 0; mid < models.size(); mid++)
+	{
+		MipcModel* m = getModel(mid);
+		if (m->cubatureBudget <= 0 || m->hasStVKPolynomial())
+			continue;
+		std::string cubatureFilename = m->dir + "cubature.elements";
+		if (m->readElementCubature(cubatureFilename))
+			continue;
+		// reduced coordinates of the model per column
+		MatrixX poses;
+		std::string poseFilename = m->dir + "cubature_poses.dat";
+		EigenMatrixIO::read_binary(poseFilename.c_str(), poses);
+		m->computeElementCubature(poses, _sysReducedOffsetByModel[mid], cubatureFilename);
+	}
 	_sysReducedMass = _sysReducedSparseProjectionT * _sysMassMatrix * _sysReducedSparseProjection;
 	_sysMassMatrix.resize(0, 0);
 	_sysMatrix.resize(0, 0);
@@ -598,6 +1548,11 @@ void MIPC::MipcSimulator::initialization()
 	tol = 1e-3 * _diagLen;
 
 	genOverallCollisionEvents();
+	for (int i = 0; i < _overallCollisionEvents.size(); i++)
+	{
+		_overallCollisionEvents[i]->setWarmStart(_warmStartDistance);
+		_overallCollisionEvents[i]->setMotionFilter(_motionBudgetFilter);
+	}
 	initForGpu();
 }
 
@@ -610,11 +1565,42 @@ void MIPC::MipcSimulator::run(int frame)
 
 void MIPC::MipcSimulator::postRun()
 {
+	if (_surfaceSkinning)
+	{
+		for (size_t mid = 0; mid < models.size(); mid++)
+			getModel(mid)->updateSurfaceFromReduced(_sysReducedX.data());
+		// the medial points already follow their frames, the tet points are only needed to draw the tet mesh
+		bool tetMeshShown = false;
+		for (size_t mid = 0; mid < models.size(); mid++)
+		{
+			// isHide is ambiguous on the model, it derives from the surface, tet and medial meshes
+			BaseTetMesh* tetMesh = getModel(mid)->getTetMeshHandle()->getTetMesh();
+			if (!tetMesh->isHide() && tetMesh->isTetMeshValid())
+				tetMeshShown = true;
+		}
+		if (tetMeshShown)
+			reconstructTetPoints();
+		return;
+	}
 	_sysCurrentPosition = _sysOriginalPosition + _sysX;
 	std::copy(_sysCurrentPosition.data(), _sysCurrentPosition.data() + _sysCurrentPosition.size(), tetPointsBuffer.buffer.data());
 	alignAllMesh(tetPointsBuffer.buffer.data());
 }
 
+void MIPC::MipcSimulator::reconstructTetPoints()
+{
+	projectToFullspaceHost(_sysReducedX.data(), _sysX.data());
+	_sysCurrentPosition = _sysOriginalPosition + _sysX;
+	std::copy(_sysCurrentPosition.data(), _sysCurrentPosition.data() + _sysCurrentPosition.size(), tetPointsBuffer.buffer.data());
+}
+
+void MIPC::MipcSimulator::saveFrameStatus(int frame, std::ofstream& fout)
+{
+	if (_surfaceSkinning)
+		reconstructTetPoints();
+	FemSimulator::saveFrameStatus(frame, fout);
+}
+
 void MIPC::MipcSimulator::initForGpu()
 {
 	if (_runPlatform != RunPlatform::CUDA)
@@ -629,6 +1615,20 @@ void MIPC::MipcSimulator::initForGpu()
 	initCudaMedialMeshMemory();
 	std::cout << "  -- reduced projection memory" << std::endl;
 	initCudaReducedProjectionMemory();
+	// the external force is only gravity, so its fullspace and reduced forms are uploaded once
+	CUDA_CALL(cudaMemcpy(_devExternalForce, _sysGravityForce.data(), _sysGravityForce.size() * sizeof(qeal), cudaMemcpyHostToDevice));
+	if (_hostProjection)
+	{
+		projectToReducedHost(_sysGravityForce.data(), _sysReducedExternalForce.data());
+		CUDA_CALL(cudaMemcpy(_devReducedExternalForce, _sysReducedExternalForce.data(), _sysReducedDim * sizeof(qeal), cudaMemcpyHostToDevice));
+	}
+	else
+		projectToReducedGpu(_devExternalForce, _devReducedExternalForce);
+	if (_hostStVKModel.size() > 0)
+	{
+		std::cout << "  -- stvk polynomial memory" << std::endl;
+		initCudaStVKPolynomialMemory();
+	}
 	if (_sysMatType == SPARSE)
 	{
 		std::cout << "  -- sparse solver memory" << std::endl;
@@ -642,48 +1642,59 @@ void MIPC::MipcSimulator::initForGpu()
 
 void MIPC::MipcSimulator::initCudaTetMeshMemory()
 {
-	CUDA_CALL(cudaMalloc((void**)&_devTotalTetElementNum, sizeof(int))); gpuSize += sizeof(int);
-	CUDA_CALL(cudaMemcpy(_devTotalTetElementNum, &totalTetElementNum, sizeof(int), cudaMemcpyHostToDevice));
+	// the element buffers follow this list, the weights scale the volume so the force, stiffness and energy kernels need no change
+	_hostElasticElementModel.clear();
+	_hostElasticElementId.clear();
+	_hostElasticElementWeight.clear();
+	for (int mid = 0; mid < models.size(); mid++)
+	{
+		MipcModel* m = getModel(mid);
+		// the stvk polynomial replaces the elements of its model
+		if (m->hasStVKPolynomial())
+			continue;
+		bool cubature = m->_cubatureElements.size() > 0;
+		int num = cubature ? m->_cubatureElements.size() : m->tetElementNum;
+		for (int i = 0; i < num; i++)
+		{
+			_hostElasticElementModel.push_back(mid);
+			_hostElasticElementId.push_back(cubature ? m->_cubatureElements[i] : i);
+			_hostElasticElementWeight.push_back(cubature ? m->_cubatureWeights[i] : 1.0);
+		}
+	}
+	_hostElasticElementNum = _hostElasticElementId.size();
+
+	CUDA_CALL(cudaMalloc((void**)&_devElasticElementNum, sizeof(int))); gpuSize += sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devElasticElementNum, &_hostElasticElementNum, sizeof(int), cudaMemcpyHostToDevice));
 
 	CUDA_CALL(cudaMalloc((void**)&_devTotalTetPointsNum, sizeof(int))); gpuSize += sizeof(int);
 	CUDA_CALL(cudaMemcpy(_devTotalTetPointsNum, &totalTetPointsNum, sizeof(int), cudaMemcpyHostToDevice));
 
-	std::vector<int> hostTetElementIndices(4 * totalTetElementNum);
-	int hostTetElementCount = 0;
-	for (int i = 0; i < models.size(); i++)
+	std::vector<int> hostTetElementIndices(4 * _hostElasticElementNum);
+	for (int k = 0; k < _hostElasticElementNum; k++)
 	{
-		for (int j = 0; j < models[i]->tetElementNum; j++)
-		{
-			Vector4i indices = models[i]->getTetElement(j);
-			hostTetElementIndices[4 * hostTetElementCount] = models[i]->getTetPointOverallId(indices.data()[0]);
-			hostTetElementIndices[4 * hostTetElementCount + 1] = models[i]->getTetPointOverallId(indices.data()[1]);
-			hostTetElementIndices[4 * hostTetElementCount + 2] = models[i]->getTetPointOverallId(indices.data()[2]);
-			hostTetElementIndices[4 * hostTetElementCount + 3] = models[i]->getTetPointOverallId(indices.data()[3]);
-			hostTetElementCount++;
-		}
+		MipcModel* m = getModel(_hostElasticElementModel[k]);
+		Vector4i indices = m->getTetElement(_hostElasticElementId[k]);
+		hostTetElementIndices[4 * k] = m->getTetPointOverallId(indices.data()[0]);
+		hostTetElementIndices[4 * k + 1] = m->getTetPointOverallId(indices.data()[1]);
+		hostTetElementIndices[4 * k + 2] = m->getTetPointOverallId(indices.data()[2]);
+		hostTetElementIndices[4 * k + 3] = m->getTetPointOverallId(indices.data()[3]);
 	}
 
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementIndices, 4 * totalTetElementNum * sizeof(int))); gpuSize += 4 * totalTetElementNum * sizeof(int);
-	CUDA_CALL(cudaMemcpy(_devTetElementIndices, hostTetElementIndices.data(), 4 * totalTetElementNum * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementIndices, 4 * _hostElasticElementNum * sizeof(int))); gpuSize += 4 * _hostElasticElementNum * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devTetElementIndices, hostTetElementIndices.data(), 4 * _hostElasticElementNum * sizeof(int), cudaMemcpyHostToDevice));
 
 
 	std::vector<int> hostTetPointsSharedElementNum(totalTetPointsNum);
 	std::vector<int> hostTetPointsSharedElementOffset(totalTetPointsNum);
 	std::vector<std::vector<int>> hostTetPointsSharedElementList(totalTetPointsNum);
 
-	for (int i = 0; i < models.size(); i++)
+	for (int k = 0; k < _hostElasticElementNum; k++)
 	{
-		BaseModel* m = models[i];
-		for (int j = 0; j < m->tetElementNum; j++)
+		for (int j = 0; j < 4; j++)
 		{
-			int geleId = m->getTetElementOverallId(j);
-			Vector4i indices = m->getTetElement(j);
-			for (int k = 0; k < 4; k++)
-			{
-				int gvid = m->getTetPointOverallId(indices.data()[k]);
-				hostTetPointsSharedElementList[gvid].push_back(geleId);
-				hostTetPointsSharedElementList[gvid].push_back(k);
-			}
+			int gvid = hostTetElementIndices[4 * k + j];
+			hostTetPointsSharedElementList[gvid].push_back(k);
+			hostTetPointsSharedElementList[gvid].push_back(j);
 		}
 	}
 
@@ -710,36 +1721,33 @@ void MIPC::MipcSimulator::initCudaTetMeshMemory()
 	CUDA_CALL(cudaMalloc((void**)&_devTetPointsSharedElementList, flatTetPointsSharedElementList.size() * sizeof(int))); gpuSize += flatTetPointsSharedElementList.size() * sizeof(int);
 	CUDA_CALL(cudaMemcpy(_devTetPointsSharedElementList, flatTetPointsSharedElementList.data(), flatTetPointsSharedElementList.size() * sizeof(int), cudaMemcpyHostToDevice));
 
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementX, 12 * totalTetElementNum * sizeof(qeal))); gpuSize += 12 * totalTetElementNum * sizeof(qeal);
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementX, 12 * _hostElasticElementNum * sizeof(qeal))); gpuSize += 12 * _hostElasticElementNum * sizeof(qeal);
 
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementPotentialEnergy, totalTetElementNum * sizeof(qeal))); gpuSize += totalTetElementNum * sizeof(qeal);
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementPotentialEnergy, _hostElasticElementNum * sizeof(qeal))); gpuSize += _hostElasticElementNum * sizeof(qeal);
 
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementSizeOne, totalTetElementNum * sizeof(qeal))); gpuSize += totalTetElementNum * sizeof(qeal);
-	VectorX hostTetElementSizeOne(totalTetElementNum);
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementSizeOne, _hostElasticElementNum * sizeof(qeal))); gpuSize += _hostElasticElementNum * sizeof(qeal);
+	VectorX hostTetElementSizeOne(_hostElasticElementNum);
 	hostTetElementSizeOne.setOnes();
-	CUDA_CALL(cudaMemcpy(_devTetElementSizeOne, hostTetElementSizeOne.data(), totalTetElementNum * sizeof(qeal), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMemcpy(_devTetElementSizeOne, hostTetElementSizeOne.data(), _hostElasticElementNum * sizeof(qeal), cudaMemcpyHostToDevice));
 
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementForce, 12 * totalTetElementNum * sizeof(qeal))); gpuSize += 12 * totalTetElementNum * sizeof(qeal);
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementForce, 12 * _hostElasticElementNum * sizeof(qeal))); gpuSize += 12 * _hostElasticElementNum * sizeof(qeal);
 
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementStiffness, 144 * totalTetElementNum * sizeof(qeal))); gpuSize += 144 * totalTetElementNum * sizeof(qeal);
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementdPdF, 81 * totalTetElementNum * sizeof(qeal))); gpuSize += 81 * totalTetElementNum * sizeof(qeal);
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementdFPK, 9 * totalTetElementNum * sizeof(qeal))); gpuSize += 9 * totalTetElementNum * sizeof(qeal);
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementStiffness, 144 * _hostElasticElementNum * sizeof(qeal))); gpuSize += 144 * _hostElasticElementNum * sizeof(qeal);
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementdPdF, 81 * _hostElasticElementNum * sizeof(qeal))); gpuSize += 81 * _hostElasticElementNum * sizeof(qeal);
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementdFPK, 9 * _hostElasticElementNum * sizeof(qeal))); gpuSize += 9 * _hostElasticElementNum * sizeof(qeal);
 
-	std::vector<qeal> tempBuffer0(9 * totalTetElementNum);
-	std::vector<qeal> tempBuffer1(9 * totalTetElementNum);
-	for (int mid = 0; mid < models.size(); mid++)
+	std::vector<qeal> tempBuffer0(9 * _hostElasticElementNum);
+	std::vector<qeal> tempBuffer1(9 * _hostElasticElementNum);
+	for (int k = 0; k < _hostElasticElementNum; k++)
 	{
-		MipcModel* m = getModel(mid);
-		for (int eid = 0; eid < m->tetElementNum; eid++)
-		{
-			int geid = m->getTetElementOverallId(eid);
-			BaseTetElementParam* para = m->getTetMeshHandle()->getTetElementParam(eid);
-			Matrix3 Dm, invDm;
-			Dm = para->Dm;
-			invDm = para->invDm;
-			std::copy(Dm.data(), Dm.data() + 9, tempBuffer0.data() + 9 * geid);
-			std::copy(invDm.data(), invDm.data() + 9, tempBuffer1.data() + 9 * geid);
-		}
+		MipcModel* m = getModel(_hostElasticElementModel[k]);
+		int eid = _hostElasticElementId[k];
+		BaseTetElementParam* para = m->getTetMeshHandle()->getTetElementParam(eid);
+		Matrix3 Dm, invDm;
+		Dm = para->Dm;
+		invDm = para->invDm;
+		std::copy(Dm.data(), Dm.data() + 9, tempBuffer0.data() + 9 * k);
+		std::copy(invDm.data(), invDm.data() + 9, tempBuffer1.data() + 9 * k);
 	}
 
 	CUDA_CALL(cudaMalloc((void**)&_devTetElementDm, tempBuffer0.size() * sizeof(qeal))); gpuSize += tempBuffer0.size() * sizeof(qeal);
@@ -748,27 +1756,24 @@ void MIPC::MipcSimulator::initCudaTetMeshMemory()
 	CUDA_CALL(cudaMalloc((void**)&_devTetElementInvDm, tempBuffer1.size() * sizeof(qeal))); gpuSize += tempBuffer1.size() * sizeof(qeal);
 	CUDA_CALL(cudaMemcpy(_devTetElementInvDm, tempBuffer1.data(), tempBuffer1.size() * sizeof(qeal), cudaMemcpyHostToDevice));
 
-	tempBuffer0.resize(9 * 12 * totalTetElementNum);
-	tempBuffer1.resize(3 * totalTetElementNum);
-	for (int mid = 0; mid < models.size(); mid++)
+	tempBuffer0.resize(9 * 12 * _hostElasticElementNum);
+	tempBuffer1.resize(3 * _hostElasticElementNum);
+	for (int k = 0; k < _hostElasticElementNum; k++)
 	{
-		MipcModel* m = getModel(mid);
-		for (int eid = 0; eid < m->tetElementNum; eid++)
-		{
-			int geid = m->getTetElementOverallId(eid);
-			BaseTetElementParam* para = m->getTetMeshHandle()->getTetElementParam(eid);
-			MatrixX dFdu = m->getTetMeshHandle()->getTetElementParam(eid)->dFdu;
-			std::copy(dFdu.data(), dFdu.data() + 108, tempBuffer0.data() + 108 * geid);
-
-			qeal volume = para->volume;
-			ENuMaterial * material = downcastENuMaterial(m->getTetMeshHandle()->getElementMaterial(eid));
-
-			qeal lameMiu = material->getMu();
-			qeal lameLamda = material->getLambda();
-			tempBuffer1[3 * geid] = volume;
-			tempBuffer1[3 * geid + 1] = lameMiu;
-			tempBuffer1[3 * geid + 2] = lameLamda;
-		}
+		MipcModel* m = getModel(_hostElasticElementModel[k]);
+		int eid = _hostElasticElementId[k];
+		BaseTetElementParam* para = m->getTetMeshHandle()->getTetElementParam(eid);
+		MatrixX dFdu = m->getTetMeshHandle()->getTetElementParam(eid)->dFdu;
+		std::copy(dFdu.data(), dFdu.data() + 108, tempBuffer0.data() + 108 * k);
+
+		qeal volume = _hostElasticElementWeight[k] * para->volume;
+		ENuMaterial * material = downcastENuMaterial(m->getTetMeshHandle()->getElementMaterial(eid));
+
+		qeal lameMiu = material->getMu();
+		qeal lameLamda = material->getLambda();
+		tempBuffer1[3 * k] = volume;
+		tempBuffer1[3 * k + 1] = lameMiu;
+		tempBuffer1[3 * k + 2] = lameLamda;
 	}
 
 	CUDA_CALL(cudaMalloc((void**)&_devTetElementdFdu, tempBuffer0.size() * sizeof(qeal))); gpuSize += tempBuffer0.size() * sizeof(qeal);
@@ -777,19 +1782,15 @@ void MIPC::MipcSimulator::initCudaTetMeshMemory()
 	CUDA_CALL(cudaMalloc((void**)&_devTetElementAttri, tempBuffer1.size() * sizeof(qeal))); gpuSize += tempBuffer1.size() * sizeof(qeal);
 	CUDA_CALL(cudaMemcpy(_devTetElementAttri, tempBuffer1.data(), tempBuffer1.size() * sizeof(qeal), cudaMemcpyHostToDevice));
 
-	std::vector<qeal> tetElementVol(totalTetElementNum);
-	for (size_t i = 0; i < models.size(); i++)
+	std::vector<qeal> tetElementVol(_hostElasticElementNum);
+	for (int k = 0; k < _hostElasticElementNum; k++)
 	{
-		BaseModel* m = getModel(i);
-		for (size_t eid = 0; eid < m->tetElementNum; eid++)
-		{
-			int geid = m->getTetElementOverallId(eid);
-			qeal v = m->getTetMeshHandle()->getTetElementParam(eid)->volume;
-			tetElementVol[geid] = v;
-		}
+		MipcModel* m = getModel(_hostElasticElementModel[k]);
+		qeal v = m->getTetMeshHandle()->getTetElementParam(_hostElasticElementId[k])->volume;
+		tetElementVol[k] = _hostElasticElementWeight[k] * v;
 	}
 
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementVol, totalTetElementNum * sizeof(qeal))); gpuSize += totalTetElementNum * sizeof(qeal);
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementVol, _hostElasticElementNum * sizeof(qeal))); gpuSize += _hostElasticElementNum * sizeof(qeal);
 	CUDA_CALL(cudaMemcpy(_devTetElementVol, tetElementVol.data(), tetElementVol.size() * sizeof(qeal), cudaMemcpyHostToDevice));
 }
 
@@ -797,8 +1798,12 @@ void MIPC::MipcSimulator::initCudaMedialMeshMemory()
 {
 	CUDA_CALL(cudaMalloc((void**)&_devMedialPointsNum, sizeof(int))); gpuSize += sizeof(int);
 	CUDA_CALL(cudaMemcpy(_devMedialPointsNum, &totalMedialPoinsNum, sizeof(int), cudaMemcpyHostToDevice));
-	CUDA_CALL(cudaMalloc((void**)&_devMedialOriPointPosition, 3 * totalMedialPoinsNum * sizeof(qeal))); gpuSize += 3 * totalMedialPoinsNum * sizeof(qeal);
-	CUDA_CALL(cudaMemcpy(_devMedialOriPointPosition, medialPointsBuffer.buffer.data(), 3 * totalMedialPoinsNum * sizeof(qeal), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devFrameBatchPointId, _hostFrameBatchPointId.size() * sizeof(int))); gpuSize += _hostFrameBatchPointId.size() * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devFrameBatchPointId, _hostFrameBatchPointId.data(), _hostFrameBatchPointId.size() * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devFrameBatchReducedOffset, _hostFrameBatchReducedOffset.size() * sizeof(int))); gpuSize += _hostFrameBatchReducedOffset.size() * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devFrameBatchReducedOffset, _hostFrameBatchReducedOffset.data(), _hostFrameBatchReducedOffset.size() * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devFrameBatchRestPosition, _hostFrameBatchRestPosition.size() * sizeof(qeal))); gpuSize += _hostFrameBatchRestPosition.size() * sizeof(qeal);
+	CUDA_CALL(cudaMemcpy(_devFrameBatchRestPosition, _hostFrameBatchRestPosition.data(), _hostFrameBatchRestPosition.size() * sizeof(qeal), cudaMemcpyHostToDevice));
 	CUDA_CALL(cudaMalloc((void**)&_devMedialPointPosition, 3 * totalMedialPoinsNum * sizeof(qeal))); gpuSize += 3 * totalMedialPoinsNum * sizeof(qeal);
 	CUDA_CALL(cudaMemcpy(_devMedialPointPosition, medialPointsBuffer.buffer.data(), 3 * totalMedialPoinsNum * sizeof(qeal), cudaMemcpyHostToDevice));
 
@@ -813,6 +1818,8 @@ void MIPC::MipcSimulator::initCudaMedialMeshMemory()
 	CUDA_CALL(cudaMemcpy(_devStaticMedialPointRadius, staticModelPool.medialRadiusBuffer.buffer.data(), staticModelPool.totalMedialPoinsNum * sizeof(qeal), cudaMemcpyHostToDevice));
 
 	CUDA_CALL(cudaMalloc((void**)&_devMedialPointMovingDir, 3 * totalMedialPoinsNum * sizeof(qeal))); gpuSize += 3 * totalMedialPoinsNum * sizeof(qeal);
+	// points without a non-static frame are never written by transformReducedFrames
+	CUDA_CALL(cudaMemset(_devMedialPointMovingDir, 0, 3 * totalMedialPoinsNum * sizeof(qeal)));
 }
 
 void MIPC::MipcSimulator::initCudaGeneralSysMemory()
@@ -885,6 +1892,9 @@ void MIPC::MipcSimulator::initCudaGeneralSysMemory()
 	CUDA_CALL(cudaMalloc((void**)&_devReducedRhs, _sysReducedDim * sizeof(qeal))); gpuSize += _sysReducedDim * sizeof(qeal);
 
 
+	// the sparse system keeps mass and stiffness on its csr pattern only (initCudaSparseSysMemory)
+	if (_sysMatType == SPARSE)
+		return;
 	CUDA_CALL(cudaMalloc((void**)&_devReducedMassMatrix, _sysReducedMass.size() * sizeof(qeal))); gpuSize += _sysReducedMass.size() * sizeof(qeal);
 	CUDA_CALL(cudaMemcpy(_devReducedMassMatrix, _sysReducedMass.data(), _sysReducedMass.size() * sizeof(qeal), cudaMemcpyHostToDevice));
 
@@ -894,7 +1904,6 @@ void MIPC::MipcSimulator::initCudaGeneralSysMemory()
 
 void MIPC::MipcSimulator::initCudaReducedProjectionMemory()
 {
-	int bufferOffset = 0;
 	CUDA_CALL(cudaMalloc((void**)&_devNonStaticFramesNum, sizeof(int))); gpuSize += sizeof(int);
 	CUDA_CALL(cudaMemcpy(_devNonStaticFramesNum, &_nonStaticFramesNum, sizeof(int), cudaMemcpyHostToDevice));
 
@@ -907,180 +1916,186 @@ void MIPC::MipcSimulator::initCudaReducedProjectionMemory()
 		MipcModel* m = getModel(i);
 		_hostTetPointXOffset[i] = m->tetPoints.offset;
 		_hostTetElementXOffset[i] = m->tetElementIndices.offset * 3;
-		ReducedFrame* frame = m->getReducedFrame(0);
-		_hostFrameBufferOffset[i] = frame->getOffset();
-		_hostFrameBufferDim[i] = m->getNonStaticFramesNum() * 12;
+		_hostFrameBufferOffset[i] = _sysReducedOffsetByModel[i];
+		_hostFrameBufferDim[i] = m->getReducedDim();
 	}
 	//
-	_devTetPointProjectionXYZ.resize(models.size());
-	_hostTetPointProjectionRowsXYZ.resize(models.size());
-	_hostTetPointProjectionColsXYZ.resize(models.size());
-
 	std::vector<MatrixX> hostTetElementProjection(models.size());
 	_devTetElementProjectionXYZ.resize(models.size());
 	_hostTetElementProjectionRowsXYZ.resize(models.size());
 	_hostTetElementProjectionColsXYZ.resize(models.size());
 
+	// compact projection, every tet point only stores the coefficients (w * x, w * y, w * z, w for linear frames) of the frames it has nonzero weights on,
+	// the reduced entry 3 * c + axis of a frame is scaled by its c-th coefficient
+	_hostTetPointFrameProjectionNum.resize(totalTetPointsNum, 0);
+	_hostTetPointFrameProjectionOffset.resize(totalTetPointsNum, 0);
+	_hostFrameReducedOffset.resize(_nonStaticFramesNum, 0);
+	_hostFrameCoeffNum.resize(_nonStaticFramesNum, 0);
+	std::vector<std::vector<int>> frameTetPointList(_nonStaticFramesNum);
+	std::vector<std::vector<qeal>> frameTetPointBuffer(_nonStaticFramesNum);
 	for (int i = 0; i < models.size(); i++)
 	{
 		MipcModel* m = getModel(i);
-		int sub_rows_size;
-		int sub_cols_size;
-		MatrixX reducedProjection = m->getReducedProjection();
-		MatrixX sysProjectMatrixX;
-
-		sub_rows_size = reducedProjection.rows() / 3;
-		sub_cols_size = reducedProjection.cols() / 3;
-		sysProjectMatrixX.resize(sub_rows_size, sub_cols_size);
-		sysProjectMatrixX.setZero();
+		for (int j = 0; j < m->getNonStaticFramesNum(); j++)
+		{
+			ReducedFrame* frame = m->getNonStaticFrame(j);
+			_hostFrameReducedOffset[frame->getFrameId()] = frame->getOffset();
+			_hostFrameCoeffNum[frame->getFrameId()] = frame->getDim() / 3;
+		}
 
-		for (uint32_t i = 0; i < sub_rows_size; i++)
+		for (int j = 0; j < m->tetPointsNum; j++)
 		{
-			for (uint32_t j = 0; j < sub_cols_size; j++)
+			int gid = m->getTetPointOverallId(j);
+			Vector3 p = m->getTetPoint(j);
+			_hostTetPointFrameProjectionOffset[gid] = _hostTetPointFrameProjectionFrame.size();
+			for (MipcModel::SparseWeightMatrix::InnerIterator it(m->_harmonicWeight, j); it; ++it)
 			{
-				qeal val_x = reducedProjection(3 * i, 3 * j);
-				sysProjectMatrixX(i, j) = val_x;
+				ReducedFrame* frame = m->getNonStaticFrame(it.col());
+				MatrixX u = frame->getUMatrix(p.data(), it.value());
+				int coeffNum = u.cols() / 3;
+				_hostTetPointFrameProjectionFrame.push_back(frame->getOffset());
+				_hostTetPointFrameProjectionCoeffNum.push_back(coeffNum);
+				_hostTetPointFrameProjectionBufferOffset.push_back(_hostTetPointFrameProjectionBuffer.size());
+				frameTetPointList[frame->getFrameId()].push_back(gid);
+				for (int k = 0; k < coeffNum; k++)
+				{
+					_hostTetPointFrameProjectionBuffer.push_back(u(0, 3 * k));
+					frameTetPointBuffer[frame->getFrameId()].push_back(u(0, 3 * k));
+				}
+				_hostTetPointFrameProjectionNum[gid]++;
 			}
 		}
-
-		CUDA_CALL(cudaMalloc((void**)&_devTetPointProjectionXYZ[i], sysProjectMatrixX.size() * sizeof(qeal))); gpuSize += sysProjectMatrixX.size() * sizeof(qeal);
-		CUDA_CALL(cudaMemcpy(_devTetPointProjectionXYZ[i], sysProjectMatrixX.data(), sysProjectMatrixX.size() * sizeof(qeal), cudaMemcpyHostToDevice));
-
-		_hostTetPointProjectionRowsXYZ[i] = sub_rows_size;
-		_hostTetPointProjectionColsXYZ[i] = sub_cols_size;
 	}
 
-	bufferOffset = 0;
-	int bufferCount = 0;
-	std::vector<int>_hostTetElementFrameProjectionBufferNum;
-	std::vector<int>_hostTetElementFrameProjectionBufferOffset;
-	_hostTetElementFrameProjectionBufferNum.resize(totalTetElementNum, 0);
-	_hostTetElementFrameProjectionBufferOffset.resize(totalTetElementNum, 0);
-	std::vector<qeal> hostTetElementFrameWeightList;
-
-	for (int i = 0; i < models.size(); i++)
+	_hostFrameTetPointProjectionNum.resize(_nonStaticFramesNum, 0);
+	_hostFrameTetPointProjectionOffset.resize(_nonStaticFramesNum, 0);
+	_hostFrameTetPointProjectionBufferOffset.resize(_nonStaticFramesNum, 0);
+	for (int i = 0; i < _nonStaticFramesNum; i++)
 	{
-		MipcModel* m = getModel(i);
-		for (int eleId = 0; eleId < m->tetElementNum; eleId++)
-		{
-			int geleId = m->getTetElementOverallId(eleId);
-			std::set<int>::iterator it = m->_tetElementShareFramesList[eleId].begin();
+		_hostFrameTetPointProjectionNum[i] = frameTetPointList[i].size();
+		_hostFrameTetPointProjectionOffset[i] = _hostFrameTetPointProjectionPoint.size();
+		_hostFrameTetPointProjectionBufferOffset[i] = _hostFrameTetPointProjectionBuffer.size();
+		_hostFrameTetPointProjectionPoint.insert(_hostFrameTetPointProjectionPoint.end(), frameTetPointList[i].begin(), frameTetPointList[i].end());
+		_hostFrameTetPointProjectionBuffer.insert(_hostFrameTetPointProjectionBuffer.end(), frameTetPointBuffer[i].begin(), frameTetPointBuffer[i].end());
+	}
 
-			Vector4i ele = m->getTetElement(eleId);
-			Vector3 v0 = m->getTetPoint(ele[0]);
-			Vector3 v1 = m->getTetPoint(ele[1]);
-			Vector3 v2 = m->getTetPoint(ele[2]);
-			Vector3 v3 = m->getTetPoint(ele[3]);
+	CUDA_CALL(cudaMalloc((void**)&_devTetPointFrameProjectionNum, totalTetPointsNum * sizeof(int))); gpuSize += totalTetPointsNum * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devTetPointFrameProjectionNum, _hostTetPointFrameProjectionNum.data(), totalTetPointsNum * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devTetPointFrameProjectionOffset, totalTetPointsNum * sizeof(int))); gpuSize += totalTetPointsNum * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devTetPointFrameProjectionOffset, _hostTetPointFrameProjectionOffset.data(), totalTetPointsNum * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devTetPointFrameProjectionFrame, _hostTetPointFrameProjectionFrame.size() * sizeof(int))); gpuSize += _hostTetPointFrameProjectionFrame.size() * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devTetPointFrameProjectionFrame, _hostTetPointFrameProjectionFrame.data(), _hostTetPointFrameProjectionFrame.size() * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devTetPointFrameProjectionCoeffNum, _hostTetPointFrameProjectionCoeffNum.size() * sizeof(int))); gpuSize += _hostTetPointFrameProjectionCoeffNum.size() * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devTetPointFrameProjectionCoeffNum, _hostTetPointFrameProjectionCoeffNum.data(), _hostTetPointFrameProjectionCoeffNum.size() * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devTetPointFrameProjectionBufferOffset, _hostTetPointFrameProjectionBufferOffset.size() * sizeof(int))); gpuSize += _hostTetPointFrameProjectionBufferOffset.size() * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devTetPointFrameProjectionBufferOffset, _hostTetPointFrameProjectionBufferOffset.data(), _hostTetPointFrameProjectionBufferOffset.size() * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devTetPointFrameProjectionBuffer, _hostTetPointFrameProjectionBuffer.size() * sizeof(qeal))); gpuSize += _hostTetPointFrameProjectionBuffer.size() * sizeof(qeal);
+	CUDA_CALL(cudaMemcpy(_devTetPointFrameProjectionBuffer, _hostTetPointFrameProjectionBuffer.data(), _hostTetPointFrameProjectionBuffer.size() * sizeof(qeal), cudaMemcpyHostToDevice));
+
+	CUDA_CALL(cudaMalloc((void**)&_devFrameReducedOffset, _nonStaticFramesNum * sizeof(int))); gpuSize += _nonStaticFramesNum * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devFrameReducedOffset, _hostFrameReducedOffset.data(), _nonStaticFramesNum * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devFrameCoeffNum, _nonStaticFramesNum * sizeof(int))); gpuSize += _nonStaticFramesNum * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devFrameCoeffNum, _hostFrameCoeffNum.data(), _nonStaticFramesNum * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devFrameTetPointProjectionNum, _nonStaticFramesNum * sizeof(int))); gpuSize += _nonStaticFramesNum * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devFrameTetPointProjectionNum, _hostFrameTetPointProjectionNum.data(), _nonStaticFramesNum * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devFrameTetPointProjectionOffset, _nonStaticFramesNum * sizeof(int))); gpuSize += _nonStaticFramesNum * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devFrameTetPointProjectionOffset, _hostFrameTetPointProjectionOffset.data(), _nonStaticFramesNum * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devFrameTetPointProjectionBufferOffset, _nonStaticFramesNum * sizeof(int))); gpuSize += _nonStaticFramesNum * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devFrameTetPointProjectionBufferOffset, _hostFrameTetPointProjectionBufferOffset.data(), _nonStaticFramesNum * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devFrameTetPointProjectionPoint, _hostFrameTetPointProjectionPoint.size() * sizeof(int))); gpuSize += _hostFrameTetPointProjectionPoint.size() * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devFrameTetPointProjectionPoint, _hostFrameTetPointProjectionPoint.data(), _hostFrameTetPointProjectionPoint.size() * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devFrameTetPointProjectionBuffer, _hostFrameTetPointProjectionBuffer.size() * sizeof(qeal))); gpuSize += _hostFrameTetPointProjectionBuffer.size() * sizeof(qeal);
+	CUDA_CALL(cudaMemcpy(_devFrameTetPointProjectionBuffer, _hostFrameTetPointProjectionBuffer.data(), _hostFrameTetPointProjectionBuffer.size() * sizeof(qeal), cudaMemcpyHostToDevice));
+
+	// per (elastic element, shared frame) the coefficients of the frame at the four tet vertices, coefficient a of vertex v at 4 * a + v,
+	// 4 for linear, 10 for quadratic and 1 for translation frames, in the order of _tetElementShareFramesList
+	std::vector<int> hostTetElementFrameProjectionCoeffNum;
+	std::vector<int> hostTetElementFrameProjectionBufferOffset;
+	std::vector<qeal> hostTetElementFrameProjectionBuffer;
+	_hostAssembleBlockDim = 3;
+	for (int geleId = 0; geleId < _hostElasticElementNum; geleId++)
+	{
+		MipcModel* m = getModel(_hostElasticElementModel[geleId]);
+		int eleId = _hostElasticElementId[geleId];
+		Vector4i ele = m->getTetElement(eleId);
 
-			int num = 0;
-			for (; it != m->_tetElementShareFramesList[eleId].end(); ++it)
+		std::set<int>::iterator it = m->_tetElementShareFramesList[eleId].begin();
+		for (; it != m->_tetElementShareFramesList[eleId].end(); ++it)
+		{
+			ReducedFrame* frame = m->getNonStaticFrame(*it);
+			int coeffNum = frame->getDim() / 3;
+			hostTetElementFrameProjectionCoeffNum.push_back(coeffNum);
+			hostTetElementFrameProjectionBufferOffset.push_back(hostTetElementFrameProjectionBuffer.size());
+			_hostAssembleBlockDim = std::max(_hostAssembleBlockDim, frame->getDim());
+
+			std::vector<qeal> coeff(4 * coeffNum);
+			for (int v = 0; v < 4; v++)
 			{
-				ReducedFrame* frame = m->getReducedFrame(*it);
-				int gFrameId = frame->getFrameId();
-
-				qeal w0, w1, w2, w3;
-				w0 = m->_harmonicWeight.data()[(*it) * m->_harmonicWeight.rows() + ele[0]];
-				w1 = m->_harmonicWeight.data()[(*it) * m->_harmonicWeight.rows() + ele[1]];
-				w2 = m->_harmonicWeight.data()[(*it) * m->_harmonicWeight.rows() + ele[2]];
-				w3 = m->_harmonicWeight.data()[(*it) * m->_harmonicWeight.rows() + ele[3]];
-				hostTetElementFrameWeightList.push_back(w0);
-				hostTetElementFrameWeightList.push_back(w1);
-				hostTetElementFrameWeightList.push_back(w2);
-				hostTetElementFrameWeightList.push_back(w3);
-
-				bufferCount += 16;
-
-				num++;
+				Vector3 p = m->getTetPoint(ele[v]);
+				MatrixX u = frame->getUMatrix(p.data(), m->_harmonicWeight.coeff(ele[v], *it));
+				for (int k = 0; k < coeffNum; k++)
+					coeff[4 * k + v] = u(0, 3 * k);
 			}
-			_hostTetElementFrameProjectionBufferNum[geleId] = num;
-			_hostTetElementFrameProjectionBufferOffset[geleId] = bufferOffset;
-
-
-			bufferOffset += num;
+			hostTetElementFrameProjectionBuffer.insert(hostTetElementFrameProjectionBuffer.end(), coeff.begin(), coeff.end());
 		}
 	}
 
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementFrameProjectionNum, _hostTetElementFrameProjectionBufferNum.size() * sizeof(int))); gpuSize += _hostTetElementFrameProjectionBufferNum.size() * sizeof(int);
-	CUDA_CALL(cudaMemcpy(_devTetElementFrameProjectionNum, _hostTetElementFrameProjectionBufferNum.data(), _hostTetElementFrameProjectionBufferNum.size() * sizeof(int), cudaMemcpyHostToDevice));
-
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementFrameProjectionOffset, _hostTetElementFrameProjectionBufferOffset.size() * sizeof(int))); gpuSize += _hostTetElementFrameProjectionBufferOffset.size() * sizeof(int);
-	CUDA_CALL(cudaMemcpy(_devTetElementFrameProjectionOffset, _hostTetElementFrameProjectionBufferOffset.data(), _hostTetElementFrameProjectionBufferOffset.size() * sizeof(int), cudaMemcpyHostToDevice));
-
-	CUDA_CALL(cudaMalloc((void**)&_devTetElementFrameProjectionBuffer, bufferCount * sizeof(qeal))); gpuSize += bufferCount * sizeof(qeal);
-
-	qeal* devTetPoints;
-	CUDA_CALL(cudaMalloc((void**)&devTetPoints, 3 * totalTetPointsNum * sizeof(qeal))); gpuSize += 3 * totalTetPointsNum * sizeof(qeal);
-	CUDA_CALL(cudaMemcpy(devTetPoints, tetPointsBuffer.buffer.data(), 3 * totalTetPointsNum * sizeof(qeal), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementFrameProjectionCoeffNum, hostTetElementFrameProjectionCoeffNum.size() * sizeof(int))); gpuSize += hostTetElementFrameProjectionCoeffNum.size() * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devTetElementFrameProjectionCoeffNum, hostTetElementFrameProjectionCoeffNum.data(), hostTetElementFrameProjectionCoeffNum.size() * sizeof(int), cudaMemcpyHostToDevice));
 
-	qeal* devTetElementFrameWeightList;
-	CUDA_CALL(cudaMalloc((void**)&devTetElementFrameWeightList, hostTetElementFrameWeightList.size() * sizeof(qeal))); gpuSize += hostTetElementFrameWeightList.size() * sizeof(qeal);
-	CUDA_CALL(cudaMemcpy(devTetElementFrameWeightList, hostTetElementFrameWeightList.data(), hostTetElementFrameWeightList.size() * sizeof(qeal), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementFrameProjectionBufferOffset, hostTetElementFrameProjectionBufferOffset.size() * sizeof(int))); gpuSize += hostTetElementFrameProjectionBufferOffset.size() * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devTetElementFrameProjectionBufferOffset, hostTetElementFrameProjectionBufferOffset.data(), hostTetElementFrameProjectionBufferOffset.size() * sizeof(int), cudaMemcpyHostToDevice));
 
-	fillTetElementFrameProjectionBuffer
-	(
-		totalTetElementNum,
-		_devTotalTetElementNum,
-		_devTetElementIndices,
-		devTetPoints,
-		devTetElementFrameWeightList,
-		_devTetElementFrameProjectionNum,
-		_devTetElementFrameProjectionOffset,
-		_devTetElementFrameProjectionBuffer
-	);
-	cudaFree(devTetPoints);
-	cudaFree(devTetElementFrameWeightList);
+	CUDA_CALL(cudaMalloc((void**)&_devTetElementFrameProjectionBuffer, hostTetElementFrameProjectionBuffer.size() * sizeof(qeal))); gpuSize += hostTetElementFrameProjectionBuffer.size() * sizeof(qeal);
+	CUDA_CALL(cudaMemcpy(_devTetElementFrameProjectionBuffer, hostTetElementFrameProjectionBuffer.data(), hostTetElementFrameProjectionBuffer.size() * sizeof(qeal), cudaMemcpyHostToDevice));
 
 	//
 	_hostPojectionStiffnessNum = 0;
 	std::vector<int> hostPojectionStiffnessList;
-	std::vector<std::vector<int>> tetElementSharedFrameList(totalTetElementNum);
+	std::vector<std::vector<int>> tetElementSharedFrameList(_hostElasticElementNum);
 	std::vector<int> hostTetElementSharedFrameList;
-	std::vector<int> hostTetElementSharedFrameNum(totalTetElementNum);
-	std::vector<int> hostTetElementSharedFrameOffset(totalTetElementNum);
+	std::vector<int> hostTetElementSharedFrameNum(_hostElasticElementNum);
+	std::vector<int> hostTetElementSharedFrameOffset(_hostElasticElementNum);
 
-	for (int mid = 0; mid < models.size(); mid++)
+	for (int geleId = 0; geleId < _hostElasticElementNum; geleId++)
 	{
-		MipcModel* m = getModel(mid);
-
-		for (int eleId = 0; eleId < m->tetElementNum; eleId++)
+		MipcModel* m = getModel(_hostElasticElementModel[geleId]);
+		int eleId = _hostElasticElementId[geleId];
+		std::set<int>::iterator it = m->_tetElementShareFramesList[eleId].begin();
+		for (; it != m->_tetElementShareFramesList[eleId].end(); ++it)
 		{
-			int geleId = m->getTetElementOverallId(eleId);
-			std::set<int>::iterator it = m->_tetElementShareFramesList[eleId].begin();
-			for (; it != m->_tetElementShareFramesList[eleId].end(); ++it)
-			{
-				int frameIndex = *it;
-				int frameId = m->getReducedFrame(*it)->getFrameId();
-				tetElementSharedFrameList[geleId].push_back(frameId);
-			}
+			int frameIndex = *it;
+			int frameId = m->getNonStaticFrame(*it)->getFrameId();
+			tetElementSharedFrameList[geleId].push_back(frameId);
+		}
 
-			hostTetElementSharedFrameNum[geleId] = tetElementSharedFrameList[geleId].size();
-			hostTetElementSharedFrameOffset[geleId] = hostTetElementSharedFrameList.size();
+		hostTetElementSharedFrameNum[geleId] = tetElementSharedFrameList[geleId].size();
+		hostTetElementSharedFrameOffset[geleId] = hostTetElementSharedFrameList.size();
 
-			for (int i = 0; i < tetElementSharedFrameList[geleId].size(); i++)
-			{
-				int iFrameId = tetElementSharedFrameList[geleId][i];
+		for (int i = 0; i < tetElementSharedFrameList[geleId].size(); i++)
+		{
+			int iFrameId = tetElementSharedFrameList[geleId][i];
 
-				hostTetElementSharedFrameList.push_back(iFrameId);
+			hostTetElementSharedFrameList.push_back(iFrameId);
 
-				hostPojectionStiffnessList.push_back(geleId);
-				hostPojectionStiffnessList.push_back(i);
-				hostPojectionStiffnessList.push_back(i);
+			hostPojectionStiffnessList.push_back(geleId);
+			hostPojectionStiffnessList.push_back(i);
+			hostPojectionStiffnessList.push_back(i);
 
-				for (int j = i + 1; j < tetElementSharedFrameList[geleId].size(); j++)
+			for (int j = i + 1; j < tetElementSharedFrameList[geleId].size(); j++)
+			{
+				int jFrameId = tetElementSharedFrameList[geleId][j];
+				if (iFrameId < jFrameId)
+				{
+					hostPojectionStiffnessList.push_back(geleId);
+					hostPojectionStiffnessList.push_back(i);
+					hostPojectionStiffnessList.push_back(j);
+				}
+				else
 				{
-					int jFrameId = tetElementSharedFrameList[geleId][j];
-					if (iFrameId < jFrameId)
-					{
-						hostPojectionStiffnessList.push_back(geleId);
-						hostPojectionStiffnessList.push_back(i);
-						hostPojectionStiffnessList.push_back(j);
-					}
-					else
-					{
-						hostPojectionStiffnessList.push_back(geleId);
-						hostPojectionStiffnessList.push_back(j);
-						hostPojectionStiffnessList.push_back(i);
-					}
+					hostPojectionStiffnessList.push_back(geleId);
+					hostPojectionStiffnessList.push_back(j);
+					hostPojectionStiffnessList.push_back(i);
 				}
 			}
 		}
@@ -1106,7 +2121,7 @@ void MIPC::MipcSimulator::initCudaReducedProjectionMemory()
 
 	for (uint32_t i = 0; i < _hostPojectionStiffnessNum; i++)
 	{
-		int eid = hostPojectionStiffnessList[3 * i]; // geid
+		int eid = hostPojectionStiffnessList[3 * i]; // index in the elastic element list
 		int ci = hostPojectionStiffnessList[3 * i + 1];
 		int cj = hostPojectionStiffnessList[3 * i + 2];
 
@@ -1115,7 +2130,7 @@ void MIPC::MipcSimulator::initCudaReducedProjectionMemory()
 
 		stiffnessBlockSharedTetElementList[jFrameId * _nonStaticFramesNum + iFrameId].push_back(i);
 	}
-	std::vector<int> hostAssembleBlockIndex;
+	_hostAssembleBlockIndex.clear();
 	std::vector<int> hoststiffnessBlockSharedTetElementList;
 	std::vector<int> hostStiffnessBlockSharedTetElementNum;
 	std::vector<int> hostStiffnessBlockSharedTetElementOffset;
@@ -1127,8 +2142,8 @@ void MIPC::MipcSimulator::initCudaReducedProjectionMemory()
 
 		int iFrameId = i % _nonStaticFramesNum;
 		int jFrameId = (i - iFrameId) / _nonStaticFramesNum;
-		hostAssembleBlockIndex.push_back(iFrameId);
-		hostAssembleBlockIndex.push_back(jFrameId);
+		_hostAssembleBlockIndex.push_back(iFrameId);
+		_hostAssembleBlockIndex.push_back(jFrameId);
 
 		int num = stiffnessBlockSharedTetElementList[i].size();
 		hostStiffnessBlockSharedTetElementNum.push_back(num);
@@ -1141,12 +2156,12 @@ void MIPC::MipcSimulator::initCudaReducedProjectionMemory()
 		}
 	}
 
-	_hostAssembleBlockNum = hostAssembleBlockIndex.size() / 2;
+	_hostAssembleBlockNum = _hostAssembleBlockIndex.size() / 2;
 	CUDA_CALL(cudaMalloc((void**)&_devAssembleBlockNum, sizeof(int))); gpuSize += sizeof(int);
 	CUDA_CALL(cudaMemcpy(_devAssembleBlockNum, &_hostAssembleBlockNum, sizeof(int), cudaMemcpyHostToDevice));
 
-	CUDA_CALL(cudaMalloc((void**)&_devAssembleBlockIndex, hostAssembleBlockIndex.size() * sizeof(int))); gpuSize += hostAssembleBlockIndex.size() * sizeof(int);
-	CUDA_CALL(cudaMemcpy(_devAssembleBlockIndex, hostAssembleBlockIndex.data(), hostAssembleBlockIndex.size() * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMalloc((void**)&_devAssembleBlockIndex, _hostAssembleBlockIndex.size() * sizeof(int))); gpuSize += _hostAssembleBlockIndex.size() * sizeof(int);
+	CUDA_CALL(cudaMemcpy(_devAssembleBlockIndex, _hostAssembleBlockIndex.data(), _hostAssembleBlockIndex.size() * sizeof(int), cudaMemcpyHostToDevice));
 
 	CUDA_CALL(cudaMalloc((void**)&_devStiffnessBlockSharedTetElementList, hoststiffnessBlockSharedTetElementList.size() * sizeof(int))); gpuSize += hoststiffnessBlockSharedTetElementList.size() * sizeof(int);
 	CUDA_CALL(cudaMemcpy(_devStiffnessBlockSharedTetElementList, hoststiffnessBlockSharedTetElementList.data(), hoststiffnessBlockSharedTetElementList.size() * sizeof(int), cudaMemcpyHostToDevice));
@@ -1158,9 +2173,176 @@ void MIPC::MipcSimulator::initCudaReducedProjectionMemory()
 	CUDA_CALL(cudaMemcpy(_devStiffnessBlockSharedTetElementOffset, hostStiffnessBlockSharedTetElementOffset.data(), hostStiffnessBlockSharedTetElementOffset.size() * sizeof(int), cudaMemcpyHostToDevice));
 }
 
+void MIPC::MipcSimulator::initCudaStVKPolynomialMemory()
+{
+	int maxDim = 0;
+	_devStVKK.resize(_hostStVKModel.size());
+	_devStVKV.resize(_hostStVKModel.size());
+	_devStVKW.resize(_hostStVKModel.size());
+	for (int s = 0; s < _hostStVKModel.size(); s++)
+	{
+		MipcModel* m = getModel(_hostStVKModel[s]);
+		CUDA_CALL(cudaMalloc((void**)&_devStVKK[s], m->_stvkK.size() * sizeof(qeal))); gpuSize += m->_stvkK.size() * sizeof(qeal);
+		CUDA_CALL(cudaMemcpy(_devStVKK[s], m->_stvkK.data(), m->_stvkK.size() * sizeof(qeal), cudaMemcpyHostToDevice));
+		CUDA_CALL(cudaMalloc((void**)&_devStVKV[s], m->_stvkV.size() * sizeof(qeal))); gpuSize += m->_stvkV.size() * sizeof(qeal);
+		CUDA_CALL(cudaMemcpy(_devStVKV[s], m->_stvkV.data(), m->_stvkV.size() * sizeof(qeal), cudaMemcpyHostToDevice));
+		CUDA_CALL(cudaMalloc((void**)&_devStVKW[s], m->_stvkW.size() * sizeof(qeal))); gpuSize += m->_stvkW.size() * sizeof(qeal);
+		CUDA_CALL(cudaMemcpy(_devStVKW[s], m->_stvkW.data(), m->_stvkW.size() * sizeof(qeal), cudaMemcpyHostToDevice));
+		maxDim = std::max(maxDim, m->getReducedDim());
+	}
+	int bufferSize = maxDim * maxDim * maxDim + 6 * maxDim * maxDim + 2 * maxDim;
+	CUDA_CALL(cudaMalloc((void**)&_devStVKBuffer, bufferSize * sizeof(qeal))); gpuSize += bufferSize * sizeof(qeal);
+	// the blocks coupling a stvk model to the others are never assembled
+	if (_sysMatType != SPARSE)
+		CUDA_CALL(cudaMemset(_devReducedStiffness, 0, _sysReducedDim * _sysReducedDim * sizeof(qeal)));
+}
+
 void MIPC::MipcSimulator::initCudaSparseSysMemory()
 {
-	// implement for sparse system
+	buildReducedSparsePattern();
+
+	CUDA_CALL(cudaMalloc((void**)&_devReducedSparseSysMatrixCsrNonZero, sizeof(int))); gpuSize += sizeof(int);
+	CUDA_CALL(cudaMalloc((void**)&_devReducedSparseSysMatrixCsrRowPtr, (_sysReducedDim + 1) * sizeof(int))); gpuSize += (_sysReducedDim + 1) * sizeof(int);
+	CUDA_CALL(cudaMalloc((void**)&_devAssembleBlockCsrSlot, 2 * _hostAssembleBlockNum * sizeof(int))); gpuSize += 2 * _hostAssembleBlockNum * sizeof(int);
+	uploadReducedSparsePattern();
+}
+
+void MIPC::MipcSimulator::buildReducedSparsePattern()
+{
+	// union pattern of the elastic blocks and every frame pair an event can couple,
+	// the collision & friction hessian is scattered into it directly
+	std::vector<int> frameOffset(_nonStaticFramesNum, 0);
+	std::vector<int> frameDim(_nonStaticFramesNum, 0);
+	for (int i = 0; i < _reducedFrameList.size(); i++)
+	{
+		ReducedFrame* frame = _reducedFrameList[i];
+		if (frame->getFrameType() == FrameType::STATIC)
+			continue;
+		frameOffset[frame->getFrameId()] = frame->getOffset();
+		frameDim[frame->getFrameId()] = frame->getDim();
+	}
+
+	std::vector<std::set<int>> frameNeighborList(_nonStaticFramesNum);
+	for (int i = 0; i < _nonStaticFramesNum; i++)
+		frameNeighborList[i].insert(i);
+	for (int i = 0; i < _hostAssembleBlockNum; i++)
+	{
+		int iFrameId = _hostAssembleBlockIndex[2 * i];
+		int jFrameId = _hostAssembleBlockIndex[2 * i + 1];
+		frameNeighborList[iFrameId].insert(jFrameId);
+		frameNeighborList[jFrameId].insert(iFrameId);
+	}
+	// the stvk polynomial couples every frame pair of its model
+	for (int s = 0; s < _hostStVKModel.size(); s++)
+	{
+		MipcModel* m = getModel(_hostStVKModel[s]);
+		for (int i = 0; i < m->getNonStaticFramesNum(); i++)
+			for (int j = 0; j < m->getNonStaticFramesNum(); j++)
+				frameNeighborList[m->getNonStaticFrame(i)->getFrameId()].insert(m->getNonStaticFrame(j)->getFrameId());
+	}
+	// with a broad phase every pooled event keeps a valid slot, not only the current candidates
+	std::vector<MipcConstraint*>& events = _broadPhase != ALL_PAIRS ? _broadPhaseEventPool : _overallCollisionEvents;
+	for (int i = 0; i < events.size(); i++)
+	{
+		MipcConstraint* event = events[i];
+		event->computeReducedFrameBlocks();
+		for (int c = 0; c < event->reducedFrameId.size(); c++)
+			for (int a = 0; a < event->reducedFrameId.size(); a++)
+				frameNeighborList[event->reducedFrameId[c]].insert(event->reducedFrameId[a]);
+	}
+
+	// frame offsets grow with frame id, so the sorted neighbor set gives sorted columns
+	std::vector<std::map<int, int>>& frameColumnSlot = _reducedSparseFrameColumnSlot;
+	frameColumnSlot.assign(_nonStaticFramesNum, std::map<int, int>());
+	_hostReducedSparseSysMatrixCsrRowPtr.resize(_sysReducedDim + 1);
+	_hostReducedSparseSysMatrixCsrColInd.clear();
+	int nnz = 0;
+	for (int f = 0; f < _nonStaticFramesNum; f++)
+	{
+		int rowLen = 0;
+		for (std::set<int>::iterator it = frameNeighborList[f].begin(); it != frameNeighborList[f].end(); ++it)
+		{
+			frameColumnSlot[f][*it] = rowLen;
+			rowLen += frameDim[*it];
+		}
+
+		for (int r = 0; r < frameDim[f]; r++)
+		{
+			_hostReducedSparseSysMatrixCsrRowPtr[frameOffset[f] + r] = nnz;
+			for (std::set<int>::iterator it = frameNeighborList[f].begin(); it != frameNeighborList[f].end(); ++it)
+				for (int k = 0; k < frameDim[*it]; k++)
+					_hostReducedSparseSysMatrixCsrColInd.push_back(frameOffset[*it] + k);
+			nnz += rowLen;
+		}
+	}
+	_hostReducedSparseSysMatrixCsrRowPtr[_sysReducedDim] = nnz;
+	_hostReducedSparseSysMatrixCsrNonZero = nnz;
+	_hostReducedSparseCFHessinaCsrVal.resize(nnz, 0.0);
+
+	// the reduced mass couples frames that share a tet point, so it lies inside the elastic blocks
+	_hostReducedSparseMassCsrVal.resize(nnz);
+	for (int r = 0; r < _sysReducedDim; r++)
+		for (int k = _hostReducedSparseSysMatrixCsrRowPtr[r]; k < _hostReducedSparseSysMatrixCsrRowPtr[r + 1]; k++)
+			_hostReducedSparseMassCsrVal[k] = _sysReducedMass(r, _hostReducedSparseSysMatrixCsrColInd[k]);
+
+	_hostAssembleBlockCsrSlot.resize(2 * _hostAssembleBlockNum);
+	for (int i = 0; i < _hostAssembleBlockNum; i++)
+	{
+		int iFrameId = _hostAssembleBlockIndex[2 * i];
+		int jFrameId = _hostAssembleBlockIndex[2 * i + 1];
+		_hostAssembleBlockCsrSlot[2 * i] = frameColumnSlot[iFrameId][jFrameId];
+		_hostAssembleBlockCsrSlot[2 * i + 1] = frameColumnSlot[jFrameId][iFrameId];
+	}
+
+	for (int i = 0; i < events.size(); i++)
+		setReducedBlockSlot(events[i]);
+}
+
+bool MIPC::MipcSimulator::setReducedBlockSlot(MipcConstraint* event)
+{
+	int blocks = event->reducedFrameId.size();
+	event->reducedBlockSlot.resize(blocks * blocks);
+	for (int c = 0; c < blocks; c++)
+	{
+		std::map<int, int>& columnSlot = _reducedSparseFrameColumnSlot[event->reducedFrameId[c]];
+		for (int a = 0; a < blocks; a++)
+		{
+			std::map<int, int>::iterator it = columnSlot.find(event->reducedFrameId[a]);
+			if (it == columnSlot.end())
+				return false;
+			event->reducedBlockSlot[c * blocks + a] = it->second;
+		}
+	}
+	return true;
+}
+
+void MIPC::MipcSimulator::uploadReducedSparsePattern()
+{
+	int nnz = _hostReducedSparseSysMatrixCsrNonZero;
+	CUDA_CALL(cudaMemcpy(_devReducedSparseSysMatrixCsrNonZero, &_hostReducedSparseSysMatrixCsrNonZero, sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMemcpy(_devReducedSparseSysMatrixCsrRowPtr, _hostReducedSparseSysMatrixCsrRowPtr.data(), _hostReducedSparseSysMatrixCsrRowPtr.size() * sizeof(int), cudaMemcpyHostToDevice));
+
+	if (nnz > _hostReducedSparseSysMatrixCsrCapacity)
+	{
+		if (_hostReducedSparseSysMatrixCsrCapacity > 0)
+		{
+			gpuSize -= _hostReducedSparseSysMatrixCsrCapacity * (sizeof(int) + 3 * sizeof(qeal));
+			CUDA_CALL(cudaFree(_devReducedSparseSysMatrixCsrColInd));
+			CUDA_CALL(cudaFree(_devReducedSparseSysMatrixCsrVal));
+			CUDA_CALL(cudaFree(_devReducedSparseCFHessinaCsrVal));
+			CUDA_CALL(cudaFree(_devReducedSparseMassCsrVal));
+		}
+		// contacts between frames that were apart add blocks later on, leave room for them
+		_hostReducedSparseSysMatrixCsrCapacity = std::min(nnz + nnz / 2, _sysReducedDim * _sysReducedDim);
+		int capacity = _hostReducedSparseSysMatrixCsrCapacity;
+		CUDA_CALL(cudaMalloc((void**)&_devReducedSparseSysMatrixCsrColInd, capacity * sizeof(int))); gpuSize += capacity * sizeof(int);
+		CUDA_CALL(cudaMalloc((void**)&_devReducedSparseSysMatrixCsrVal, capacity * sizeof(qeal))); gpuSize += capacity * sizeof(qeal);
+		CUDA_CALL(cudaMalloc((void**)&_devReducedSparseCFHessinaCsrVal, capacity * sizeof(qeal))); gpuSize += capacity * sizeof(qeal);
+		CUDA_CALL(cudaMalloc((void**)&_devReducedSparseMassCsrVal, capacity * sizeof(qeal))); gpuSize += capacity * sizeof(qeal);
+	}
+	CUDA_CALL(cudaMemcpy(_devReducedSparseSysMatrixCsrColInd, _hostReducedSparseSysMatrixCsrColInd.data(), nnz * sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMemcpy(_devReducedSparseMassCsrVal, _hostReducedSparseMassCsrVal.data(), nnz * sizeof(qeal), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMemcpy(_devAssembleBlockCsrSlot, _hostAssembleBlockCsrSlot.data(), _hostAssembleBlockCsrSlot.size() * sizeof(int), cudaMemcpyHostToDevice));
 }
 
 void MIPC::MipcSimulator::initCudaCollisionMemory()
@@ -1169,10 +2351,30 @@ void MIPC::MipcSimulator::initCudaCollisionMemory()
 	CUDA_CALL(cudaMalloc((void**)&_devCollisionEventNum, sizeof(int))); gpuSize += sizeof(int);
 	CUDA_CALL(cudaMemcpy(_devCollisionEventNum, &_hostCollisionEventNum, sizeof(int), cudaMemcpyHostToDevice));
 
-	CUDA_CALL(cudaMalloc((void**)&_devCollisionEventList, _hostCollisionEventList.size() * sizeof(int))); gpuSize += _hostCollisionEventList.size() * sizeof(int);
+	// the broad phase changes the event list, leave room to grow
+	_hostCollisionEventCapacity = _hostCollisionEventNum;
+	if (_broadPhase != ALL_PAIRS)
+		_hostCollisionEventCapacity = 2 * _hostCollisionEventNum + 1024;
+
+	CUDA_CALL(cudaMalloc((void**)&_devCollisionEventList, 5 * _hostCollisionEventCapacity * sizeof(int))); gpuSize += 5 * _hostCollisionEventCapacity * sizeof(int);
 	CUDA_CALL(cudaMemcpy(_devCollisionEventList, _hostCollisionEventList.data(), _hostCollisionEventList.size() * sizeof(int), cudaMemcpyHostToDevice));
 
-	CUDA_CALL(cudaMalloc((void**)&_devCCD, _hostCollisionEventNum * sizeof(qeal))); gpuSize += _hostCollisionEventNum * sizeof(qeal);
+	CUDA_CALL(cudaMalloc((void**)&_devCCD, _hostCollisionEventCapacity * sizeof(qeal))); gpuSize += _hostCollisionEventCapacity * sizeof(qeal);
+}
+
+void MIPC::MipcSimulator::uploadCollisionEventList()
+{
+	_hostCollisionEventNum = _overallCollisionEvents.size();
+	if (_hostCollisionEventNum > _hostCollisionEventCapacity)
+	{
+		CUDA_CALL(cudaFree(_devCollisionEventList)); gpuSize -= 5 * _hostCollisionEventCapacity * sizeof(int);
+		CUDA_CALL(cudaFree(_devCCD)); gpuSize -= _hostCollisionEventCapacity * sizeof(qeal);
+		_hostCollisionEventCapacity = 2 * _hostCollisionEventNum;
+		CUDA_CALL(cudaMalloc((void**)&_devCollisionEventList, 5 * _hostCollisionEventCapacity * sizeof(int))); gpuSize += 5 * _hostCollisionEventCapacity * sizeof(int);
+		CUDA_CALL(cudaMalloc((void**)&_devCCD, _hostCollisionEventCapacity * sizeof(qeal))); gpuSize += _hostCollisionEventCapacity * sizeof(qeal);
+	}
+	CUDA_CALL(cudaMemcpy(_devCollisionEventNum, &_hostCollisionEventNum, sizeof(int), cudaMemcpyHostToDevice));
+	CUDA_CALL(cudaMemcpy(_devCollisionEventList, _hostCollisionEventList.data(), _hostCollisionEventList.size() * sizeof(int), cudaMemcpyHostToDevice));
 }
 
 void MIPC::MipcSimulator::genOverallCollisionEvents()
@@ -1198,6 +2400,20 @@ void MIPC::MipcSimulator::genOverallCollisionEvents()
 		_collisionStaticMedialSpheres[i] = new CollideMedialSphere(frame, r);
 	}
 
+	_selfExclusionRingId.resize(models.size());
+	_selfExclusionRingHop.resize(models.size());
+	for (int i = 0; i < models.size(); i++)
+		computeSelfExclusionRing(i, models[i]->getMedialMeshHandle()->getMesh());
+
+	_hostMedialPointMovingDir.resize(3 * totalMedialPoinsNum, 0.0);
+
+	if (_broadPhase != ALL_PAIRS)
+	{
+		genBroadPhaseCollisionEvents();
+		_hostCollisionEventNum = _overallCollisionEvents.size();
+		return;
+	}
+
 	for (int i = 0; i < models.size(); i++)
 	{
 		BaseMedialMesh* mi = models[i]->getMedialMeshHandle()->getMesh();
@@ -1216,7 +2432,7 @@ void MIPC::MipcSimulator::genOverallCollisionEvents()
 		}
 
 	}
-
+	_hostCollisionEventNum = _overallCollisionEvents.size();
 }
 
 void MIPC::MipcSimulator::genOverallInterCollisionEvents(int mid, BaseMedialMesh* m, std::vector<MipcConstraint*>& collisionEventsList)
@@ -1232,19 +2448,7 @@ void MIPC::MipcSimulator::genOverallInterCollisionEvents(int mid, BaseMedialMesh
 			Vector3i slab = m->getMedialSlab(j);
 			if (slab[2] < 0)
 				continue;
-			if (i == slab.data()[0] || i == slab.data()[1] || i == slab.data()[2])
-				continue;
-			bool isNeighbor = false;
-			for (int ns = 0; ns < m->medialPointsNeighborList[i].span; ns++)
-			{
-				int ns_id = m->medialPointsNeighborList[i].buffer[ns];
-				if (ns_id == slab.data()[0] || ns_id == slab.data()[1] || ns_id == slab.data()[2])
-				{
-					isNeighbor = true;
-					break;
-				}
-			}
-			if (isNeighbor)
+			if (isSelfSlabSphereExcluded(mid, i, slab))
 				continue;
 
 			int n_gnid0 = m->getMedialPointOverallId(slab.data()[0]);
@@ -1257,13 +2461,14 @@ void MIPC::MipcSimulator::genOverallInterCollisionEvents(int mid, BaseMedialMesh
 			//
 			CollisionType type = DefromableWithDefromable;
 			MipcSlabSphereConstraint* event = new MipcSlabSphereConstraint(collisionEventsList.size(), ns0, ns1, ns2, s, _dHat, _mu, _ev * _timeStep, type);
-			if (event->isActive() || event->distance < 0)
+			if (event->isActive() || event->distance < 0 || isSelfRestExcluded(event))
 			{
 				free(event);
 				continue;
 			}
 
 			collisionEventsList.push_back(event);
+			event->setModelPair(mid, mid);
 			_hostCollisionEventList.push_back(COLLISION_SS);
 			_hostCollisionEventList.push_back(n_gnid0);
 			_hostCollisionEventList.push_back(n_gnid1);
@@ -1280,19 +2485,20 @@ void MIPC::MipcSimulator::genOverallInterCollisionEvents(int mid, BaseMedialMesh
 		for (int j = i + 1; j < m->edgeList.size(); j++)
 		{
 			Vector2i n_mc = m->edgeList[j];
-			if (mc.data()[0] == n_mc.data()[0] || mc.data()[1] == n_mc.data()[1] || mc.data()[0] == n_mc.data()[1] || mc.data()[1] == n_mc.data()[0]) continue;
+			if (isSelfConeConeExcluded(mid, mc, n_mc)) continue;
 			CollideMedialSphere* cs3 = _collisionMedialSpheres[m->getMedialPointOverallId(n_mc.data()[0])];
 			CollideMedialSphere* cs4 = _collisionMedialSpheres[m->getMedialPointOverallId(n_mc.data()[1])];
 
 			CollisionType type = DefromableWithDefromable;
 			MipcConeConeConstraint* event = new MipcConeConeConstraint(collisionEventsList.size(), cs0, cs1, cs3, cs4, _dHat, _mu, _ev * _timeStep, type);
-			if (event->isActive() || event->distance < 0)
+			if (event->isActive() || event->distance < 0 || isSelfRestExcluded(event))
 			{
 				free(event);
 				continue;
 			}
 
 			collisionEventsList.push_back(event);
+			event->setModelPair(mid, mid);
 			_hostCollisionEventList.push_back(COLLISION_CC);
 			_hostCollisionEventList.push_back(m->getMedialPointOverallId(mc.data()[0]));
 			_hostCollisionEventList.push_back(m->getMedialPointOverallId(mc.data()[1]));
@@ -1328,6 +2534,7 @@ void MIPC::MipcSimulator::genOverallIntraCollisionEvents(int mid1, BaseMedialMes
 				continue;
 			}
 			collisionEventsList.push_back(event);
+			event->setModelPair(mid1, mid2);
 			_hostCollisionEventList.push_back(COLLISION_SS);
 			_hostCollisionEventList.push_back(m2->getMedialPointOverallId(slab.data()[0]));
 			_hostCollisionEventList.push_back(m2->getMedialPointOverallId(slab.data()[1]));
@@ -1355,6 +2562,7 @@ void MIPC::MipcSimulator::genOverallIntraCollisionEvents(int mid1, BaseMedialMes
 			}
 
 			collisionEventsList.push_back(event);
+			event->setModelPair(mid1, mid2);
 
 			_hostCollisionEventList.push_back(COLLISION_SS);
 			_hostCollisionEventList.push_back(m1->getMedialPointOverallId(slab.data()[0]));
@@ -1384,6 +2592,7 @@ void MIPC::MipcSimulator::genOverallIntraCollisionEvents(int mid1, BaseMedialMes
 			}
 
 			collisionEventsList.push_back(event);
+			event->setModelPair(mid1, mid2);
 			_hostCollisionEventList.push_back(COLLISION_CC);
 			_hostCollisionEventList.push_back(m1->getMedialPointOverallId(mc.data()[0]));
 			_hostCollisionEventList.push_back(m1->getMedialPointOverallId(mc.data()[1]));
@@ -1418,6 +2627,7 @@ void MIPC::MipcSimulator::genOverallStaticCollisionEvents(int mid1, BaseMedialMe
 			}
 
 			collisionEventsList.push_back(event); 
+			event->setModelPair(mid1, -mid2 - 1);
 			_hostCollisionEventList.push_back(COLLISION_STATIC_WITH_DEFORMABLE_SS);
 			_hostCollisionEventList.push_back(m2->getMedialPointOverallId(slab.data()[0]));
 			_hostCollisionEventList.push_back(m2->getMedialPointOverallId(slab.data()[1]));
@@ -1445,6 +2655,7 @@ void MIPC::MipcSimulator::genOverallStaticCollisionEvents(int mid1, BaseMedialMe
 				continue;
 			}
 			collisionEventsList.push_back(event);
+			event->setModelPair(mid1, -mid2 - 1);
 			_hostCollisionEventList.push_back(COLLISION_DEFORMABLE_WITH_STATIC_SS);
 			_hostCollisionEventList.push_back(m1->getMedialPointOverallId(slab.data()[0]));
 			_hostCollisionEventList.push_back(m1->getMedialPointOverallId(slab.data()[1]));
@@ -1474,6 +2685,7 @@ void MIPC::MipcSimulator::genOverallStaticCollisionEvents(int mid1, BaseMedialMe
 				continue;
 			}
 			collisionEventsList.push_back(event);
+			event->setModelPair(mid1, -mid2 - 1);
 			_hostCollisionEventList.push_back(COLLISION_DEFORMABLE_WITH_STATIC_CC);
 			_hostCollisionEventList.push_back(m1->getMedialPointOverallId(mc.data()[0]));
 			_hostCollisionEventList.push_back(m1->getMedialPointOverallId(mc.data()[1]));
@@ -1481,4 +2693,395 @@ void MIPC::MipcSimulator::genOverallStaticCollisionEvents(int mid1, BaseMedialMe
 			_hostCollisionEventList.push_back(m2->getMedialPointOverallId(n_mc.data()[1]));
 		}
 	}
-}
\ No newline at end of file
+}
+
+void MIPC::MipcSimulator::computeSelfExclusionRing(int mid, BaseMedialMesh* m)
+{
+	std::vector<std::vector<int>>& ringId = _selfExclusionRingId[mid];
+	std::vector<std::vector<int>>& ringHop = _selfExclusionRingHop[mid];
+	ringId.clear();
+	ringHop.clear();
+	if (m == nullptr)
+		return;
+	ringId.resize(m->medialPointsNum);
+	ringHop.resize(m->medialPointsNum);
+
+	// breadth first over the medial graph, up to _selfExclusionRing hops
+	#pragma omp parallel for
+	for (int i = 0; i < m->medialPointsNum; i++)
+	{
+		std::map<int, int> hop;
+		hop[i] = 0;
+		std::vector<int> front(1, i);
+		for (int k = 1; k <= _selfExclusionRing; k++)
+		{
+			std::vector<int> next;
+			for (int f = 0; f < front.size(); f++)
+			{
+				int v = front[f];
+				for (int ns = 0; ns < m->medialPointsNeighborList[v].span; ns++)
+				{
+					int ns_id = m->medialPointsNeighborList[v].buffer[ns];
+					if (hop.find(ns_id) != hop.end())
+						continue;
+					hop[ns_id] = k;
+					next.push_back(ns_id);
+				}
+			}
+			front = next;
+		}
+		for (std::map<int, int>::iterator it = hop.begin(); it != hop.end(); ++it)
+		{
+			ringId[i].push_back(it->first);
+			ringHop[i].push_back(it->second);
+		}
+	}
+}
+
+int MIPC::MipcSimulator::getSelfExclusionHop(int mid, int i, int j)
+{
+	std::vector<int>& ringId = _selfExclusionRingId[mid][i];
+	std::vector<int>::iterator it = std::lower_bound(ringId.begin(), ringId.end(), j);
+	if (it == ringId.end() || *it != j)
+		return _selfExclusionRing + 1;
+	return _selfExclusionRingHop[mid][i][it - ringId.begin()];
+}
+
+bool MIPC::MipcSimulator::isSelfSlabSphereExcluded(int mid, int sid, Vector3i slab)
+{
+	for (int k = 0; k < 3; k++)
+		if (getSelfExclusionHop(mid, sid, slab.data()[k]) <= _selfExclusionRing)
+			return true;
+	return false;
+}
+
+bool MIPC::MipcSimulator::isSelfConeConeExcluded(int mid, Vector2i c0, Vector2i c1)
+{
+	// one hop less than for slabs, a ring of 1 keeps only the shared endpoint rule
+	for (int a = 0; a < 2; a++)
+		for (int b = 0; b < 2; b++)
+			if (getSelfExclusionHop(mid, c0.data()[a], c1.data()[b]) <= _selfExclusionRing - 1)
+				return true;
+	return false;
+}
+
+bool MIPC::MipcSimulator::isSelfRestExcluded(MipcConstraint* event)
+{
+	// self pairs this close at rest only touch under implausible deformation
+	if (_selfExclusionRestDistance <= 0.0)
+		return false;
+	// the rest distance is a length like the box padding, so the gap is compared and not |c|^2 - r^2
+	return event->getGap() <= _selfExclusionRestDistance;
+}
+
+void MIPC::MipcSimulator::genBroadPhaseCollisionEvents()
+{
+	_broadPhasePrimitiveType.clear();
+	_broadPhasePrimitiveModel.clear();
+	_broadPhasePrimitiveVertices.clear();
+	_broadPhasePrimitiveLocalVertices.clear();
+
+	int modelsNum = models.size() + staticModels.size();
+	for (int k = 0; k < modelsNum; k++)
+	{
+		bool isStatic = k >= models.size();
+		int mid = isStatic ? -(k - (int)models.size()) - 1 : k;
+		BaseMedialMesh* m = isStatic ? staticModels[-mid - 1]->getMedialMeshHandle()->getMesh() : models[mid]->getMedialMeshHandle()->getMesh();
+		if (m == nullptr)
+			continue;
+
+		for (int i = 0; i < m->medialPointsNum; i++)
+		{
+			_broadPhasePrimitiveType.push_back(SPHERE_PRIMITIVE);
+			_broadPhasePrimitiveModel.push_back(mid);
+			int local[3] = { i, -1, -1 };
+			for (int j = 0; j < 3; j++)
+			{
+				_broadPhasePrimitiveLocalVertices.push_back(local[j]);
+				_broadPhasePrimitiveVertices.push_back(local[j] < 0 ? -1 : m->getMedialPointOverallId(local[j]));
+			}
+		}
+		for (int i = 0; i < m->edgeList.size(); i++)
+		{
+			_broadPhasePrimitiveType.push_back(CONE_PRIMITIVE);
+			_broadPhasePrimitiveModel.push_back(mid);
+			int local[3] = { m->edgeList[i].data()[0], m->edgeList[i].data()[1], -1 };
+			for (int j = 0; j < 3; j++)
+			{
+				_broadPhasePrimitiveLocalVertices.push_back(local[j]);
+				_broadPhasePrimitiveVertices.push_back(local[j] < 0 ? -1 : m->getMedialPointOverallId(local[j]));
+			}
+		}
+		for (int i = 0; i < m->medialSlabsNum; i++)
+		{
+			Vector3i slab = m->getMedialSlab(i);
+			_broadPhasePrimitiveType.push_back(SLAB_PRIMITIVE);
+			_broadPhasePrimitiveModel.push_back(mid);
+			for (int j = 0; j < 3; j++)
+			{
+				_broadPhasePrimitiveLocalVertices.push_back(slab.data()[j]);
+				_broadPhasePrimitiveVertices.push_back(slab.data()[j] < 0 ? -1 : m->getMedialPointOverallId(slab.data()[j]));
+			}
+		}
+	}
+
+	// deformable models are enumerated first
+	_broadPhaseDeformablePrimitivesNum = 0;
+	while (_broadPhaseDeformablePrimitivesNum < _broadPhasePrimitiveModel.size() && _broadPhasePrimitiveModel[_broadPhaseDeformablePrimitivesNum] >= 0)
+		_broadPhaseDeformablePrimitivesNum++;
+	initBroadPhaseStaticTree();
+
+	// pairs close at the rest shape are checked here once, the same way the all-pairs generation drops them
+	if (_broadPhase == SPATIAL_HASH)
+	{
+		// cells about one sphere box wide
+		qeal meanRadius = 0.0;
+		for (int i = 0; i < totalMedialPoinsNum; i++)
+			meanRadius += medialRadiusBuffer.buffer[i];
+		if (totalMedialPoinsNum > 0)
+			meanRadius /= totalMedialPoinsNum;
+		_broadPhaseHash.setCellSize(2.0 * (meanRadius + _dHat));
+	}
+
+	std::vector<qeal> boxes;
+	computeBroadPhaseBoxes(nullptr, 0, _broadPhaseDeformablePrimitivesNum, boxes, std::max(_dHat, _selfExclusionRestDistance));
+	std::vector<std::pair<int, int>> pairs;
+	computeBroadPhasePairs(boxes, true, pairs);
+
+	_overallCollisionEvents.clear();
+	_hostCollisionEventList.clear();
+	for (int i = 0; i < pairs.size(); i++)
+	{
+		int index = getBroadPhaseEvent(pairs[i].first, pairs[i].second, true);
+		if (index < 0)
+			continue;
+		_overallCollisionEvents.push_back(_broadPhaseEventPool[index]);
+		for (int k = 0; k < 5; k++)
+			_hostCollisionEventList.push_back(_broadPhaseEventPoolList[5 * index + k]);
+	}
+}
+
+void MIPC::MipcSimulator::updateBroadPhaseCollisionEvents(const qeal* movingDir)
+{
+	std::vector<qeal> boxes;
+	computeBroadPhaseBoxes(movingDir, 0, _broadPhaseDeformablePrimitivesNum, boxes);
+	std::vector<std::pair<int, int>> pairs;
+	computeBroadPhasePairs(boxes, false, pairs);
+
+	int poolSize = _broadPhaseEventPool.size();
+	_overallCollisionEvents.clear();
+	_hostCollisionEventList.clear();
+	for (int i = 0; i < pairs.size(); i++)
+	{
+		int index = getBroadPhaseEvent(pairs[i].first, pairs[i].second);
+		if (index < 0)
+			continue;
+		_overallCollisionEvents.push_back(_broadPhaseEventPool[index]);
+		for (int k = 0; k < 5; k++)
+			_hostCollisionEventList.push_back(_broadPhaseEventPoolList[5 * index + k]);
+	}
+	_hostCollisionEventNum = _overallCollisionEvents.size();
+	// the event list is only read on the device by MPsCCD
+	if (!_hostCCD && _ccdType != ADDITIVE_CCD)
+		uploadCollisionEventList();
+
+	for (int i = poolSize; i < _broadPhaseEventPool.size(); i++)
+	{
+		_broadPhaseEventPool[i]->setWarmStart(_warmStartDistance);
+		_broadPhaseEventPool[i]->setMotionFilter(_motionBudgetFilter);
+	}
+
+	if (_sysMatType == SPARSE && _broadPhaseEventPool.size() > poolSize)
+	{
+		// new events mostly couple frames that already share blocks, the pattern only grows for the others
+		bool fits = true;
+		for (int i = poolSize; i < _broadPhaseEventPool.size(); i++)
+		{
+			_broadPhaseEventPool[i]->computeReducedFrameBlocks();
+			if (!setReducedBlockSlot(_broadPhaseEventPool[i]))
+				fits = false;
+		}
+		if (!fits)
+		{
+			buildReducedSparsePattern();
+			uploadReducedSparsePattern();
+		}
+	}
+
+	// the split keeps its step start reference, only the events new to this step are placed
+	if (_hotColdEvents)
+		classifyHotColdCollisionEvents(_overallCollisionEvents);
+}
+
+void MIPC::MipcSimulator::initBroadPhaseStaticTree()
+{
+	// static primitives never move, their tree is built once and may be kept on disk
+	std::vector<qeal> boxes;
+	computeBroadPhaseBoxes(nullptr, _broadPhaseDeformablePrimitivesNum, _broadPhasePrimitiveType.size(), boxes);
+	if (_staticBVHFilename.size() > 0 && _broadPhaseStaticTree.readBinary(_staticBVHFilename))
+	{
+		// a scene with moved or rescaled static models has different boxes
+		if (_broadPhaseStaticTree.getPrimitiveBoxes() == boxes)
+			return;
+		std::cout << "  -- static bvh " << _staticBVHFilename << " is out of date, rebuild it" << std::endl;
+	}
+
+	_broadPhaseStaticTree.build(boxes);
+	if (_staticBVHFilename.size() > 0)
+		_broadPhaseStaticTree.writeBinary(_staticBVHFilename);
+}
+
+void MIPC::MipcSimulator::computeBroadPhaseBoxes(const qeal* movingDir, int begin, int end, std::vector<qeal>& boxes, qeal pad)
+{
+	if (pad < 0.0)
+		pad = _dHat;
+	boxes.resize(6 * (end - begin));
+	#pragma omp parallel for
+	for (int i = begin; i < end; i++)
+	{
+		qeal* box = boxes.data() + 6 * (i - begin);
+		for (int k = 0; k < 3; k++)
+		{
+			box[k] = QEAL_MAX;
+			box[3 + k] = -QEAL_MAX;
+		}
+		bool isStatic = _broadPhasePrimitiveModel[i] < 0;
+		for (int j = 0; j < 3; j++)
+		{
+			int vid = _broadPhasePrimitiveVertices[3 * i + j];
+			if (vid < 0)
+				continue;
+			qeal* p = isStatic ? staticModelPool.medialPointsBuffer.buffer.data() + 3 * vid : medialPointsBuffer.buffer.data() + 3 * vid;
+			qeal r = isStatic ? staticModelPool.medialRadiusBuffer.buffer[vid] : medialRadiusBuffer.buffer[vid];
+			// sphere swept along the search direction, padded by dHat
+			for (int k = 0; k < 3; k++)
+			{
+				qeal lo = p[k], hi = p[k];
+				if (!isStatic && movingDir != nullptr)
+				{
+					lo = std::min(lo, p[k] + movingDir[3 * vid + k]);
+					hi = std::max(hi, p[k] + movingDir[3 * vid + k]);
+				}
+				box[k] = std::min(box[k], lo - r - pad);
+				box[3 + k] = std::max(box[3 + k], hi + r + pad);
+			}
+		}
+	}
+}
+
+void MIPC::MipcSimulator::computeBroadPhasePairs(const std::vector<qeal>& boxes, bool rebuild, std::vector<std::pair<int, int>>& pairs)
+{
+	if (_broadPhase == SPATIAL_HASH)
+	{
+		_broadPhaseHash.build(boxes);
+		_broadPhaseHash.selfOverlap(pairs);
+	}
+	else
+	{
+		if (rebuild)
+			_broadPhaseTree.build(boxes);
+		else _broadPhaseTree.refit(boxes);
+		_broadPhaseTree.selfOverlap(pairs);
+	}
+
+	if (_broadPhaseStaticTree.getPrimitivesNum() == 0)
+		return;
+	std::vector<std::pair<int, int>> staticPairs;
+	_broadPhaseStaticTree.overlap(boxes, staticPairs);
+	for (int i = 0; i < staticPairs.size(); i++)
+		pairs.push_back(std::pair<int, int>(staticPairs[i].first, _broadPhaseDeformablePrimitivesNum + staticPairs[i].second));
+}
+
+int MIPC::MipcSimulator::getBroadPhaseEvent(int a, int b, bool atRest)
+{
+	long long key = (long long)a * _broadPhasePrimitiveType.size() + b;
+	std::unordered_map<long long, int>::iterator it = _broadPhaseEventIndex.find(key);
+	if (it != _broadPhaseEventIndex.end())
+		return it->second;
+	int index = createBroadPhaseEvent(a, b, atRest);
+	_broadPhaseEventIndex[key] = index;
+	return index;
+}
+
+int MIPC::MipcSimulator::createBroadPhaseEvent(int a, int b, bool atRest)
+{
+	int ta = _broadPhasePrimitiveType[a];
+	int tb = _broadPhasePrimitiveType[b];
+	// only sphere-slab and cone-cone pairs form events
+	if (ta == SLAB_PRIMITIVE && tb == SPHERE_PRIMITIVE)
+	{
+		std::swap(a, b);
+		std::swap(ta, tb);
+	}
+	bool isSS = (ta == SPHERE_PRIMITIVE && tb == SLAB_PRIMITIVE);
+	bool isCC = (ta == CONE_PRIMITIVE && tb == CONE_PRIMITIVE);
+	if (!isSS && !isCC)
+		return -1;
+	// for cones the deformable one goes first
+	if (isCC && _broadPhasePrimitiveModel[a] < 0)
+		std::swap(a, b);
+
+	int ma = _broadPhasePrimitiveModel[a];
+	int mb = _broadPhasePrimitiveModel[b];
+	if (ma < 0 && mb < 0)
+		return -1;
+	const int* va = _broadPhasePrimitiveVertices.data() + 3 * a;
+	const int* vb = _broadPhasePrimitiveVertices.data() + 3 * b;
+	const int* la = _broadPhasePrimitiveLocalVertices.data() + 3 * a;
+	const int* lb = _broadPhasePrimitiveLocalVertices.data() + 3 * b;
+	if (isSS && lb[2] < 0)
+		return -1;
+
+	if (ma == mb)
+	{
+		if (isSS && isSelfSlabSphereExcluded(ma, la[0], Vector3i(lb[0], lb[1], lb[2])))
+			return -1;
+		if (isCC && isSelfConeConeExcluded(ma, Vector2i(la[0], la[1]), Vector2i(lb[0], lb[1])))
+			return -1;
+	}
+
+	std::vector<CollideMedialSphere*>& sa = ma < 0 ? _collisionStaticMedialSpheres : _collisionMedialSpheres;
+	std::vector<CollideMedialSphere*>& sb = mb < 0 ? _collisionStaticMedialSpheres : _collisionMedialSpheres;
+	CollisionType type = (ma < 0 || mb < 0) ? DefromableWithStatic : DefromableWithDefromable;
+	int index = _broadPhaseEventPool.size();
+
+	MipcConstraint* event;
+	int flag;
+	if (isSS)
+	{
+		event = new MipcSlabSphereConstraint(index, sb[vb[0]], sb[vb[1]], sb[vb[2]], sa[va[0]], _dHat, _mu, _ev * _timeStep, type);
+		if (ma < 0) flag = COLLISION_DEFORMABLE_WITH_STATIC_SS;
+		else if (mb < 0) flag = COLLISION_STATIC_WITH_DEFORMABLE_SS;
+		else flag = COLLISION_SS;
+	}
+	else
+	{
+		event = new MipcConeConeConstraint(index, sa[va[0]], sa[va[1]], sb[vb[0]], sb[vb[1]], _dHat, _mu, _ev * _timeStep, type);
+		flag = mb < 0 ? COLLISION_DEFORMABLE_WITH_STATIC_CC : COLLISION_CC;
+	}
+
+	if (atRest && (event->isActive() || event->distance < 0 || (ma == mb && isSelfRestExcluded(event))))
+	{
+		delete event;
+		return -1;
+	}
+
+	event->setModelPair(ma, mb);
+	_broadPhaseEventPool.push_back(event);
+	_broadPhaseEventPoolList.push_back(flag);
+	if (isSS)
+	{
+		_broadPhaseEventPoolList.push_back(vb[0]);
+		_broadPhaseEventPoolList.push_back(vb[1]);
+		_broadPhaseEventPoolList.push_back(vb[2]);
+		_broadPhaseEventPoolList.push_back(va[0]);
+	}
+	else
+	{
+		_broadPhaseEventPoolList.push_back(va[0]);
+		_broadPhaseEventPoolList.push_back(va[1]);
+		_broadPhaseEventPoolList.push_back(vb[0]);
+		_broadPhaseEventPoolList.push_back(vb[1]);
+	}
+	return index;
+}
@@ -3,9 +3,15 @@
 
 #include "Simulator\FiniteElementMethod\FemSimulator.h"
 #include "MpsCCD.cuh"
+#include "MPsCCDHost.h"
 #include "GpuFunc.cuh"
 #include "MipcModel.h"
 #include "MipcConstraint.h"
+#include "Simulator\CollisionDetection\MedialPrimitiveBVH.h"
+#include "Simulator\CollisionDetection\MedialPrimitiveSpatialHash.h"
+#include <map>
+#include <unordered_map>
+#include <algorithm>
 
 
 namespace MIPC
@@ -18,6 +24,26 @@ namespace MIPC
 			SPARSE = 1
 		};
 
+		enum BroadPhaseType
+		{
+			ALL_PAIRS = 0,
+			PRIMITIVE_BVH = 1,
+			SPATIAL_HASH = 2
+		};
+
+		enum CCDType
+		{
+			POLYNOMIAL_CCD = 0,
+			ADDITIVE_CCD = 1
+		};
+
+		enum MedialPrimitiveType
+		{
+			SPHERE_PRIMITIVE = 0,
+			CONE_PRIMITIVE = 1,
+			SLAB_PRIMITIVE = 2
+		};
+
 		enum CollisionType
 		{
 			DefromableWithStatic = 0,
@@ -40,16 +66,62 @@ namespace MIPC
 			_mu = 0.0;
 			_ev = 1e-2;
 			_sysMatType = DENSE;
+			_parallelAssembly = true;
+			_warmStartDistance = false;
+			_motionBudgetFilter = false;
+			_selfExclusionRing = 1;
+			_selfExclusionRestDistance = 0.0;
+			_modelCulling = false;
+			_hotColdEvents = false;
+			_hotColdMotionScale = 2.0;
+			_hostCCD = false;
+			_hostCCDLowerBound = 0.0;
+			_hostProjection = false;
+			_surfaceSkinning = false;
+			_ccdType = POLYNOMIAL_CCD;
+			_accdGap = 0.1;
+			_coldPromotedNum = 0;
+			_hotColdBudget = 0.0;
+			_broadPhase = ALL_PAIRS;
+			_broadPhaseDeformablePrimitivesNum = 0;
+			_hostCollisionEventCapacity = 0;
+			_hostReducedSparseSysMatrixCsrCapacity = 0;
 		}
 		virtual bool addModelFromConfigFile(const std::string filename, TiXmlElement* item);
+		virtual void readExtraAttributeFromConfigFile(TiXmlElement* item);
 		MipcModel* getModel(const int id) { return dynamic_cast<MipcModel*> (models[id]); }
 
 		virtual void doTimeGpuDenseSystem(int frame = 0);
 		virtual void doTimeGpuSparseSystem(int frame = 0);
+		// x = U * reduced and reduced = U^T * x over all models, through the compact per tet point / per frame projection
+		void projectToFullspaceGpu(qeal* devReduced, qeal* devX);
+		void projectToReducedGpu(qeal* devX, qeal* devReduced);
+		// the same on the cpu threads, one tet point (frame for the transpose) per thread over the interleaved xyz
+		void projectToFullspaceHost(const qeal* reduced, qeal* x);
+		void projectToReducedHost(const qeal* x, qeal* reduced);
 		virtual qeal computeEnergy(qeal* devXn, qeal* devXtilde);
 		virtual void computeElasticsHessianAndGradient(qeal * elasticsDerivative, qeal * elasticsHessian);
+		// energy of the stvk polynomial models at _devReducedX (times dt^2 like the element energy), with derivatives also adds their
+		// reduced force into _devReducedInternalForce and assigns their diagonal blocks of _devReducedStiffness, or adds them times
+		// dt^2 into the sparse system values
+		qeal computeStVKPolynomial(bool derivatives);
+		// medial points of the non-static frames from _sysReducedX over the batch arrays below, in place of ReducedFrame::transform
+		void buildReducedFrameBatch();
+		void transformReducedFramesHost();
+		// moving dir of the medial points over the same batch arrays, for the broad phase and the host ccd without the device copy
+		void computeMedialPointsMovingDirHost(const qeal* reducedDir);
 		virtual void constructConstraintSet(const qeal kappa, bool updateFriction);
+		virtual void splitHotColdCollisionEvents();
+		// places the events the broad phase found during the step, the ones already split are kept
+		virtual void classifyHotColdCollisionEvents(std::vector<MipcConstraint*>& events);
+		virtual void promoteColdCollisionEvents();
+		qeal getHotColdStepReach();
+		virtual void updateModelBoundingBoxes();
+		bool isModelPairNear(MipcConstraint* event);
 		virtual void getToI(qeal& toi);
+		virtual void assembleCollisionGradientAndHessian(std::vector<MipcConstraint*>& events, bool isFriction, VectorX& gradient, MatrixX& hessian);
+		virtual void assembleCollisionGradientAndHessian(std::vector<MipcConstraint*>& events, bool isFriction, VectorX& gradient, std::vector<qeal>& csrVal);
+		virtual void colorCollisionEvents(std::vector<MipcConstraint*>& events, std::vector<std::vector<int>>& colorList, std::vector<int>& serialList);
 
 		virtual void computeSystemUsingCusolverDenseChol(qeal* devSys, qeal* devRhs, qeal* devX, int dim);
 		virtual void computeSystemUsingCusolverSparseChol(qeal* devSys, int* devSysRowPtr, int* devSysColInd, int nnz, qeal* devRhs, qeal* devX, int dim);
@@ -57,6 +129,9 @@ namespace MIPC
 		virtual void initialization();
 		virtual void run(int frame);
 		virtual void postRun();
+		// full tet positions from _sysReducedX, with surface skinning only done for drawing the tet mesh or saving a frame
+		void reconstructTetPoints();
+		virtual void saveFrameStatus(int frame, std::ofstream& fout);
 
 		int getReducedDimension() { return _sysReducedDim; }
 	protected:
@@ -65,6 +140,7 @@ namespace MIPC
 		virtual void initCudaMedialMeshMemory();
 		virtual void initCudaGeneralSysMemory();
 		virtual void initCudaReducedProjectionMemory();
+		virtual void initCudaStVKPolynomialMemory();
 		virtual void initCudaSparseSysMemory();
 		virtual void initCudaCollisionMemory();
 
@@ -73,6 +149,25 @@ namespace MIPC
 		virtual  void genOverallIntraCollisionEvents(int mid1, BaseMedialMesh* m1, int mid2, BaseMedialMesh* m2, std::vector<MipcConstraint*>& collisionEventsList);
 		virtual  void genOverallStaticCollisionEvents(int mid1, BaseMedialMesh* m1, int mid2, BaseMedialMesh* m2, std::vector<MipcConstraint*>& collisionEventsList);
 
+		virtual void computeSelfExclusionRing(int mid, BaseMedialMesh* m);
+		int getSelfExclusionHop(int mid, int i, int j);
+		bool isSelfSlabSphereExcluded(int mid, int sid, Vector3i slab);
+		bool isSelfConeConeExcluded(int mid, Vector2i c0, Vector2i c1);
+		bool isSelfRestExcluded(MipcConstraint* event);
+
+		virtual void genBroadPhaseCollisionEvents();
+		virtual void updateBroadPhaseCollisionEvents(const qeal* movingDir);
+		virtual void initBroadPhaseStaticTree();
+		virtual void computeBroadPhaseBoxes(const qeal* movingDir, int begin, int end, std::vector<qeal>& boxes, qeal pad = -1.0);
+		virtual void computeBroadPhasePairs(const std::vector<qeal>& boxes, bool rebuild, std::vector<std::pair<int, int>>& pairs);
+		virtual int getBroadPhaseEvent(int a, int b, bool atRest = false);
+		virtual int createBroadPhaseEvent(int a, int b, bool atRest);
+		virtual void uploadCollisionEventList();
+		virtual void buildReducedSparsePattern();
+		// false when a frame pair of the event lies outside the current pattern
+		bool setReducedBlockSlot(MipcConstraint* event);
+		virtual void uploadReducedSparsePattern();
+
 		bool enableFriction = false;
 		int _sysReducedDim;
 		std::vector<int> _sysNonStaticFrameOverallId;
@@ -112,6 +207,13 @@ namespace MIPC
 		int _translationFramesNum;
 		int _nonStaticFramesNum;
 		std::vector<ReducedFrame*> _reducedFrameList;
+		// non-static frames sorted by type, frames of type t are [_hostFrameBatchOffset[t - 1], _hostFrameBatchOffset[t]); the rest
+		// positions are struct of arrays, x of all the frames of a type, then y, then z
+		std::vector<int> _hostFrameBatchOffset;
+		std::vector<int> _hostFrameBatchPointId;
+		std::vector<int> _hostFrameBatchReducedOffset;
+		std::vector<qeal> _hostFrameBatchRestPosition;
+		std::vector<ReducedFrame*> _hostFrameBatchFrame;
 
 		// IPC
 		qeal _kappa; qeal _dHat;
@@ -124,6 +226,66 @@ namespace MIPC
 		std::vector<MipcConstraint*> _overallCollisionEvents;
 		std::vector<MipcConstraint*> _activeCollisionEvents;
 		std::vector<MipcConstraint*> _frictionCollisionEvents;
+		// events in the same color share no frame, so their blocks can be filled concurrently
+		bool _parallelAssembly;
+		std::vector<std::vector<int>> _assembleColorList;
+		std::vector<int> _assembleSerialList;
+		bool _warmStartDistance;
+		bool _motionBudgetFilter;
+		// self pairs within _selfExclusionRing hops on the medial graph never form events (cones use one hop less),
+		// nor do self pairs closer than _selfExclusionRestDistance at rest
+		int _selfExclusionRing;
+		qeal _selfExclusionRestDistance;
+		std::vector<std::vector<std::vector<int>>> _selfExclusionRingId;
+		std::vector<std::vector<std::vector<int>>> _selfExclusionRingHop;
+		// dHat-padded aabb per model (deformable ones first, then static ones), swept and pruned along x;
+		// events between models whose boxes are apart are inactive without evaluation
+		bool _modelCulling;
+		std::vector<qeal> _modelBoundingBox;
+		std::vector<char> _modelPairNear;
+		// split once per step: hot events are evaluated every iteration, cold events join them only when
+		// the frames have moved far enough since the step start to bring them within dHat
+		bool _hotColdEvents;
+		qeal _hotColdMotionScale;
+		std::vector<MipcConstraint*> _hotCollisionEvents;
+		std::vector<MipcConstraint*> _coldCollisionEvents;
+		std::vector<qeal> _coldCollisionBudget;
+		int _coldPromotedNum;
+		qeal _hotColdBudget;
+		std::vector<qeal> _hotColdStepFramePosition;
+		// toi on the cpu threads instead of MPsCCD, stops early once some event is below _hostCCDLowerBound
+		bool _hostCCD;
+		qeal _hostCCDLowerBound;
+		// the full space direction and positions read back on the cpu are projected there from the reduced ones already on the host
+		bool _hostProjection;
+		// render only: the surface points come straight from the reduced coordinates and the tet points are not rebuilt every step
+		bool _surfaceSkinning;
+		// per scene: exact sextic roots (MPsCCD) or additive ccd on the cpu threads, which keeps _accdGap of the starting distance
+		CCDType _ccdType;
+		qeal _accdGap;
+
+		// broad phase over medial spheres, cones and slabs (bvh or spatial hash), the candidate events are regenerated every newton iteration
+		// from the primitive boxes swept along the search direction
+		BroadPhaseType _broadPhase;
+		CDMM::MedialPrimitiveBVH _broadPhaseTree;
+		// many small objects: a uniform hash rebuilt every update instead of a refitted tree
+		CDMM::MedialPrimitiveSpatialHash _broadPhaseHash;
+		std::vector<int> _broadPhasePrimitiveType;
+		// primitives of static models follow the deformable ones and live in their own tree, built once
+		int _broadPhaseDeformablePrimitivesNum;
+		CDMM::MedialPrimitiveBVH _broadPhaseStaticTree;
+		std::string _staticBVHFilename;
+		// deformable model id, or -id - 1 for static models
+		std::vector<int> _broadPhasePrimitiveModel;
+		// 3 per primitive, -1 if unused; overall ids index the deformable or the static buffers
+		std::vector<int> _broadPhasePrimitiveVertices;
+		std::vector<int> _broadPhasePrimitiveLocalVertices;
+		// events are kept across iterations so their warm start & reduced jacobian survive
+		std::vector<MipcConstraint*> _broadPhaseEventPool;
+		std::vector<int> _broadPhaseEventPoolList;
+		// primitive pair -> pool index, -1 for pairs that never form an event
+		std::unordered_map<long long, int> _broadPhaseEventIndex;
+		std::vector<qeal> _hostMedialPointMovingDir;
 
 		//Gpu
 		long long int gpuSize;
@@ -202,7 +364,6 @@ namespace MIPC
 		int* _devReducedSparseElasticsHessinaCsrNonZero;
 		// reduced sparse collision & friction hessina matrix
 		SparseMatrix _hostReducedSparseCFHessina;
-		std::vector<TripletX> _hostCFHessinaTriplet;
 		std::vector<int> _hostReducedSparseCFHessinaCsrRowPtr;
 		int* _devReducedSparseCFHessinaCsrRowPtr;
 		std::vector<int> _hostReducedSparseCFHessinaCsrColInd;
@@ -221,9 +382,25 @@ namespace MIPC
 		qeal* _devReducedSparseSysMatrixCsrVal;
 		int _hostReducedSparseSysMatrixCsrNonZero;
 		int* _devReducedSparseSysMatrixCsrNonZero;
+		// the device column and value buffers keep headroom, a pattern grown during the solve is copied in place
+		int _hostReducedSparseSysMatrixCsrCapacity;
+		std::vector<std::map<int, int>> _reducedSparseFrameColumnSlot;
 
 		// stiffness & projection & assemble
-		int* _devTotalTetElementNum;
+		// elements the elastic forces, stiffness and energy are evaluated on, all of them or the cubature elements of a model, the element
+		// buffers follow this list and the cubature weights scale the element volumes
+		int _hostElasticElementNum;
+		int* _devElasticElementNum;
+		std::vector<int> _hostElasticElementModel;
+		std::vector<int> _hostElasticElementId;
+		std::vector<qeal> _hostElasticElementWeight;
+		// models whose elastic force comes from the precomputed stvk polynomial, they have no elements in the list above
+		std::vector<int> _hostStVKModel;
+		std::vector<qeal*> _devStVKK;
+		std::vector<qeal*> _devStVKV;
+		std::vector<qeal*> _devStVKW;
+		// y, U, S, R, T, Pm, H, Vy and g of the largest stvk model
+		qeal* _devStVKBuffer;
 		int* _devNonStaticFramesNum;
 		int* _devTotalTetPointsNum;
 
@@ -252,17 +429,44 @@ namespace MIPC
 		std::vector<int> _hostFrameBufferOffset;
 		std::vector<int> _hostFrameBufferDim;
 
-		std::vector<qeal*> _devTetPointProjectionXYZ;
-		std::vector<int> _hostTetPointProjectionRowsXYZ;
-		std::vector<int> _hostTetPointProjectionColsXYZ;
+		std::vector<int> _hostTetPointFrameProjectionNum;
+		std::vector<int> _hostTetPointFrameProjectionOffset;
+		std::vector<int> _hostTetPointFrameProjectionFrame;
+		std::vector<int> _hostTetPointFrameProjectionCoeffNum;
+		std::vector<int> _hostTetPointFrameProjectionBufferOffset;
+		std::vector<qeal> _hostTetPointFrameProjectionBuffer;
+		std::vector<int> _hostFrameReducedOffset;
+		std::vector<int> _hostFrameCoeffNum;
+		std::vector<int> _hostFrameTetPointProjectionNum;
+		std::vector<int> _hostFrameTetPointProjectionOffset;
+		std::vector<int> _hostFrameTetPointProjectionBufferOffset;
+		std::vector<int> _hostFrameTetPointProjectionPoint;
+		std::vector<qeal> _hostFrameTetPointProjectionBuffer;
+
+		int* _devTetPointFrameProjectionNum;
+		int* _devTetPointFrameProjectionOffset;
+		int* _devTetPointFrameProjectionFrame;
+		int* _devTetPointFrameProjectionCoeffNum;
+		int* _devTetPointFrameProjectionBufferOffset;
+		qeal* _devTetPointFrameProjectionBuffer;
+
+		int* _devFrameReducedOffset;
+		int* _devFrameCoeffNum;
+		int* _devFrameTetPointProjectionNum;
+		int* _devFrameTetPointProjectionOffset;
+		int* _devFrameTetPointProjectionBufferOffset;
+		int* _devFrameTetPointProjectionPoint;
+		qeal* _devFrameTetPointProjectionBuffer;
 
 		std::vector<qeal*> _devTetElementProjectionXYZ;
 		std::vector<int> _hostTetElementProjectionRowsXYZ;
 		std::vector<int> _hostTetElementProjectionColsXYZ;
 
 		qeal* _devTetElementFrameProjectionBuffer;
-		int* _devTetElementFrameProjectionNum;
-		int* _devTetElementFrameProjectionOffset;
+		int* _devTetElementFrameProjectionCoeffNum;
+		int* _devTetElementFrameProjectionBufferOffset;
+		// largest frame dim, the thread block of assembleReducedStiffness is this square
+		int _hostAssembleBlockDim;
 
 		int _hostPojectionStiffnessNum;
 		int* _devPojectionStiffnessNum;
@@ -273,8 +477,12 @@ namespace MIPC
 		int* _devTetElementSharedFrameOffset;
 
 		int _hostAssembleBlockNum;
+		std::vector<int> _hostAssembleBlockIndex;
 		int* _devAssembleBlockNum;
 		int* _devAssembleBlockIndex;
+		// sparse system only, per block the column slot of jFrame in the rows of iFrame and of iFrame in the rows of jFrame
+		std::vector<int> _hostAssembleBlockCsrSlot;
+		int* _devAssembleBlockCsrSlot;
 		int* _devStiffnessBlockSharedTetElementList;
 		int* _devStiffnessBlockSharedTetElementNum;
 		int* _devStiffnessBlockSharedTetElementOffset;
@@ -290,7 +498,9 @@ namespace MIPC
 		std::vector<std::set<int>> relTetElementSet;
 		// gpu medial mesh
 		int* _devMedialPointsNum;
-		qeal* _devMedialOriPointPosition;
+		int* _devFrameBatchPointId;
+		int* _devFrameBatchReducedOffset;
+		qeal* _devFrameBatchRestPosition;
 		qeal* _devMedialPointPosition;
 		qeal* _devMedialPointRadius;
 		qeal* _devStaticMedialPointPosition;
@@ -298,6 +508,7 @@ namespace MIPC
 		qeal* _devMedialPointMovingDir;
 		// gpu ccd
 		int _hostCollisionEventNum;
+		int _hostCollisionEventCapacity;
 		int* _devCollisionEventNum;
 		std::vector<int> _hostCollisionEventList;
 		int* _devCollisionEventList;
@@ -1,6 +1,7 @@
 #include "GpuFunc.cuh"
 #include "Simulator\Cuda\CudaMatrixOperator.cu"
 #include "Simulator\Cuda\CudaSVD.cu"
+#include "Simulator\FiniteElementMethod\StableNeoHookean.h"
 
 namespace MIPC
 {	
@@ -234,21 +235,8 @@ namespace MIPC
 			qeal F[9];
 			getMutilMatrix(Ds, invDm, F);
 
-			qeal Ic = F[0] * F[0] + F[3] * F[3] + F[6] * F[6] +
-				F[1] * F[1] + F[4] * F[4] + F[7] * F[7] +
-				F[2] * F[2] + F[5] * F[5] + F[8] * F[8];
-
-			qeal J = getMatrix3Determinant(F);
-
 			qeal lameMu = devTetElementAttri[3 * eleId + 1], lameLamda = devTetElementAttri[3 * eleId + 2];
-
-			//qeal miu = (4.0 * lameMu) / 3.0;
-			//qeal lamda = lameLamda + (5.0 * lameMu) / 6.0;
-			qeal mu = lameMu;
-			qeal lamda = lameLamda;
-
-			qeal alpha = 1.0 + (3.0 * mu) / (4.0 * lamda);
-			qeal e = 0.5 * mu * (Ic - 3.0) + 0.5 * lamda * (J - alpha) *  (J - alpha) - 0.5 * mu * log(Ic + 1);
+			qeal e = FiniteElementMethod::stableNeoHookeanEnergy(F, lameMu, lameLamda);
 
 			devTetElementPotentialEnergy[eleId] = timeStep * timeStep * v * e;
 		}
@@ -362,6 +350,132 @@ namespace MIPC
 		}
 	}
 
+	__host__ void csrMatrixVectorProduct
+	(
+		int hostDim,
+		int* devDim,
+		int* devCsrRowPtr,
+		int* devCsrColInd,
+		qeal* devCsrVal,
+		qeal* devX,
+		qeal* devY
+	)
+	{
+		dim3 blockSize(THREADS_NUM);
+		uint32_t size = hostDim;
+		uint32_t num_block = (size + (THREADS_NUM - 1)) / THREADS_NUM;
+		dim3 gridSize(num_block);
+
+		csrMatrixVectorProduct << <gridSize, blockSize >> >
+			(
+				devDim,
+				devCsrRowPtr,
+				devCsrColInd,
+				devCsrVal,
+				devX,
+				devY
+				);
+		cudaDeviceSynchronize();
+	}
+
+	__global__ void csrMatrixVectorProduct
+	(
+		int* devDim,
+		int* devCsrRowPtr,
+		int* devCsrColInd,
+		qeal* devCsrVal,
+		qeal* devX,
+		qeal* devY
+	)
+	{
+		__shared__ int dim;
+		const int length = gridDim.x *  blockDim.x;
+		int tid = (blockIdx.x  * blockDim.x) + threadIdx.x;
+		if (threadIdx.x == 0)
+		{
+			dim = *devDim;
+		}
+		__syncthreads();
+
+		// one row per thread
+		for (; tid < dim; tid += length)
+		{
+			qeal value = 0;
+			for (int k = devCsrRowPtr[tid]; k < devCsrRowPtr[tid + 1]; k++)
+				value += devCsrVal[k] * devX[devCsrColInd[k]];
+			devY[tid] = value;
+		}
+	}
+
+	__host__ void addDenseBlockToCsr
+	(
+		int rows,
+		int cols,
+		int rowOffset,
+		int colOffset,
+		qeal* devBlock,
+		qeal scale,
+		int* devCsrRowPtr,
+		int* devCsrColInd,
+		qeal* devCsrVal
+	)
+	{
+		dim3 blockSize(THREADS_NUM);
+		uint32_t size = rows * cols;
+		uint32_t num_block = (size + (THREADS_NUM - 1)) / THREADS_NUM;
+		dim3 gridSize(num_block);
+
+		addDenseBlockToCsr << <gridSize, blockSize >> >
+			(
+				rows,
+				cols,
+				rowOffset,
+				colOffset,
+				devBlock,
+				scale,
+				devCsrRowPtr,
+				devCsrColInd,
+				devCsrVal
+				);
+		cudaDeviceSynchronize();
+	}
+
+	__global__ void addDenseBlockToCsr
+	(
+		int rows,
+		int cols,
+		int rowOffset,
+		int colOffset,
+		qeal* devBlock,
+		qeal scale,
+		int* devCsrRowPtr,
+		int* devCsrColInd,
+		qeal* devCsrVal
+	)
+	{
+		const int length = gridDim.x *  blockDim.x;
+		int tid = (blockIdx.x  * blockDim.x) + threadIdx.x;
+
+		// the block is column major, each entry is searched in the sorted columns of its row
+		for (; tid < rows * cols; tid += length)
+		{
+			int row = rowOffset + tid % rows;
+			int col = colOffset + tid / rows;
+			int lo = devCsrRowPtr[row];
+			int hi = devCsrRowPtr[row + 1] - 1;
+			while (lo < hi)
+			{
+				int mid = (lo + hi) / 2;
+				if (devCsrColInd[mid] < col)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (lo <= hi && devCsrColInd[lo] == col)
+				devCsrVal[lo] += scale * devBlock[tid];
+		}
+	}
+
 
 	__host__ void assembleTetELementX
 	(
@@ -578,26 +692,12 @@ namespace MIPC
 			qeal F[9];
 			getMutilMatrix(Ds, invDm, F);*/
 
-			qeal volume = devTetElementAttri[3 * eleId];
 			qeal lameMu = devTetElementAttri[3 * eleId + 1], lameLamda = devTetElementAttri[3 * eleId + 2];
 
-			qeal Ic = F[0] * F[0] + F[3] * F[3] + F[6] * F[6] +
-				F[1] * F[1] + F[4] * F[4] + F[7] * F[7] +
-				F[2] * F[2] + F[5] * F[5] + F[8] * F[8];
-
-			qeal J = getMatrix3Determinant(F);
-
-			qeal dJdF[9];
-			dJdF[0] = F[4] * F[8] - F[7] * F[5];   dJdF[3] = F[7] * F[2] - F[1] * F[8];	  dJdF[6] = F[1] * F[5] - F[4] * F[2];
-			dJdF[1] = F[6] * F[5] - F[3] * F[8];   dJdF[4] = F[0] * F[8] - F[6] * F[2];   dJdF[7] = F[3] * F[2] - F[0] * F[5];
-			dJdF[2] = F[3] * F[7] - F[6] * F[4];   dJdF[5] = F[6] * F[1] - F[0] * F[7];   dJdF[8] = F[0] * F[4] - F[3] * F[1];
-
-			qeal alpha = 1.0 + (3.0 * lameMu) / (4.0 * lameLamda);
-			qeal a0 = lameMu * (1.0 - 1.0 / (Ic + 1.0));
-			qeal a3 = lameLamda * (J - alpha);
-
+			qeal FPK[9];
+			FiniteElementMethod::stableNeoHookeanStress(F, lameMu, lameLamda, FPK);
 			for (int i = 0; i < 9; i++)
-				F[i] = a0 * F[i] + a3 * dJdF[i];
+				F[i] = FPK[i];
 		}
 	}
 
@@ -1042,31 +1142,14 @@ namespace MIPC
 	__device__ __forceinline__
 		void computeStableNeoHookean(int eleId, qeal * F, qeal * FPK, qeal * PF, qeal & lameMu, qeal & lameLamda)
 	{
-		qeal Ic = F[0] * F[0] + F[3] * F[3] + F[6] * F[6] +
-			F[1] * F[1] + F[4] * F[4] + F[7] * F[7] +
-			F[2] * F[2] + F[5] * F[5] + F[8] * F[8];
-
-		qeal J = getMatrix3Determinant(F);
-
-		qeal dJdF[9];
-		dJdF[0] = F[4] * F[8] - F[7] * F[5];   dJdF[3] = F[7] * F[2] - F[1] * F[8];	  dJdF[6] = F[1] * F[5] - F[4] * F[2];
-		dJdF[1] = F[6] * F[5] - F[3] * F[8];   dJdF[4] = F[0] * F[8] - F[6] * F[2];   dJdF[7] = F[3] * F[2] - F[0] * F[5];
-		dJdF[2] = F[3] * F[7] - F[6] * F[4];   dJdF[5] = F[6] * F[1] - F[0] * F[7];   dJdF[8] = F[0] * F[4] - F[3] * F[1];
-
-		qeal alpha = 1.0 + (3.0 * lameMu) / (4.0 * lameLamda);
-		qeal a0 = lameMu * (1.0 - 1.0 / (Ic + 1.0));
-		qeal a1 = 2.0 * lameMu / ((Ic + 1.0) * (Ic + 1.0));
-		qeal a2 = lameLamda;
-		qeal a3 = lameLamda * (J - alpha);
-
-		addMatrix3(F, dJdF, FPK, a0, a3);
-
+		FiniteElementMethod::stableNeoHookeanStress(F, lameMu, lameLamda, FPK);
 	}
 
 
 	__host__ void assembleReducedStiffness
 	(
 		int hostAssembleBlockIndexNum,
+		int hostAssembleBlockDim,
 		int* devAssembleBlockIndexNum,
 		int* devAssembleTask,
 		int* devStiffnessBlockSharedTetElementList,
@@ -1076,14 +1159,74 @@ namespace MIPC
 		int* devTetElementSharedFrameList,
 		int* devTetElementSharedFrameOffset,
 		qeal* devTetElementFrameProjectionBuffer,
-		int* devTetElementFrameProjectionNum,
-		int* devTetElementFrameProjectionOffset,
+		int* devTetElementFrameProjectionCoeffNum,
+		int* devTetElementFrameProjectionBufferOffset,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
 		qeal* devTetElementStiffness,
 		int* devReducedDim,
 		qeal* devReducedStiffness
 	)
 	{
-		dim3 blockSize(12, 12);
+		// one thread per entry of a frame pair block, at most 30 x 30 for two quadratic frames
+		assert(hostAssembleBlockDim * hostAssembleBlockDim <= MAX_THREADS_NUM);
+		dim3 blockSize(hostAssembleBlockDim, hostAssembleBlockDim);
+		dim3 gridSize(hostAssembleBlockIndexNum);
+
+		assembleReducedStiffness << <gridSize, blockSize >> >
+			(
+				devAssembleBlockIndexNum,
+				devAssembleTask,
+				devStiffnessBlockSharedTetElementList,
+				devAssembleTaskSharedTetElementNum,
+				devAssembleTaskSharedTetElementoffset,
+				devPojectionStiffnessList,
+				devTetElementSharedFrameList,
+				devTetElementSharedFrameOffset,
+				devTetElementFrameProjectionBuffer,
+				devTetElementFrameProjectionCoeffNum,
+				devTetElementFrameProjectionBufferOffset,
+				devFrameReducedOffset,
+				devFrameCoeffNum,
+				devTetElementStiffness,
+				devReducedDim,
+				devReducedStiffness,
+				nullptr,
+				nullptr,
+				nullptr,
+				0.0
+				);
+		cudaDeviceSynchronize();
+	}
+
+	__host__ void assembleReducedStiffnessToCsr
+	(
+		int hostAssembleBlockIndexNum,
+		int hostAssembleBlockDim,
+		int* devAssembleBlockIndexNum,
+		int* devAssembleTask,
+		int* devStiffnessBlockSharedTetElementList,
+		int* devAssembleTaskSharedTetElementNum,
+		int* devAssembleTaskSharedTetElementoffset,
+		int* devPojectionStiffnessList,
+		int* devTetElementSharedFrameList,
+		int* devTetElementSharedFrameOffset,
+		qeal* devTetElementFrameProjectionBuffer,
+		int* devTetElementFrameProjectionCoeffNum,
+		int* devTetElementFrameProjectionBufferOffset,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
+		qeal* devTetElementStiffness,
+		int* devReducedDim,
+		int* devAssembleTaskCsrSlot,
+		int* devCsrRowPtr,
+		qeal* devCsrVal,
+		qeal scale
+	)
+	{
+		// one thread per entry of a frame pair block, at most 30 x 30 for two quadratic frames
+		assert(hostAssembleBlockDim * hostAssembleBlockDim <= MAX_THREADS_NUM);
+		dim3 blockSize(hostAssembleBlockDim, hostAssembleBlockDim);
 		dim3 gridSize(hostAssembleBlockIndexNum);
 
 		assembleReducedStiffness << <gridSize, blockSize >> >
@@ -1097,11 +1240,17 @@ namespace MIPC
 				devTetElementSharedFrameList,
 				devTetElementSharedFrameOffset,
 				devTetElementFrameProjectionBuffer,
-				devTetElementFrameProjectionNum,
-				devTetElementFrameProjectionOffset,
+				devTetElementFrameProjectionCoeffNum,
+				devTetElementFrameProjectionBufferOffset,
+				devFrameReducedOffset,
+				devFrameCoeffNum,
 				devTetElementStiffness,
 				devReducedDim,
-				devReducedStiffness
+				nullptr,
+				devAssembleTaskCsrSlot,
+				devCsrRowPtr,
+				devCsrVal,
+				scale
 				);
 		cudaDeviceSynchronize();
 	}
@@ -1117,173 +1266,247 @@ namespace MIPC
 		int* devTetElementSharedFrameList,
 		int* devTetElementSharedFrameOffset,
 		qeal* devTetElementFrameProjectionBuffer,
-		int* devTetElementFrameProjectionNum,
-		int* devTetElementFrameProjectionOffset,
+		int* devTetElementFrameProjectionCoeffNum,
+		int* devTetElementFrameProjectionBufferOffset,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
 		qeal* devTetElementStiffness,
 		int* devReducedDim,
-		qeal* devReducedStiffness
+		qeal* devReducedStiffness,
+		int* devAssembleTaskCsrSlot,
+		int* devCsrRowPtr,
+		qeal* devCsrVal,
+		qeal scale
 	)
 	{
-		__shared__ int sharedInteger[6];
-		//
-		__shared__ qeal reducedStiffness[144];
-		__shared__ qeal SP[144];
+		__shared__ int sharedInteger[8];
+		// up to 10 coefficients per tet vertex (quadratic frames), SP is at most 12 x 30
+		__shared__ qeal SP[360];
 		__shared__ qeal S[144];
-		__shared__ qeal Uit[16];
-		__shared__ qeal Uj[16];
+		__shared__ qeal Ui[40];
+		__shared__ qeal Uj[40];
 
-		if (threadIdx.x == 0 && threadIdx.y == 0)
+		const int tid = blockDim.x * threadIdx.y + threadIdx.x;
+		const int threadsNum = blockDim.x * blockDim.y;
+		if (tid == 0)
 		{
+			int iFrameId = devAssembleTask[2 * blockIdx.x];
+			int jFrameId = devAssembleTask[2 * blockIdx.x + 1];
 			sharedInteger[0] = *devAssembleBlockIndexNum; // blockNum
 			sharedInteger[1] = *devReducedDim; // reduced dim
-			sharedInteger[2] = 12 * devAssembleTask[2 * blockIdx.x]; // iFrameId * 12
-			sharedInteger[3] = 12 * devAssembleTask[2 * blockIdx.x + 1]; // jFrameId * 12
+			sharedInteger[2] = devFrameReducedOffset[iFrameId]; // reduced offset of iFrame
+			sharedInteger[3] = devFrameReducedOffset[jFrameId]; // reduced offset of jFrame
 			sharedInteger[4] = devAssembleTaskSharedTetElementoffset[blockIdx.x]; // offset
 			sharedInteger[5] = devAssembleTaskSharedTetElementNum[blockIdx.x]; // num;
+			sharedInteger[6] = 3 * devFrameCoeffNum[iFrameId]; // dim of iFrame
+			sharedInteger[7] = 3 * devFrameCoeffNum[jFrameId]; // dim of jFrame
 		}
-		reducedStiffness[12 * threadIdx.y + threadIdx.x] = 0;
 		__syncthreads();
+		const int iDim = sharedInteger[6];
+		const int jDim = sharedInteger[7];
+		const bool active = threadIdx.x < iDim && threadIdx.y < jDim;
+		// row 3 * a + c of the block is axis c of coefficient a of iFrame, the column likewise for jFrame
+		const int ridx = threadIdx.x % 3;
+		const int r = threadIdx.x / 3;
+		qeal value = 0;
 
-#pragma unroll
 		for (int i = 0; i < sharedInteger[5]; i++)
 		{
 			int index = devStiffnessBlockSharedTetElementList[sharedInteger[4] + i];
 
 			int eleId = devPojectionStiffnessList[3 * index];
-			int UitIndex = devPojectionStiffnessList[3 * index + 1];
-			int UjIndex = devPojectionStiffnessList[3 * index + 2];
 			int offset = devTetElementSharedFrameOffset[eleId];
-			qeal* localUi = devTetElementFrameProjectionBuffer + 16 * (offset + UitIndex);
-			qeal* localUj = devTetElementFrameProjectionBuffer + 16 * (offset + UjIndex);
+			int UiIndex = offset + devPojectionStiffnessList[3 * index + 1];
+			int UjIndex = offset + devPojectionStiffnessList[3 * index + 2];
+			// coefficient a of vertex v at 4 * a + v
+			qeal* localUi = devTetElementFrameProjectionBuffer + devTetElementFrameProjectionBufferOffset[UiIndex];
+			qeal* localUj = devTetElementFrameProjectionBuffer + devTetElementFrameProjectionBufferOffset[UjIndex];
 			qeal* stiffness = devTetElementStiffness + 144 * eleId;
 
-			int ridx = threadIdx.x % 3;
-			int cidx = threadIdx.y % 3;
-			int r = (threadIdx.x - ridx) / 3;
-			int c = (threadIdx.y - cidx) / 3;
 			__syncthreads();
-
-			S[12 * threadIdx.y + threadIdx.x] = stiffness[12 * threadIdx.y + threadIdx.x];
+			for (int k = tid; k < 144; k += threadsNum)
+				S[k] = stiffness[k];
+			for (int k = tid; k < 4 * devTetElementFrameProjectionCoeffNum[UiIndex]; k += threadsNum)
+				Ui[k] = localUi[k];
+			for (int k = tid; k < 4 * devTetElementFrameProjectionCoeffNum[UjIndex]; k += threadsNum)
+				Uj[k] = localUj[k];
 			__syncthreads();
 
-			if (ridx == 0 && cidx == 0)
+			// SP = S * Uj, 12 x jDim
+			for (int k = tid; k < 12 * jDim; k += threadsNum)
 			{
-				Uj[4 * c + r] = localUj[4 * c + r];
-				Uit[4 * r + c] = localUi[4 * c + r];
+				int row = k % 12;
+				int col = k / 12;
+				int cidx = col % 3;
+				int c = col / 3;
+				SP[k] = S[12 * (3 * 0 + cidx) + row] * Uj[4 * c + 0] + S[12 * (3 * 1 + cidx) + row] * Uj[4 * c + 1] + S[12 * (3 * 2 + cidx) + row] * Uj[4 * c + 2] + S[12 * (3 * 3 + cidx) + row] * Uj[4 * c + 3];
 			}
 			__syncthreads();
 
-			SP[12 * threadIdx.y + threadIdx.x] = S[12 * (3 * 0 + cidx) + threadIdx.x] * Uj[4 * c + 0] + S[12 * (3 * 1 + cidx) + threadIdx.x] * Uj[4 * c + 1] + S[12 * (3 * 2 + cidx) + threadIdx.x] * Uj[4 * c + 2] + S[12 * (3 * 3 + cidx) + threadIdx.x] * Uj[4 * c + 3];
-			__syncthreads();
+			if (active)
+				value += Ui[4 * r + 0] * SP[12 * threadIdx.y + 3 * 0 + ridx] + Ui[4 * r + 1] * SP[12 * threadIdx.y + 3 * 1 + ridx] + Ui[4 * r + 2] * SP[12 * threadIdx.y + 3 * 2 + ridx] + Ui[4 * r + 3] * SP[12 * threadIdx.y + 3 * 3 + ridx];
+		}
+		if (!active)
+			return;
 
-			reducedStiffness[12 * threadIdx.y + threadIdx.x] += Uit[4 * 0 + r] * SP[12 * (3 * c + cidx) + 3 * 0 + ridx] + Uit[4 * 1 + r] * SP[12 * (3 * c + cidx) + 3 * 1 + ridx] + Uit[4 * 2 + r] * SP[12 * (3 * c + cidx) + 3 * 2 + ridx] + Uit[4 * 3 + r] * SP[12 * (3 * c + cidx) + 3 * 3 + ridx];
+		if (devCsrVal != nullptr)
+		{
+			// jFrame's columns start at the task's slot in every row of iFrame and the other way round,
+			// each entry belongs to a single task so it is added without atomics
+			int iRow = sharedInteger[2] + threadIdx.x;
+			int jRow = sharedInteger[3] + threadIdx.y;
+			devCsrVal[devCsrRowPtr[iRow] + devAssembleTaskCsrSlot[2 * blockIdx.x] + threadIdx.y] += scale * value;
+			if (sharedInteger[2] != sharedInteger[3])
+				devCsrVal[devCsrRowPtr[jRow] + devAssembleTaskCsrSlot[2 * blockIdx.x + 1] + threadIdx.x] += scale * value;
+			return;
 		}
-		__syncthreads();
 
 		qeal* stiffness = devReducedStiffness + (sharedInteger[3] + threadIdx.y) * sharedInteger[1] + sharedInteger[2] + threadIdx.x;
-		stiffness[0] = reducedStiffness[12 * threadIdx.y + threadIdx.x];
+		stiffness[0] = value;
 		if (sharedInteger[2] != sharedInteger[3])
 		{
 			stiffness = devReducedStiffness + (sharedInteger[2] + threadIdx.x) * sharedInteger[1] + sharedInteger[3] + threadIdx.y;
-			stiffness[0] = reducedStiffness[12 * threadIdx.y + threadIdx.x];
+			stiffness[0] = value;
 		}
 	}
 
 
-	__host__ void computeMedialPointsMovingDir
+	__host__ void transformReducedFrames
 	(
-		int hostMedialPointsNum,
-		int* devMedialPointsNum,
-		qeal* devMedialOriPointPosition,
-		qeal* devReducedXtilde,
+		int hostFramesNum,
+		int type,
+		int* devFramePointId,
+		int* devFrameReducedOffset,
+		qeal* devFrameRestPosition,
+		qeal* devReducedX,
+		qeal* devReducedDir,
+		qeal* devMedialPointPosition,
 		qeal* devMedialPointMovingDir
 	)
 	{
 		dim3 blockSize(THREADS_NUM);
-		uint32_t num_block = (hostMedialPointsNum + (THREADS_NUM - 1)) / THREADS_NUM;
+		uint32_t num_block = (hostFramesNum + (THREADS_NUM - 1)) / THREADS_NUM;
 		dim3 gridSize(num_block);
-		computeMedialPointsMovingDir << <gridSize, blockSize >> >
+		transformReducedFrames << <gridSize, blockSize >> >
 			(
-				devMedialPointsNum,
-				devMedialOriPointPosition,
-				devReducedXtilde,
+				hostFramesNum,
+				type,
+				devFramePointId,
+				devFrameReducedOffset,
+				devFrameRestPosition,
+				devReducedX,
+				devReducedDir,
+				devMedialPointPosition,
 				devMedialPointMovingDir
 				);
 		cudaDeviceSynchronize();
 	}
 
-	__global__ void computeMedialPointsMovingDir
+	__global__ void transformReducedFrames
 	(
-		int* devMedialPointsNum,
-		qeal* devMedialOriPointPosition,
-		qeal* devReducedXtilde,
+		int framesNum,
+		int type,
+		int* devFramePointId,
+		int* devFrameReducedOffset,
+		qeal* devFrameRestPosition,
+		qeal* devReducedX,
+		qeal* devReducedDir,
+		qeal* devMedialPointPosition,
 		qeal* devMedialPointMovingDir
 	)
 	{
-		__shared__ qeal oriXYZ[1536]; // 3 * THREADS_NUM
-		__shared__ int num;
 		const int length = gridDim.x *  blockDim.x;
 		int tid = (blockIdx.x  * blockDim.x) + threadIdx.x;
-		if (threadIdx.x == 0)
+		for (; tid < framesNum; tid += length)
 		{
-			num = *devMedialPointsNum;
-		}
-		__syncthreads();
-		if (tid < num)
-		{
-			oriXYZ[3 * threadIdx.x] = devMedialOriPointPosition[3 * tid]; // x
-			oriXYZ[3 * threadIdx.x + 1] = devMedialOriPointPosition[3 * tid + 1]; //y
-			oriXYZ[3 * threadIdx.x + 2] = devMedialOriPointPosition[3 * tid + 2]; // z
-		}
-		__syncthreads();
-		for (; tid < num; tid += length)
-		{
-			devMedialPointMovingDir[3 * tid] = oriXYZ[3 * threadIdx.x] * devReducedXtilde[12 * tid] + oriXYZ[3 * threadIdx.x + 1] * devReducedXtilde[12 * tid + 3] + oriXYZ[3 * threadIdx.x + 2] * devReducedXtilde[12 * tid + 6] + devReducedXtilde[12 * tid + 9];
-
-			devMedialPointMovingDir[3 * tid + 1] = oriXYZ[3 * threadIdx.x] * devReducedXtilde[12 * tid + 1] + oriXYZ[3 * threadIdx.x + 1] * devReducedXtilde[12 * tid + 4] + oriXYZ[3 * threadIdx.x + 2] * devReducedXtilde[12 * tid + 7] + devReducedXtilde[12 * tid + 10];
+			// coalesced reads of the rest positions, the type is the same over the launch so there is no divergence
+			qeal x = devFrameRestPosition[tid];
+			qeal y = devFrameRestPosition[framesNum + tid];
+			qeal z = devFrameRestPosition[2 * framesNum + tid];
+			// monomials of the rest position, component c of monomial k at reduced offset + 3 * k + c
+			qeal basis[10];
+			int basisNum;
+			if (type == 1)
+			{
+				basis[0] = x; basis[1] = y; basis[2] = z; basis[3] = 1.0;
+				basisNum = 4;
+			}
+			else if (type == 2)
+			{
+				basis[0] = x; basis[1] = y; basis[2] = z;
+				basis[3] = x * x; basis[4] = y * y; basis[5] = z * z;
+				basis[6] = x * y; basis[7] = y * z; basis[8] = x * z; basis[9] = 1.0;
+				basisNum = 10;
+			}
+			else
+			{
+				basis[0] = 1.0;
+				basisNum = 1;
+			}
 
-			devMedialPointMovingDir[3 * tid + 2] = oriXYZ[3 * threadIdx.x] * devReducedXtilde[12 * tid + 2] + oriXYZ[3 * threadIdx.x + 1] * devReducedXtilde[12 * tid + 5] + oriXYZ[3 * threadIdx.x + 2] * devReducedXtilde[12 * tid + 8] + devReducedXtilde[12 * tid + 11];
+			int offset = devFrameReducedOffset[tid];
+			qeal d[3] = { 0.0, 0.0, 0.0 };
+			qeal v[3] = { 0.0, 0.0, 0.0 };
+			for (int k = 0; k < basisNum; k++)
+				for (int c = 0; c < 3; c++)
+				{
+					d[c] += basis[k] * devReducedX[offset + 3 * k + c];
+					v[c] += basis[k] * devReducedDir[offset + 3 * k + c];
+				}
+
+			int pid = devFramePointId[tid];
+			devMedialPointPosition[3 * pid] = x + d[0];
+			devMedialPointPosition[3 * pid + 1] = y + d[1];
+			devMedialPointPosition[3 * pid + 2] = z + d[2];
+			devMedialPointMovingDir[3 * pid] = v[0];
+			devMedialPointMovingDir[3 * pid + 1] = v[1];
+			devMedialPointMovingDir[3 * pid + 2] = v[2];
 		}
-
 	}
 
-	__host__ void fillTetElementFrameProjectionBuffer
+	__host__ void projectReducedToTetPoints
 	(
-		int hostTetElementNum,
-		int* devTetElementNum,
-		int* devTetElementIndices,
-		qeal* devTetPoints,
-		qeal* devTetElementFrameWeightList,
-		int* devTetElementFrameProjectionNum,
-		int* devTetElementFrameProjectionOffset,
-		qeal* devTetElementFrameProjectionBuffer
+		int hostTetPointsNum,
+		int* devTetPointsNum,
+		int* devTetPointFrameProjectionNum,
+		int* devTetPointFrameProjectionOffset,
+		int* devTetPointFrameProjectionFrame,
+		int* devTetPointFrameProjectionCoeffNum,
+		int* devTetPointFrameProjectionBufferOffset,
+		qeal* devTetPointFrameProjectionBuffer,
+		qeal* devReduced,
+		qeal* devX
 	)
 	{
 		dim3 blockSize(THREADS_NUM);
-		uint32_t num_block = (hostTetElementNum + (THREADS_NUM - 1)) / THREADS_NUM;
+		uint32_t num_block = (hostTetPointsNum + (THREADS_NUM - 1)) / THREADS_NUM;
 		dim3 gridSize(num_block);
-		fillTetElementFrameProjectionBuffer << <gridSize, blockSize >> >
+		projectReducedToTetPoints << <gridSize, blockSize >> >
 			(
-				devTetElementNum,
-				devTetElementIndices,
-				devTetPoints,
-				devTetElementFrameWeightList,
-				devTetElementFrameProjectionNum,
-				devTetElementFrameProjectionOffset,
-				devTetElementFrameProjectionBuffer
+				devTetPointsNum,
+				devTetPointFrameProjectionNum,
+				devTetPointFrameProjectionOffset,
+				devTetPointFrameProjectionFrame,
+				devTetPointFrameProjectionCoeffNum,
+				devTetPointFrameProjectionBufferOffset,
+				devTetPointFrameProjectionBuffer,
+				devReduced,
+				devX
 				);
-		CUDA_CALL(cudaDeviceSynchronize());
+		cudaDeviceSynchronize();
 	}
 
-	__global__ void fillTetElementFrameProjectionBuffer
+	__global__ void projectReducedToTetPoints
 	(
-		int* devTetElementNum,
-		int* devTetElementIndices,
-		qeal* devTetPoints,
-		qeal* devTetElementFrameWeightList,
-		int* devTetElementFrameProjectionNum,
-		int* devTetElementFrameProjectionOffset,
-		qeal* devTetElementFrameProjectionBuffer
+		int* devTetPointsNum,
+		int* devTetPointFrameProjectionNum,
+		int* devTetPointFrameProjectionOffset,
+		int* devTetPointFrameProjectionFrame,
+		int* devTetPointFrameProjectionCoeffNum,
+		int* devTetPointFrameProjectionBufferOffset,
+		qeal* devTetPointFrameProjectionBuffer,
+		qeal* devReduced,
+		qeal* devX
 	)
 	{
 		__shared__ int num;
@@ -1291,68 +1514,128 @@ namespace MIPC
 		int tid = (blockIdx.x  * blockDim.x) + threadIdx.x;
 		if (threadIdx.x == 0)
 		{
-			num = *devTetElementNum;
+			num = *devTetPointsNum;
 		}
 		__syncthreads();
-
 		for (; tid < num; tid += length)
 		{
-			int offset = devTetElementFrameProjectionOffset[tid];
-			int frameNum = devTetElementFrameProjectionNum[tid];
-			qeal* weight = devTetElementFrameWeightList + 4 * offset;
-			qeal* buffer = devTetElementFrameProjectionBuffer + 16 * offset;
-
-			int v0 = devTetElementIndices[4 * tid];
-			int v1 = devTetElementIndices[4 * tid + 1];
-			int v2 = devTetElementIndices[4 * tid + 2];
-			int v3 = devTetElementIndices[4 * tid + 3];
-
-			qeal v0x = devTetPoints[3 * v0];
-			qeal v0y = devTetPoints[3 * v0 + 1];
-			qeal v0z = devTetPoints[3 * v0 + 2];
-
-			qeal v1x = devTetPoints[3 * v1];
-			qeal v1y = devTetPoints[3 * v1 + 1];
-			qeal v1z = devTetPoints[3 * v1 + 2];
-
-			qeal v2x = devTetPoints[3 * v2];
-			qeal v2y = devTetPoints[3 * v2 + 1];
-			qeal v2z = devTetPoints[3 * v2 + 2];
-
-			qeal v3x = devTetPoints[3 * v3];
-			qeal v3y = devTetPoints[3 * v3 + 1];
-			qeal v3z = devTetPoints[3 * v3 + 2];
-
+			int framesNum = devTetPointFrameProjectionNum[tid];
+			int offset = devTetPointFrameProjectionOffset[tid];
+			qeal x = 0, y = 0, z = 0;
+			for (int i = offset; i < offset + framesNum; i++)
+			{
+				int coeffNum = devTetPointFrameProjectionCoeffNum[i];
+				qeal* u = devTetPointFrameProjectionBuffer + devTetPointFrameProjectionBufferOffset[i];
+				qeal* r = devReduced + devTetPointFrameProjectionFrame[i];
+				for (int c = 0; c < coeffNum; c++)
+				{
+					x += u[c] * r[3 * c];
+					y += u[c] * r[3 * c + 1];
+					z += u[c] * r[3 * c + 2];
+				}
+			}
+			devX[3 * tid] = x;
+			devX[3 * tid + 1] = y;
+			devX[3 * tid + 2] = z;
+		}
+	}
 
+	__host__ void projectTetPointsToReduced
+	(
+		int hostFramesNum,
+		int* devFramesNum,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
+		int* devFrameTetPointProjectionNum,
+		int* devFrameTetPointProjectionOffset,
+		int* devFrameTetPointProjectionBufferOffset,
+		int* devFrameTetPointProjectionPoint,
+		qeal* devFrameTetPointProjectionBuffer,
+		qeal* devX,
+		qeal* devReduced
+	)
+	{
+		if (hostFramesNum == 0)
+			return;
+		dim3 blockSize(THREADS_NUM_128);
+		dim3 gridSize(hostFramesNum);
+		projectTetPointsToReduced << <gridSize, blockSize >> >
+			(
+				devFramesNum,
+				devFrameReducedOffset,
+				devFrameCoeffNum,
+				devFrameTetPointProjectionNum,
+				devFrameTetPointProjectionOffset,
+				devFrameTetPointProjectionBufferOffset,
+				devFrameTetPointProjectionPoint,
+				devFrameTetPointProjectionBuffer,
+				devX,
+				devReduced
+				);
+		cudaDeviceSynchronize();
+	}
 
-			for (int i = 0; i < frameNum; i++)
+	__global__ void projectTetPointsToReduced
+	(
+		int* devFramesNum,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
+		int* devFrameTetPointProjectionNum,
+		int* devFrameTetPointProjectionOffset,
+		int* devFrameTetPointProjectionBufferOffset,
+		int* devFrameTetPointProjectionPoint,
+		qeal* devFrameTetPointProjectionBuffer,
+		qeal* devX,
+		qeal* devReduced
+	)
+	{
+		// one block per frame, the threads stride over its tet points and their sums are reduced by warp shuffles
+		__shared__ qeal warpSum[30][THREADS_NUM_128 / 32];
+		int fid = blockIdx.x;
+		if (fid >= *devFramesNum)
+			return;
+		int pointsNum = devFrameTetPointProjectionNum[fid];
+		int offset = devFrameTetPointProjectionOffset[fid];
+		int coeffNum = devFrameCoeffNum[fid];
+		qeal* buffer = devFrameTetPointProjectionBuffer + devFrameTetPointProjectionBufferOffset[fid];
+		qeal r[30]; // quadratic frames have the most dofs
+		#pragma unroll
+		for (int k = 0; k < 30; k++)
+			r[k] = 0;
+		for (int i = threadIdx.x; i < pointsNum; i += blockDim.x)
+		{
+			qeal* u = buffer + coeffNum * i;
+			qeal* x = devX + 3 * devFrameTetPointProjectionPoint[offset + i];
+			#pragma unroll
+			for (int c = 0; c < 10; c++)
 			{
-				qeal w0 = weight[4 * i + 0];
-				qeal w1 = weight[4 * i + 1];
-				qeal w2 = weight[4 * i + 2];
-				qeal w3 = weight[4 * i + 3];
-
-				buffer[16 * i + 0] = w0 * v0x;
-				buffer[16 * i + 1] = w1 * v1x;
-				buffer[16 * i + 2] = w2 * v2x;
-				buffer[16 * i + 3] = w3 * v3x;
-
-				buffer[16 * i + 4] = w0 * v0y;
-				buffer[16 * i + 5] = w1 * v1y;
-				buffer[16 * i + 6] = w2 * v2y;
-				buffer[16 * i + 7] = w3 * v3y;
-
-				buffer[16 * i + 8] = w0 * v0z;
-				buffer[16 * i + 9] = w1 * v1z;
-				buffer[16 * i + 10] = w2 * v2z;
-				buffer[16 * i + 11] = w3 * v3z;
-
-				buffer[16 * i + 12] = w0;
-				buffer[16 * i + 13] = w1;
-				buffer[16 * i + 14] = w2;
-				buffer[16 * i + 15] = w3;
+				if (c >= coeffNum)
+					break;
+				r[3 * c] += u[c] * x[0];
+				r[3 * c + 1] += u[c] * x[1];
+				r[3 * c + 2] += u[c] * x[2];
 			}
 		}
+
+		int lane = threadIdx.x & 31;
+		int warp = threadIdx.x >> 5;
+		#pragma unroll
+		for (int k = 0; k < 30; k++)
+		{
+			qeal v = r[k];
+			for (int d = 16; d > 0; d >>= 1)
+				v += __shfl_down_sync(0xffffffff, v, d);
+			if (lane == 0)
+				warpSum[k][warp] = v;
+		}
+		__syncthreads();
+		if (threadIdx.x < 3 * coeffNum)
+		{
+			qeal v = 0;
+			for (int w = 0; w < blockDim.x / 32; w++)
+				v += warpSum[threadIdx.x][w];
+			devReduced[devFrameReducedOffset[fid] + threadIdx.x] = v;
+		}
 	}
 
 }
@@ -132,6 +132,56 @@ namespace MIPC
 		qeal* devVelocity
 	);
 
+	// y = A * x for a csr matrix, one row per thread
+	__host__ void csrMatrixVectorProduct
+	(
+		int hostDim,
+		int* devDim,
+		int* devCsrRowPtr,
+		int* devCsrColInd,
+		qeal* devCsrVal,
+		qeal* devX,
+		qeal* devY
+	);
+
+	__global__ void csrMatrixVectorProduct
+	(
+		int* devDim,
+		int* devCsrRowPtr,
+		int* devCsrColInd,
+		qeal* devCsrVal,
+		qeal* devX,
+		qeal* devY
+	);
+
+	// adds scale times a column major rows x cols block at (rowOffset, colOffset) into the csr values,
+	// entries outside the pattern are dropped
+	__host__ void addDenseBlockToCsr
+	(
+		int rows,
+		int cols,
+		int rowOffset,
+		int colOffset,
+		qeal* devBlock,
+		qeal scale,
+		int* devCsrRowPtr,
+		int* devCsrColInd,
+		qeal* devCsrVal
+	);
+
+	__global__ void addDenseBlockToCsr
+	(
+		int rows,
+		int cols,
+		int rowOffset,
+		int colOffset,
+		qeal* devBlock,
+		qeal scale,
+		int* devCsrRowPtr,
+		int* devCsrColInd,
+		qeal* devCsrVal
+	);
+
 	__host__ void assembleTetELementX
 	(
 		int hostTetElementNum,
@@ -267,9 +317,12 @@ namespace MIPC
 	__device__ __forceinline__
 		void computeStableNeoHookean(int eleid, qeal* F, qeal* FPK, qeal* PF, qeal& lameMiu, qeal& lameLamda);
 
+	// reduced stiffness block of every (iFrame, jFrame) task, sized 3 * coefficient num of each frame (3, 12 or 30) and placed at
+	// their reduced offsets, hostAssembleBlockDim is the largest frame dim
 	__host__ void assembleReducedStiffness
 	(
 		int hostAssembleBlockIndexNum,
+		int hostAssembleBlockDim,
 		int* devAssembleBlockIndexNum,
 		int* devAssembleTask,
 		int* devStiffnessBlockSharedTetElementList,
@@ -279,13 +332,42 @@ namespace MIPC
 		int* devTetElementSharedFrameList,
 		int* devTetElementSharedFrameOffset,
 		qeal* devTetElementFrameProjectionBuffer,
-		int* devTetElementFrameProjectionNum,
-		int* devTetElementFrameProjectionOffset,
+		int* devTetElementFrameProjectionCoeffNum,
+		int* devTetElementFrameProjectionBufferOffset,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
 		qeal* devTetElementStiffness,
 		int* devReducedDim,
 		qeal* devReducedStiffness
 	);
 
+	// same blocks added as scale * K into the csr values of the sparse system, devAssembleTaskCsrSlot holds per task the
+	// column slot of jFrame in the rows of iFrame and of iFrame in the rows of jFrame
+	__host__ void assembleReducedStiffnessToCsr
+	(
+		int hostAssembleBlockIndexNum,
+		int hostAssembleBlockDim,
+		int* devAssembleBlockIndexNum,
+		int* devAssembleTask,
+		int* devStiffnessBlockSharedTetElementList,
+		int* devAssembleTaskSharedTetElementNum,
+		int* devAssembleTaskSharedTetElementoffset,
+		int* devPojectionStiffnessList,
+		int* devTetElementSharedFrameList,
+		int* devTetElementSharedFrameOffset,
+		qeal* devTetElementFrameProjectionBuffer,
+		int* devTetElementFrameProjectionCoeffNum,
+		int* devTetElementFrameProjectionBufferOffset,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
+		qeal* devTetElementStiffness,
+		int* devReducedDim,
+		int* devAssembleTaskCsrSlot,
+		int* devCsrRowPtr,
+		qeal* devCsrVal,
+		qeal scale
+	);
+
 	__global__ void assembleReducedStiffness
 	(
 		int* devAssembleBlockIndexNum,
@@ -297,51 +379,104 @@ namespace MIPC
 		int* devTetElementSharedFrameList,
 		int* devTetElementSharedFrameOffset,
 		qeal* devTetElementFrameProjectionBuffer,
-		int* devTetElementFrameProjectionNum,
-		int* devTetElementFrameProjectionOffset,
+		int* devTetElementFrameProjectionCoeffNum,
+		int* devTetElementFrameProjectionBufferOffset,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
 		qeal* devTetElementStiffness,
 		int* devReducedDim,
-		qeal* devReducedStiffness
+		qeal* devReducedStiffness,
+		int* devAssembleTaskCsrSlot,
+		int* devCsrRowPtr,
+		qeal* devCsrVal,
+		qeal scale
 	);
 
-	__host__ void computeMedialPointsMovingDir
+	// medial points of the frames of one type (ReducedFrameType), the rest positions are x, y, z arrays of hostFramesNum each;
+	// writes the position rest + U * reducedX and the moving dir U * reducedDir of every frame in the same pass
+	__host__ void transformReducedFrames
 	(
-		int hostMedialPointsNum,
-		int* devMedialPointsNum,
-		qeal* devMedialOriPointPosition,
-		qeal* devReducedXtilde,
+		int hostFramesNum,
+		int type,
+		int* devFramePointId,
+		int* devFrameReducedOffset,
+		qeal* devFrameRestPosition,
+		qeal* devReducedX,
+		qeal* devReducedDir,
+		qeal* devMedialPointPosition,
 		qeal* devMedialPointMovingDir
 	);
 
-	__global__ void computeMedialPointsMovingDir
+	__global__ void transformReducedFrames
 	(
-		int* devMedialPointsNum,
-		qeal* devMedialOriPointPosition,
-		qeal* devReducedXtilde,
+		int framesNum,
+		int type,
+		int* devFramePointId,
+		int* devFrameReducedOffset,
+		qeal* devFrameRestPosition,
+		qeal* devReducedX,
+		qeal* devReducedDir,
+		qeal* devMedialPointPosition,
 		qeal* devMedialPointMovingDir
 	);
 
-	__host__ void fillTetElementFrameProjectionBuffer
+	// x = U * reduced over the nonzero weights of every tet point, U stored as the coefficients (w * x, w * y, w * z, w for linear frames) per (tet point, frame),
+	// coefficient c scales the reduced entries 3 * c + axis of the frame
+	__host__ void projectReducedToTetPoints
 	(
-		int hostTetElementNum,
-		int* devTetElementNum,
-		int* devTetElementIndices,
-		qeal* devTetPoints,
-		qeal* devTetElementFrameWeightList,
-		int* devTetElementFrameProjectionNum,
-		int* devTetElementFrameProjectionOffset,
-		qeal* devTetElementFrameProjectionBuffer
+		int hostTetPointsNum,
+		int* devTetPointsNum,
+		int* devTetPointFrameProjectionNum,
+		int* devTetPointFrameProjectionOffset,
+		int* devTetPointFrameProjectionFrame,
+		int* devTetPointFrameProjectionCoeffNum,
+		int* devTetPointFrameProjectionBufferOffset,
+		qeal* devTetPointFrameProjectionBuffer,
+		qeal* devReduced,
+		qeal* devX
 	);
 
-	__global__ void fillTetElementFrameProjectionBuffer
+	__global__ void projectReducedToTetPoints
 	(
-		int* devTetElementNum,
-		int* devTetElementIndices,
-		qeal* devTetPoints,
-		qeal* devTetElementFrameWeightList,
-		int* devTetElementFrameProjectionNum,
-		int* devTetElementFrameProjectionOffset,
-		qeal* devTetElementFrameProjectionBuffer
+		int* devTetPointsNum,
+		int* devTetPointFrameProjectionNum,
+		int* devTetPointFrameProjectionOffset,
+		int* devTetPointFrameProjectionFrame,
+		int* devTetPointFrameProjectionCoeffNum,
+		int* devTetPointFrameProjectionBufferOffset,
+		qeal* devTetPointFrameProjectionBuffer,
+		qeal* devReduced,
+		qeal* devX
+	);
+
+	// reduced = U^T * x, one block per frame reducing over the tet points it weights
+	__host__ void projectTetPointsToReduced
+	(
+		int hostFramesNum,
+		int* devFramesNum,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
+		int* devFrameTetPointProjectionNum,
+		int* devFrameTetPointProjectionOffset,
+		int* devFrameTetPointProjectionBufferOffset,
+		int* devFrameTetPointProjectionPoint,
+		qeal* devFrameTetPointProjectionBuffer,
+		qeal* devX,
+		qeal* devReduced
+	);
+
+	__global__ void projectTetPointsToReduced
+	(
+		int* devFramesNum,
+		int* devFrameReducedOffset,
+		int* devFrameCoeffNum,
+		int* devFrameTetPointProjectionNum,
+		int* devFrameTetPointProjectionOffset,
+		int* devFrameTetPointProjectionBufferOffset,
+		int* devFrameTetPointProjectionPoint,
+		qeal* devFrameTetPointProjectionBuffer,
+		qeal* devX,
+		qeal* devReduced
 	);
 }
 